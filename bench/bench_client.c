@@ -0,0 +1,193 @@
+#include "bench_client.h"
+
+#include <gio/gunixsocketaddress.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+static GPid				  zterm_pid			 = 0;
+static const char		 *control_path		 = NULL;
+static GSocketConnection *control_connection = NULL;
+static GDataInputStream	 *control_in		 = NULL;
+static GOutputStream	 *control_out		 = NULL;
+
+static bool control_connect (void)
+{
+	GSocketClient  *client	= g_socket_client_new ();
+	GSocketAddress *address = g_unix_socket_address_new (control_path);
+
+	// zterm only creates the socket once it has read its config.
+	for (int tries = 0; tries < 100; tries++) {
+		control_connection = g_socket_client_connect (client, G_SOCKET_CONNECTABLE (address), NULL, NULL);
+		if (control_connection != NULL) {
+			control_in	= g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (control_connection)));
+			control_out = g_io_stream_get_output_stream (G_IO_STREAM (control_connection));
+			break;
+		}
+		g_usleep (100 * 1000);
+	}
+
+	g_object_unref (address);
+	g_object_unref (client);
+	return control_in != NULL;
+}
+
+// Starts zterm, and waits until terminal 1 has its shell running, so that doesn't land in anything being timed.
+bool bench_start (const char *zterm_path, const char *socket_path)
+{
+	char   *argv[] = {(char *) zterm_path, NULL};
+	GError *error  = NULL;
+
+	if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &zterm_pid, &error)) {
+		fprintf (stderr, "%s: Unable to start %s: %s\n", g_get_prgname (), zterm_path, error->message);
+		g_error_free (error);
+		return false;
+	}
+
+	control_path = socket_path;
+	if (!control_connect ()) {
+		fprintf (stderr, "%s: Unable to connect to %s\n", g_get_prgname (), control_path);
+		bench_stop ();
+		return false;
+	}
+
+	return bench_wait_running (1);
+}
+
+void bench_stop (void)
+{
+	if (zterm_pid) {
+		// Waited for, so that another can be started right away without finding this one still running.
+		kill (zterm_pid, SIGTERM);
+		waitpid (zterm_pid, NULL, 0);
+		g_spawn_close_pid (zterm_pid);
+		zterm_pid = 0;
+	}
+	g_clear_object (&control_in);
+	control_out = NULL;
+	g_clear_object (&control_connection);
+}
+
+// Sends one command and waits for the reply, which must be ok.
+JsonObject *bench_request (JsonNode *request)
+{
+	JsonGenerator *generator = json_generator_new ();
+	GError		  *error	 = NULL;
+	gsize		   len;
+
+	json_generator_set_root (generator, request);
+	char *line = json_generator_to_data (generator, &len);
+	g_object_unref (generator);
+	json_node_unref (request);
+
+	if (!g_output_stream_write_all (control_out, line, len, NULL, NULL, &error) ||
+		!g_output_stream_write_all (control_out, "\n", 1, NULL, NULL, &error)) {
+		fprintf (stderr, "%s: Unable to write to %s: %s\n", g_get_prgname (), control_path, error->message);
+		exit (1);
+	}
+
+	char *reply = g_data_input_stream_read_line (control_in, NULL, NULL, &error);
+	if (reply == NULL) {
+		fprintf (stderr, "%s: No reply to %s\n", g_get_prgname (), line);
+		exit (1);
+	}
+
+	JsonNode *node = json_from_string (reply, &error);
+	if (node == NULL || !JSON_NODE_HOLDS_OBJECT (node) ||
+		!json_object_get_boolean_member_with_default (json_node_get_object (node), "ok", false)) {
+		fprintf (stderr, "%s: %s failed: %s\n", g_get_prgname (), line, reply);
+		exit (1);
+	}
+
+	JsonObject *object = json_object_ref (json_node_get_object (node));
+	json_node_unref (node);
+	g_free (reply);
+	g_free (line);
+
+	return object;
+}
+
+void bench_command_new (JsonBuilder *builder, const char *cmd)
+{
+	json_builder_begin_object (builder);
+	json_builder_set_member_name (builder, "cmd");
+	json_builder_add_string_value (builder, cmd);
+}
+
+JsonNode *bench_command_end (JsonBuilder *builder)
+{
+	json_builder_end_object (builder);
+	JsonNode *node = json_builder_get_root (builder);
+	json_builder_reset (builder);
+
+	return node;
+}
+
+void bench_switch (int term, char **argv)
+{
+	JsonBuilder *builder = json_builder_new ();
+	char		 target[16];
+
+	snprintf (target, sizeof (target), "%d", term);
+	bench_command_new (builder, "switch");
+	json_builder_set_member_name (builder, "target");
+	json_builder_add_string_value (builder, target);
+	if (argv != NULL) {
+		json_builder_set_member_name (builder, "argv");
+		json_builder_begin_array (builder);
+		for (int i = 0; argv[i] != NULL; i++) {
+			json_builder_add_string_value (builder, argv[i]);
+		}
+		json_builder_end_array (builder);
+	}
+	json_object_unref (bench_request (bench_command_end (builder)));
+	g_object_unref (builder);
+}
+
+// How many of terminals first to first + count - 1 are open, and how many of those have a child running.
+int bench_terms_open (int first, int count, int *running)
+{
+	JsonBuilder *builder = json_builder_new ();
+	int			 open	 = 0;
+
+	bench_command_new (builder, "titles");
+	JsonObject *reply = bench_request (bench_command_end (builder));
+	JsonArray  *list  = json_object_get_array_member (reply, "terms");
+
+	if (running != NULL) {
+		*running = 0;
+	}
+	for (guint i = 0; i < json_array_get_length (list); i++) {
+		JsonObject *term = json_array_get_object_element (list, i);
+		gint64		n	 = json_object_get_int_member (term, "term");
+		if (n >= first && n < first + count) {
+			open++;
+			if (running != NULL && json_object_get_string_member (term, "pts")[0] != '\0') {
+				(*running)++;
+			}
+		}
+	}
+
+	json_object_unref (reply);
+	g_object_unref (builder);
+	return open;
+}
+
+bool bench_wait_running (int term)
+{
+	int running = 0;
+
+	for (int tries = 0; tries < 200; tries++) {
+		bench_terms_open (term, 1, &running);
+		if (running) {
+			return true;
+		}
+		g_usleep (50 * 1000);
+	}
+
+	fprintf (stderr, "%s: Terminal %d never started.\n", g_get_prgname (), term);
+	return false;
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <gio/gio.h>
+#include <json-glib/json-glib.h>
+#include <stdbool.h>
+
+/*
+ * What the benchmarks that drive a real zterm share: starting it, and
+ * talking to it over the control socket.  Any failure to talk to zterm is
+ * fatal.
+ */
+
+bool		bench_start (const char *zterm_path, const char *socket_path);
+void		bench_stop (void);
+JsonObject *bench_request (JsonNode *request);
+void		bench_command_new (JsonBuilder *builder, const char *cmd);
+JsonNode   *bench_command_end (JsonBuilder *builder);
+void		bench_switch (int term, char **argv);
+int			bench_terms_open (int first, int count, int *running);
+bool		bench_wait_running (int term);
+
+// vim: set ts=4 sw=4 noexpandtab :
@@ -0,0 +1,186 @@
+/*
+ * Legacy config parse benchmark.
+ *
+ * Writes a legacy ~/.zterm/config with --lines lines, thousands of them bind
+ * and color lines, into a temporary HOME with no zterm.conf, and loads it over
+ * and over through config_load_start and config_load_apply, the same way
+ * zterm does at startup.  Each load maps the file and parses it, then builds
+ * the key table from the result.
+ *
+ * Anything the config complains about is printed for a first, untimed, load
+ * only.  Prints a line of JSON with the time per load and lines per second.
+ *
+ * Usage: config_parse [--lines N] [--loads N]
+ */
+#include "zterm.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+terms_t		  terms;
+const GdkRGBA default_colors[256];
+int			  start_width, start_height;
+bool		  probes_enabled = false;
+bool		  trace_enabled	 = false;
+
+static int	n_lines = 10000;
+static int	n_loads = 200;
+static bool quiet	= false;
+
+static const GOptionEntry options[] = {
+  {"lines", 'n', 0, G_OPTION_ARG_INT, &n_lines, "Lines in the generated config", "N"},
+  {"loads", 'l', 0, G_OPTION_ARG_INT, &n_loads, "Times to load it", "N"},
+  {NULL},
+};
+
+// What config.c needs from the rest of zterm.
+int _fprintf (bool print, FILE *io, const char *fmt, ...)
+{
+	va_list args;
+	int		ret;
+
+	if (!print || quiet) {
+		return 0;
+	}
+
+	va_start (args, fmt);
+	ret = vfprintf (io, fmt, args);
+	va_end (args);
+
+	return ret;
+}
+
+void match_regexes_free (void)
+{
+}
+
+void config_reloaded (int old_n_active, bool by_user)
+{
+}
+
+void probe_enter (const char *name, long slot, int window)
+{
+}
+
+void probe_pop (void)
+{
+}
+
+void trace_record (const char *what, gint64 a, gint64 b)
+{
+}
+
+static const char *states[]	 = {"<Control><Alt>", "<Super>", "<Control><Shift>", "<Alt><Shift>", "<Control><Super>"};
+static const char *actions[] = {"CUT", "CUT_HTML", "CUT_URI", "PASTE", "MENU", "NEXT_TERM", "PREV_TERM"};
+
+// Mostly binds and colors, with a comment every ten lines.
+static bool write_config (const char *filename)
+{
+	FILE *io = fopen (filename, "w");
+
+	if (io == NULL) {
+		fprintf (stderr, "config_parse: Unable to write '%s'.\n", filename);
+		return false;
+	}
+
+	fputs ("# Generated by bench/config_parse.\n", io);
+	fputs ("font: Monospace 12\nsize: 80x24\naudible_bell: 0\nscrollback_lines: 10000\n", io);
+	fputs ("color_scheme: Solarized dark #839496 #002b36\ncolor_scheme: Solarized light #657b83 #fdf6e3\n", io);
+
+	for (int i = 6; i < n_lines; i++) {
+		const char *state = states[i % G_N_ELEMENTS (states)];
+
+		switch (i % 10) {
+		case 0:
+			fprintf (io, "# Block %d.\n", i / 10);
+			break;
+		case 1:
+		case 2:
+		case 3:
+			fprintf (io, "bind: %d %s F1-F12\n", (i / 10) % 100 * 12, state);
+			break;
+		case 4:
+			fprintf (io, "bind: %d %s F%d ssh -t host%d 'tmux attach || tmux'\n", 1200 + (i / 10) % 100, state, 1 + i % 12, i);
+			break;
+		case 5:
+		case 6:
+			fprintf (io, "bind: %s %s %c\n", actions[i % G_N_ELEMENTS (actions)], state, 'a' + i % 26);
+			break;
+		default:
+			fprintf (io, "color: %d #%06x\n", i % 256, (i * 2654435761u) & 0xffffff);
+			break;
+		}
+	}
+
+	fclose (io);
+	return true;
+}
+
+int main (int argc, char *argv[])
+{
+	GOptionContext *context = g_option_context_new ("- zterm legacy config parse benchmark");
+	GError		   *error	= NULL;
+
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		fprintf (stderr, "config_parse: %s\n", error->message);
+		return 2;
+	}
+	g_option_context_free (context);
+	n_lines = MAX (n_lines, 10);
+	n_loads = MAX (n_loads, 1);
+
+	char *home = g_dir_make_tmp ("zterm-bench-XXXXXX", &error);
+	if (home == NULL) {
+		fprintf (stderr, "config_parse: %s\n", error->message);
+		return 1;
+	}
+
+	// An empty XDG_CONFIG_HOME, so that there's no zterm.conf and the legacy config is read.
+	char *xdg_dir	 = g_build_filename (home, "xdg", NULL);
+	char *legacy_dir = g_build_filename (home, ".zterm", NULL);
+	char *filename	 = g_build_filename (legacy_dir, "config", NULL);
+	mkdir (xdg_dir, 0700);
+	mkdir (legacy_dir, 0700);
+	g_setenv ("HOME", home, TRUE);
+	g_setenv ("XDG_CONFIG_HOME", xdg_dir, TRUE);
+
+	// Once untimed, with anything it has to say printed.
+	bool ok = write_config (filename);
+	if (ok) {
+		config_load_start (false, false);
+		ok	  = config_load_apply ();
+		quiet = true;
+	}
+
+	gint64 start = g_get_monotonic_time ();
+	for (int i = 0; ok && i < n_loads; i++) {
+		config_load_start (false, false);
+		ok = config_load_apply ();
+	}
+	gint64 elapsed = g_get_monotonic_time () - start;
+
+	if (ok) {
+		double per_load = elapsed / (double) n_loads;
+		printf ("{\"lines\": %d, \"loads\": %d, \"terminals\": %d, \"load_us\": %.1f, \"lines_per_s\": %.0f}\n", n_lines,
+				n_loads, terms.n_active, per_load, n_lines / per_load * G_USEC_PER_SEC);
+	} else {
+		fprintf (stderr, "config_parse: The generated config did not load.\n");
+	}
+
+	unlink (filename);
+	rmdir (legacy_dir);
+	rmdir (xdg_dir);
+	rmdir (home);
+	g_free (filename);
+	g_free (legacy_dir);
+	g_free (xdg_dir);
+	g_free (home);
+
+	return ok ? 0 : 1;
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
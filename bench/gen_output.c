@@ -0,0 +1,153 @@
+/*
+ * Output generator for the throughput benchmark.
+ *
+ * Runs inside a zterm terminal and writes a fixed number of bytes of one kind
+ * of output to it as fast as the PTY will take them.  Just before the first
+ * write it stores the CLOCK_MONOTONIC time in microseconds to the stamp file,
+ * so that bench/throughput can leave the spawn out of its timings.
+ *
+ * Usage: gen_output SCENARIO BYTES DELAY_MS STAMP_FILE
+ *
+ * Scenarios:
+ *   ascii   Plain 80 column lines.
+ *   sgr     Every word in a different 256 color foreground and background.
+ *   wide    Double width CJK and emoji.
+ *   long    Lines of 16k characters, which all have to be wrapped.
+ *   redraw  Cursor addressed updates all over the screen, like top or an editor.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHUNK (64 * 1024)
+
+typedef void (*fill_t) (char *buf, size_t *len);
+
+static void append (char *buf, size_t *len, const char *s)
+{
+	size_t n = strlen (s);
+
+	memcpy (buf + *len, s, n);
+	*len += n;
+}
+
+static void fill_ascii (char *buf, size_t *len)
+{
+	for (int line = 0; *len + 81 < CHUNK; line++) {
+		for (int i = 0; i < 79; i++) {
+			buf[(*len)++] = ' ' + 1 + (line + i) % 94;
+		}
+		buf[(*len)++] = '\n';
+	}
+}
+
+static void fill_sgr (char *buf, size_t *len)
+{
+	char seq[64];
+
+	for (int word = 0; *len + 64 < CHUNK; word++) {
+		snprintf (seq, sizeof (seq), "\033[38;5;%d;48;5;%dm%s\033[0m%s", word % 256, (word * 7 + 128) % 256, "lorem",
+				  word % 12 == 11 ? "\n" : " ");
+		append (buf, len, seq);
+	}
+}
+
+static void fill_wide (char *buf, size_t *len)
+{
+	static const char *glyphs[] = {"漢", "字", "表", "示", "終", "端", "😀", "🚀", "🎉", "한", "글", "ア"};
+
+	for (int i = 0; *len + 8 < CHUNK; i++) {
+		append (buf, len, glyphs[i % (sizeof (glyphs) / sizeof (glyphs[0]))]);
+		if (i % 39 == 38) {
+			append (buf, len, "\n");
+		}
+	}
+}
+
+static void fill_long (char *buf, size_t *len)
+{
+	for (int i = 0; *len + 1 < CHUNK; i++) {
+		buf[(*len)++] = (i % 16384 == 16383) ? '\n' : 'a' + i % 26;
+	}
+}
+
+static void fill_redraw (char *buf, size_t *len)
+{
+	char seq[64];
+
+	srandom (1);
+	append (buf, len, "\033[2J");
+	while (*len + 64 < CHUNK) {
+		snprintf (seq, sizeof (seq), "\033[%ld;%ldH\033[1;3%ldm%6ld\033[K\033[0m", 1 + random () % 50, 1 + random () % 150,
+				  random () % 8, random () % 1000000);
+		append (buf, len, seq);
+	}
+}
+
+static const struct {
+	const char *name;
+	fill_t		fill;
+} scenarios[] = {
+  {"ascii",	 fill_ascii },
+  {"sgr",	 fill_sgr	},
+  {"wide",	 fill_wide	},
+  {"long",	 fill_long	},
+  {"redraw", fill_redraw},
+};
+
+int main (int argc, char *argv[])
+{
+	static char		buf[CHUNK];
+	size_t			len	 = 0;
+	fill_t			fill = NULL;
+	struct timespec ts;
+
+	if (argc != 5) {
+		fprintf (stderr, "Usage: %s SCENARIO BYTES DELAY_MS STAMP_FILE\n", argv[0]);
+		return 2;
+	}
+
+	for (size_t i = 0; i < sizeof (scenarios) / sizeof (scenarios[0]); i++) {
+		if (!strcmp (scenarios[i].name, argv[1])) {
+			fill = scenarios[i].fill;
+		}
+	}
+	if (fill == NULL) {
+		fprintf (stderr, "%s: Unknown scenario '%s'\n", argv[0], argv[1]);
+		return 2;
+	}
+	fill (buf, &len);
+
+	long long bytes = strtoll (argv[2], NULL, 10);
+
+	// Gives the benchmark time to move this terminal to the background first.
+	usleep (strtol (argv[3], NULL, 10) * 1000);
+
+	FILE *stamp = fopen (argv[4], "w");
+	if (stamp == NULL) {
+		perror (argv[4]);
+		return 1;
+	}
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	fprintf (stamp, "%lld\n", (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+	fclose (stamp);
+
+	while (bytes > 0) {
+		size_t	to_write = bytes < (long long) len ? (size_t) bytes : len;
+		ssize_t ret		 = write (STDOUT_FILENO, buf, to_write);
+		if (ret < 0) {
+			perror ("write");
+			return 1;
+		}
+		bytes -= ret;
+	}
+
+	// Leave the screen in a sane state for whatever comes next.
+	fputs ("\033[0m\n", stdout);
+	return 0;
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
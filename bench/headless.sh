@@ -0,0 +1,54 @@
+#!/bin/bash
+#
+# Runs a command against a headless display, with a private session bus,
+# runtime directory and config, so that a zterm it starts can't find, or be
+# found by, any other zterm.  zterm gets bench/zterm-bench.conf.
+#
+# Uses Xvfb if it's installed, otherwise the GTK broadway backend.
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+TMP_DIR=$(mktemp -d -t zterm-bench-XXXXXX)
+DISPLAY_PID=
+cleanup () {
+  if [[ -n "${DISPLAY_PID}" ]]; then
+    kill "${DISPLAY_PID}" 2>/dev/null || true
+  fi
+  rm -rf "${TMP_DIR}"
+}
+trap cleanup EXIT
+
+mkdir -p "${TMP_DIR}/config" "${TMP_DIR}/runtime"
+chmod 700 "${TMP_DIR}/runtime"
+cp bench/zterm-bench.conf "${TMP_DIR}/config/zterm.conf"
+export XDG_CONFIG_HOME="${TMP_DIR}/config"
+export XDG_RUNTIME_DIR="${TMP_DIR}/runtime"
+
+if command -v Xvfb >/dev/null; then
+  # Xvfb picks a free display itself, and writes its number once it's ready.
+  Xvfb -displayfd 3 -screen 0 1920x1080x24 -nolisten tcp 3>"${TMP_DIR}/display" >/dev/null 2>&1 &
+  DISPLAY_PID=$!
+  for _ in $(seq 100); do
+    [[ -s "${TMP_DIR}/display" ]] && break
+    sleep 0.1
+  done
+  if [[ ! -s "${TMP_DIR}/display" ]]; then
+    echo "Xvfb did not start." >&2
+    exit 1
+  fi
+  export DISPLAY=":$(head -n 1 "${TMP_DIR}/display")" GDK_BACKEND=x11
+elif command -v gtk4-broadwayd >/dev/null; then
+  # broadwayd can't pick its own display, so this one is fixed.
+  gtk4-broadwayd :99 >/dev/null 2>&1 &
+  DISPLAY_PID=$!
+  unset DISPLAY
+  export BROADWAY_DISPLAY=:99 GDK_BACKEND=broadway
+  sleep 1
+else
+  echo "Neither Xvfb nor gtk4-broadwayd is installed." >&2
+  exit 1
+fi
+
+dbus-run-session -- "$@"
@@ -0,0 +1,195 @@
+/*
+ * Key binding dispatch microbenchmark.
+ *
+ * Loads the bind_switch and bind_action entries from a zterm.conf (the one in
+ * the repository by default, which has the 48 terminal F1-F12 layout), then
+ * replays a few million synthetic key events through both the old linear walk
+ * over the configured bindings and the compiled key table from keys.c.
+ *
+ * Usage: key_dispatch [zterm.conf] [events]
+ */
+#include "zterm.h"
+
+#include <ctype.h>
+#include <libconfig.h>
+#include <stdlib.h>
+#include <time.h>
+
+terms_t terms;
+
+// A generation of its own, config.c isn't linked in.
+static config_gen_t gen = {.refs = 1, .key_bind_mask = BIND_MASK_DEFAULT, .button_bind_mask = BIND_MASK_DEFAULT};
+
+typedef struct {
+	guint keyval;
+	guint state;
+} key_event_t;
+
+static void add_bind (bind_actions_t action, int base, const char *state, const char *key_min, const char *key_max)
+{
+	bind_t *bind = calloc (1, sizeof (bind_t));
+	char	bind_str[128];
+
+	bind->action = action;
+	bind->base	 = base;
+
+	if (action == BIND_ACT_SWITCH) {
+		gtk_accelerator_parse (state, NULL, &bind->state);
+		bind->key_min = gdk_keyval_from_name (key_min);
+		bind->key_max = key_max ? gdk_keyval_from_name (key_max) : bind->key_min;
+	} else {
+		snprintf (bind_str, sizeof (bind_str), "%s%s", state, key_min);
+		gtk_accelerator_parse (bind_str, &bind->key_min, &bind->state);
+		bind->key_max = bind->key_min;
+	}
+
+	bind->next = gen.keys;
+	gen.keys   = bind;
+}
+
+static bool load_binds (const char *filename)
+{
+	config_t cfg;
+
+	config_init (&cfg);
+	if (!config_read_file (&cfg, filename)) {
+		fprintf (stderr, "Unable to read '%s': %s at line %d\n", filename, config_error_text (&cfg), config_error_line (&cfg));
+		config_destroy (&cfg);
+		return false;
+	}
+
+	config_setting_t *list = config_lookup (&cfg, "bind_action");
+	for (int i = 0; list != NULL && i < config_setting_length (list); i++) {
+		config_setting_t *bind = config_setting_get_elem (list, i);
+		const char		 *state, *key;
+		if (config_setting_lookup_string (bind, "state", &state) && config_setting_lookup_string (bind, "key", &key)) {
+			// The action doesn't matter for dispatch cost, anything but SWITCH will do.
+			add_bind (BIND_ACT_PASTE, 0, state, key, NULL);
+		}
+	}
+
+	list = config_lookup (&cfg, "bind_switch");
+	for (int i = 0; list != NULL && i < config_setting_length (list); i++) {
+		config_setting_t *bind	  = config_setting_get_elem (list, i);
+		const char		 *key_max = NULL, *key_min, *state;
+		int				  base;
+		if (config_setting_lookup_string (bind, "key_min", &key_min) && config_setting_lookup_string (bind, "state", &state) &&
+			config_setting_lookup_int (bind, "base", &base)) {
+			config_setting_lookup_string (bind, "key_max", &key_max);
+			add_bind (BIND_ACT_SWITCH, base, state, key_min, key_max);
+		}
+	}
+
+	config_destroy (&cfg);
+	return gen.keys != NULL;
+}
+
+// This is term_key_event before the key table, minus the actions themselves.
+static long legacy_dispatch (guint keyval, guint state)
+{
+	guint keyval_lower = keyval;
+
+	if (keyval < 0xFF && isalpha (keyval)) {
+		keyval_lower = tolower (keyval);
+	}
+
+	for (bind_t *cur = gen.keys; cur; cur = cur->next) {
+		if (((keyval >= cur->key_min) && (keyval <= cur->key_max)) ||
+			((keyval_lower >= cur->key_min) && (keyval_lower <= cur->key_max))) {
+			gchar *name	 = gtk_accelerator_name (0, state);
+			gchar *label = gtk_accelerator_get_label (0, state);
+			g_free (label);
+			g_free (name);
+			if ((state & gen.key_bind_mask) == cur->state) {
+				return cur->action == BIND_ACT_SWITCH ? cur->base + (keyval - cur->key_min) : -2;
+			}
+		}
+	}
+
+	return -1;
+}
+
+static long table_dispatch (guint keyval, guint state)
+{
+	guint keyval_lower = keyval;
+
+	if (keyval < 0xFF && isalpha (keyval)) {
+		keyval_lower = tolower (keyval);
+	}
+
+	key_entry_t *entry = key_table_lookup (&gen, state, keyval);
+	if (entry == NULL && keyval_lower != keyval) {
+		entry = key_table_lookup (&gen, state, keyval_lower);
+	}
+
+	if (entry == NULL) {
+		return -1;
+	}
+
+	return entry->bind->action == BIND_ACT_SWITCH ? entry->n : -2;
+}
+
+static double now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main (int argc, char *argv[])
+{
+	const char *filename = argc > 1 ? argv[1] : "zterm.conf";
+	long		n_events = argc > 2 ? strtol (argv[2], NULL, 10) : 4000000;
+	guint		states[] = {0, GDK_SHIFT_MASK, GDK_CONTROL_MASK, GDK_ALT_MASK, GDK_SUPER_MASK, GDK_SHIFT_MASK | GDK_CONTROL_MASK};
+	long		checksum[2] = {0, 0};
+	double		elapsed[2];
+
+	if (!load_binds (filename)) {
+		return 1;
+	}
+	key_table_build (&gen);
+
+	/*
+	 * Mostly plain typing, which has to fall all the way through the bindings
+	 * to reach the shell, with function keys mixed in on every modifier.
+	 */
+	key_event_t *events = g_new (key_event_t, n_events);
+	srandom (1);
+	for (long i = 0; i < n_events; i++) {
+		if (random () % 8 == 0) {
+			events[i].keyval = GDK_KEY_F1 + random () % 12;
+		} else {
+			events[i].keyval = GDK_KEY_a + random () % 26;
+		}
+		events[i].state = states[random () % G_N_ELEMENTS (states)];
+	}
+
+	for (int pass = 0; pass < 2; pass++) {
+		double start = now ();
+		for (long i = 0; i < n_events; i++) {
+			if (pass == 0) {
+				checksum[pass] += legacy_dispatch (events[i].keyval, events[i].state);
+			} else {
+				checksum[pass] += table_dispatch (events[i].keyval, events[i].state);
+			}
+		}
+		elapsed[pass] = now () - start;
+	}
+
+	printf ("%s: %u key table entries, %ld events\n", filename, g_hash_table_size (gen.key_table), n_events);
+	printf ("  linear walk: %8.1f ns/event\n", elapsed[0] * 1e9 / n_events);
+	printf ("  key table:   %8.1f ns/event\n", elapsed[1] * 1e9 / n_events);
+
+	if (checksum[0] != checksum[1]) {
+		fprintf (stderr, "Dispatch results differ: %ld vs %ld\n", checksum[0], checksum[1]);
+		return 1;
+	}
+
+	g_free (events);
+	key_table_free (&gen);
+
+	return 0;
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
@@ -0,0 +1,182 @@
+/*
+ * Keystroke to screen latency benchmark.
+ *
+ * Starts zterm with latency_stats on, runs cat in terminal 2 so that every
+ * key comes straight back through the PTY's echo, and types at it.  With
+ * xdotool the keys go through the X server and term_key_event like real ones,
+ * without it, or with --send, they go in through the control socket's send
+ * command, which leaves out the key handling but still goes through VTE.
+ *
+ * Prints a line of JSON with zterm's echo and on screen latency, and fails if
+ * the p99 to screen is over --budget.
+ *
+ * Meant to be run through bench/latency.sh, for the same reasons as
+ * bench/throughput.  Under Xvfb there is no window manager, so the keys go to
+ * whatever is under the pointer, which is the zterm window.
+ *
+ * Usage: latency [--zterm PATH] [--socket PATH] [--keys N] [--delay MS] [--budget US] [--send]
+ */
+#include "bench_client.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static char	   *zterm_path	= "./zterm";
+static char	   *socket_path = NULL;
+static int		n_keys		= 300;
+static int		delay_ms	= 30;
+static gint64	budget_us	= 33333; // Two frames at 60Hz.
+static gboolean use_send	= FALSE;
+
+static const GOptionEntry options[] = {
+  {"zterm", 0, 0, G_OPTION_ARG_FILENAME, &zterm_path, "zterm binary to start", "PATH"},
+  {"socket", 0, 0, G_OPTION_ARG_FILENAME, &socket_path, "Control socket, from the benchmark config", "PATH"},
+  {"keys", 'k', 0, G_OPTION_ARG_INT, &n_keys, "Keys to type", "N"},
+  {"delay", 'd', 0, G_OPTION_ARG_INT, &delay_ms, "Milliseconds between keys", "MS"},
+  {"budget", 'b', 0, G_OPTION_ARG_INT64, &budget_us, "Largest acceptable p99 to screen, in microseconds", "US"},
+  {"send", 0, 0, G_OPTION_ARG_NONE, &use_send, "Type through the control socket, even if xdotool is available", NULL},
+  {NULL},
+};
+
+// Letters, with a newline now and then so cat's line never fills.
+static char *typing (int n)
+{
+	char *text = g_malloc (n + 1);
+
+	for (int i = 0; i < n; i++) {
+		text[i] = i % 60 == 59 ? '\n' : 'a' + i % 26;
+	}
+	text[n] = '\0';
+
+	return text;
+}
+
+static bool type_xdotool (const char *text)
+{
+	char	delay[16];
+	GError *error = NULL;
+	int		status;
+
+	snprintf (delay, sizeof (delay), "%d", delay_ms);
+	char *argv[] = {"xdotool", "type", "--delay", delay, (char *) text, NULL};
+	if (!g_spawn_sync (NULL, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, NULL, NULL, &status, &error)) {
+		fprintf (stderr, "latency: %s\n", error->message);
+		g_error_free (error);
+		return false;
+	}
+
+	return g_spawn_check_wait_status (status, NULL);
+}
+
+static void type_send (const char *text)
+{
+	JsonBuilder *builder = json_builder_new ();
+	char		 key[2]	 = {0};
+
+	for (int i = 0; text[i] != '\0'; i++) {
+		key[0] = text[i];
+		bench_command_new (builder, "send");
+		json_builder_set_member_name (builder, "term");
+		json_builder_add_int_value (builder, 2);
+		json_builder_set_member_name (builder, "text");
+		json_builder_add_string_value (builder, key);
+		json_object_unref (bench_request (bench_command_end (builder)));
+		g_usleep (delay_ms * 1000);
+	}
+
+	g_object_unref (builder);
+}
+
+static JsonObject *latency (bool reset)
+{
+	JsonBuilder *builder = json_builder_new ();
+
+	bench_command_new (builder, "latency");
+	json_builder_set_member_name (builder, "term");
+	json_builder_add_int_value (builder, 2);
+	json_builder_set_member_name (builder, "reset");
+	json_builder_add_boolean_value (builder, reset);
+	JsonObject *reply = bench_request (bench_command_end (builder));
+	g_object_unref (builder);
+
+	return reply;
+}
+
+int main (int argc, char *argv[])
+{
+	GOptionContext *context = g_option_context_new ("- zterm keystroke latency benchmark");
+	GError		   *error	= NULL;
+	char		   *cat[]	= {"cat", NULL};
+
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		fprintf (stderr, "latency: %s\n", error->message);
+		return 2;
+	}
+	g_option_context_free (context);
+
+	if (socket_path == NULL) {
+		socket_path = g_build_filename (g_get_user_runtime_dir (), "zterm-bench.sock", NULL);
+	}
+	// xdotool needs X, so not under broadway.
+	char *xdotool = g_find_program_in_path ("xdotool");
+	if (g_getenv ("DISPLAY") == NULL || xdotool == NULL) {
+		use_send = TRUE;
+	}
+	g_free (xdotool);
+
+	if (!bench_start (zterm_path, socket_path)) {
+		return 1;
+	}
+
+	bench_switch (2, cat);
+	if (!bench_wait_running (2)) {
+		bench_stop ();
+		return 1;
+	}
+	json_object_unref (latency (true));
+
+	char *text = typing (n_keys);
+	if (use_send) {
+		type_send (text);
+	} else if (!type_xdotool (text)) {
+		bench_stop ();
+		return 1;
+	}
+	g_free (text);
+
+	// Give the last key time to make it to the screen.
+	g_usleep (250 * 1000);
+
+	JsonObject *reply = latency (false);
+	JsonArray  *list  = json_object_get_array_member (reply, "terms");
+	bool		ok	  = false;
+
+	if (json_array_get_length (list) == 1) {
+		JsonObject *term  = json_array_get_object_element (list, 0);
+		JsonObject *echo  = json_object_get_object_member (term, "echo");
+		JsonObject *paint = json_object_get_object_member (term, "paint");
+		gint64		p99	  = json_object_get_int_member (paint, "p99_us");
+
+		ok = json_object_get_int_member (term, "painted") > 0 && p99 <= budget_us;
+		printf ("{\"mode\": \"%s\", \"inputs\": %" G_GINT64_FORMAT ", \"painted\": %" G_GINT64_FORMAT
+				", \"echo_p50_us\": %" G_GINT64_FORMAT ", \"echo_p99_us\": %" G_GINT64_FORMAT
+				", \"echo_max_us\": %" G_GINT64_FORMAT ", \"paint_p50_us\": %" G_GINT64_FORMAT
+				", \"paint_p99_us\": %" G_GINT64_FORMAT ", \"paint_max_us\": %" G_GINT64_FORMAT
+				", \"budget_us\": %" G_GINT64_FORMAT ", \"ok\": %s}\n",
+				use_send ? "send" : "xdotool", json_object_get_int_member (term, "inputs"),
+				json_object_get_int_member (term, "painted"), json_object_get_int_member (echo, "p50_us"),
+				json_object_get_int_member (echo, "p99_us"), json_object_get_int_member (echo, "max_us"),
+				json_object_get_int_member (paint, "p50_us"), p99, json_object_get_int_member (paint, "max_us"), budget_us,
+				ok ? "true" : "false");
+	} else {
+		fprintf (stderr, "latency: zterm saw none of the keys.\n");
+	}
+
+	json_object_unref (reply);
+	bench_stop ();
+
+	return ok ? 0 : 1;
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
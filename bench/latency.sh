@@ -0,0 +1,6 @@
+#!/bin/bash
+#
+# Runs bench/latency on a headless display, arguments are passed on to it.
+# Without xdotool, the keys are typed through the control socket instead.
+
+exec "$(dirname "$0")/headless.sh" ./bench/latency "$@"
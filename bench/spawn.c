@@ -0,0 +1,155 @@
+/*
+ * Terminal spawn benchmark.
+ *
+ * Starts zterm once with spawn_helper off and once with it on, and in each
+ * opens terminal 2 with true in it over and over, waiting for it to close
+ * before opening the next.  zterm's stats command has the time from each
+ * spawn to the child running, which is what's reported, the rest of the
+ * round trip is mostly the control socket and terminal setup.
+ *
+ * Prints a line of JSON per mode with the spawns and their average and
+ * largest time.
+ *
+ * Meant to be run through bench/spawn.sh, for the same reasons as
+ * bench/throughput.  The mode is set by rewriting the zterm.conf in
+ * $XDG_CONFIG_HOME that headless.sh made.
+ *
+ * Usage: spawn [--zterm PATH] [--socket PATH] [--spawns N]
+ */
+#include "bench_client.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static char *zterm_path	 = "./zterm";
+static char *socket_path = NULL;
+static int	 n_spawns	 = 200;
+
+static const GOptionEntry options[] = {
+  {"zterm", 0, 0, G_OPTION_ARG_FILENAME, &zterm_path, "zterm binary to start", "PATH"},
+  {"socket", 0, 0, G_OPTION_ARG_FILENAME, &socket_path, "Control socket, from the benchmark config", "PATH"},
+  {"spawns", 'n', 0, G_OPTION_ARG_INT, &n_spawns, "Terminals to open in each mode", "N"},
+  {NULL},
+};
+
+// The benchmark config, with spawn_helper set to helper.
+static bool set_mode (bool helper)
+{
+	char   *filename = g_build_filename (g_get_user_config_dir (), "zterm.conf", NULL);
+	char   *text	 = NULL;
+	GError *error	 = NULL;
+
+	if (!g_file_get_contents (filename, &text, NULL, &error)) {
+		fprintf (stderr, "spawn: %s\n", error->message);
+		g_error_free (error);
+		g_free (filename);
+		return false;
+	}
+
+	GString *config = g_string_new (NULL);
+	char   **lines	= g_strsplit (text, "\n", -1);
+	for (int i = 0; lines[i] != NULL; i++) {
+		if (!g_str_has_prefix (lines[i], "spawn_helper") && lines[i][0] != '\0') {
+			g_string_append_printf (config, "%s\n", lines[i]);
+		}
+	}
+	g_string_append_printf (config, "spawn_helper = %s;\n", helper ? "true" : "false");
+
+	bool ok = g_file_set_contents (filename, config->str, config->len, &error);
+	if (!ok) {
+		fprintf (stderr, "spawn: %s\n", error->message);
+		g_error_free (error);
+	}
+
+	g_strfreev (lines);
+	g_string_free (config, TRUE);
+	g_free (text);
+	g_free (filename);
+	return ok;
+}
+
+static JsonObject *stats (bool reset)
+{
+	JsonBuilder *builder = json_builder_new ();
+
+	bench_command_new (builder, "stats");
+	json_builder_set_member_name (builder, "reset");
+	json_builder_add_boolean_value (builder, reset);
+	JsonObject *reply = bench_request (bench_command_end (builder));
+	g_object_unref (builder);
+
+	return reply;
+}
+
+// Opens terminal 2 with true in it, and waits for it to have exited and closed.
+static bool spawn_one (void)
+{
+	char *argv[] = {"true", NULL};
+
+	bench_switch (2, argv);
+	for (int tries = 0; tries < 2000; tries++) {
+		if (!bench_terms_open (2, 1, NULL)) {
+			return true;
+		}
+		g_usleep (1000);
+	}
+
+	fprintf (stderr, "spawn: Terminal 2 never closed.\n");
+	return false;
+}
+
+static bool run (bool helper)
+{
+	if (!set_mode (helper) || !bench_start (zterm_path, socket_path)) {
+		return false;
+	}
+
+	json_object_unref (stats (true));
+	gint64 start = g_get_monotonic_time ();
+	bool   ok	 = true;
+	for (int i = 0; ok && i < n_spawns; i++) {
+		ok = spawn_one ();
+	}
+	gint64 elapsed = g_get_monotonic_time () - start;
+
+	JsonObject *reply = stats (false);
+	if (ok && json_object_get_boolean_member (reply, "spawn_helper") != helper) {
+		fprintf (stderr, "spawn: zterm did not have spawn_helper %s.\n", helper ? "on" : "off");
+		ok = false;
+	}
+	if (ok) {
+		printf ("{\"mode\": \"%s\", \"spawns\": %" G_GINT64_FORMAT ", \"spawn_avg_us\": %" G_GINT64_FORMAT
+				", \"spawn_max_us\": %" G_GINT64_FORMAT ", \"round_trip_us\": %" G_GINT64_FORMAT "}\n",
+				helper ? "helper" : "direct", json_object_get_int_member (reply, "spawns"),
+				json_object_get_int_member (reply, "spawn_avg_us"), json_object_get_int_member (reply, "spawn_max_us"),
+				elapsed / n_spawns);
+	}
+
+	json_object_unref (reply);
+	bench_stop ();
+	return ok;
+}
+
+int main (int argc, char *argv[])
+{
+	GOptionContext *context = g_option_context_new ("- zterm terminal spawn benchmark");
+	GError		   *error	= NULL;
+
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		fprintf (stderr, "spawn: %s\n", error->message);
+		return 2;
+	}
+	g_option_context_free (context);
+	n_spawns = MAX (n_spawns, 1);
+
+	if (socket_path == NULL) {
+		socket_path = g_build_filename (g_get_user_runtime_dir (), "zterm-bench.sock", NULL);
+	}
+
+	bool ok = run (false) && run (true);
+
+	return ok ? 0 : 1;
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
@@ -0,0 +1,186 @@
+/*
+ * Terminal output throughput benchmark.
+ *
+ * Starts zterm, then drives it through the control socket: each scenario from
+ * gen_output is run in --slots terminals at once, opened with the same switch
+ * path as a key binding, twice over.  Once with the last of them on screen,
+ * and once with all of them in hidden notebook pages behind terminal 1.
+ *
+ * A run is over when every one of its terminals has gone away, which VTE only
+ * lets happen once it has read everything the child wrote.  Each run prints a
+ * line of JSON with the throughput, the time to drain, and the frame clock
+ * stats zterm collected over the run.
+ *
+ * Meant to be run through bench/throughput.sh, which uses bench/headless.sh
+ * to set up a headless display, a private session bus and
+ * bench/zterm-bench.conf, all of which are needed to keep it away from any
+ * zterm already running.
+ *
+ * Usage: throughput [--zterm PATH] [--gen PATH] [--slots N] [--bytes N] [--scenario NAME]...
+ */
+#include "bench_client.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define START_DELAY_MS 500
+#define RUN_TIMEOUT_US (300 * G_USEC_PER_SEC)
+
+static char	 *zterm_path  = "./zterm";
+static char	 *gen_path	  = "./bench/gen_output";
+static char	 *socket_path = NULL;
+static int	  n_slots	  = 1;
+static gint64 n_bytes	  = 32 * 1024 * 1024;
+static char **scenarios	  = NULL;
+
+static const char *default_scenarios[] = {"ascii", "sgr", "wide", "long", "redraw", NULL};
+
+static const GOptionEntry options[] = {
+  {"zterm", 0, 0, G_OPTION_ARG_FILENAME, &zterm_path, "zterm binary to start", "PATH"},
+  {"gen", 0, 0, G_OPTION_ARG_FILENAME, &gen_path, "gen_output binary", "PATH"},
+  {"socket", 0, 0, G_OPTION_ARG_FILENAME, &socket_path, "Control socket, from the benchmark config", "PATH"},
+  {"slots", 'n', 0, G_OPTION_ARG_INT, &n_slots, "Terminals to run each scenario in at once", "N"},
+  {"bytes", 'b', 0, G_OPTION_ARG_INT64, &n_bytes, "Bytes of output per terminal", "N"},
+  {"scenario", 's', 0, G_OPTION_ARG_STRING_ARRAY, &scenarios, "Scenario to run, may be repeated", "NAME"},
+  {NULL},
+};
+
+static JsonObject *stats (bool reset)
+{
+	JsonBuilder *builder = json_builder_new ();
+
+	bench_command_new (builder, "stats");
+	json_builder_set_member_name (builder, "reset");
+	json_builder_add_boolean_value (builder, reset);
+	JsonObject *reply = bench_request (bench_command_end (builder));
+	g_object_unref (builder);
+
+	return reply;
+}
+
+static gint64 read_stamp (const char *filename)
+{
+	char  *contents = NULL;
+	gint64 stamp	= 0;
+
+	if (g_file_get_contents (filename, &contents, NULL, NULL)) {
+		stamp = g_ascii_strtoll (contents, NULL, 10);
+	}
+	g_free (contents);
+
+	return stamp;
+}
+
+static bool run (const char *scenario, bool hidden, const char *tmp_dir)
+{
+	char  *bytes = g_strdup_printf ("%" G_GINT64_FORMAT, n_bytes);
+	char  *delay = g_strdup_printf ("%d", START_DELAY_MS);
+	char **stamp = g_new0 (char *, n_slots + 1);
+	gint64 start = G_MAXINT64, end, deadline = g_get_monotonic_time () + RUN_TIMEOUT_US;
+	bool   ok	 = true;
+
+	json_object_unref (stats (true));
+
+	// Terminal 1 is the idle shell, the generators go in 2 onwards.
+	for (int i = 0; i < n_slots; i++) {
+		stamp[i]	 = g_strdup_printf ("%s/stamp-%d", tmp_dir, i);
+		char *argv[] = {gen_path, (char *) scenario, bytes, delay, stamp[i], NULL};
+		unlink (stamp[i]);
+		bench_switch (2 + i, argv);
+	}
+	if (hidden) {
+		bench_switch (1, NULL);
+	}
+
+	while (ok && bench_terms_open (2, n_slots, NULL)) {
+		if (g_get_monotonic_time () > deadline) {
+			fprintf (stderr, "throughput: %s did not finish in time.\n", scenario);
+			ok = false;
+		}
+		g_usleep (5 * 1000);
+	}
+	end = g_get_monotonic_time ();
+
+	for (int i = 0; ok && i < n_slots; i++) {
+		gint64 stamped = read_stamp (stamp[i]);
+		if (!stamped) {
+			fprintf (stderr, "throughput: %s never started in terminal %d.\n", scenario, 2 + i);
+			ok = false;
+		}
+		start = MIN (start, stamped);
+	}
+
+	if (!ok) {
+		g_strfreev (stamp);
+		g_free (delay);
+		g_free (bytes);
+		return false;
+	}
+
+	JsonObject *frames	= stats (false);
+	double		seconds = (end - start) / (double) G_USEC_PER_SEC;
+	gint64		total	= n_bytes * n_slots;
+
+	printf ("{\"scenario\": \"%s\", \"placement\": \"%s\", \"slots\": %d, \"bytes\": %" G_GINT64_FORMAT
+			", \"drain_s\": %.3f, \"mb_per_s\": %.2f, \"frames\": %" G_GINT64_FORMAT ", \"paint_avg_us\": %" G_GINT64_FORMAT
+			", \"paint_max_us\": %" G_GINT64_FORMAT ", \"frame_gap_max_us\": %" G_GINT64_FORMAT "}\n",
+			scenario, hidden ? "hidden" : "foreground", n_slots, total, seconds, total / seconds / (1024 * 1024),
+			json_object_get_int_member (frames, "frames"), json_object_get_int_member (frames, "paint_avg_us"),
+			json_object_get_int_member (frames, "paint_max_us"), json_object_get_int_member (frames, "frame_gap_max_us"));
+	fflush (stdout);
+
+	json_object_unref (frames);
+	g_strfreev (stamp);
+	g_free (delay);
+	g_free (bytes);
+	return true;
+}
+
+int main (int argc, char *argv[])
+{
+	GOptionContext *context = g_option_context_new ("- zterm output throughput benchmark");
+	GError		   *error	= NULL;
+	bool			ok		= true;
+
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		fprintf (stderr, "throughput: %s\n", error->message);
+		return 2;
+	}
+	g_option_context_free (context);
+
+	if (scenarios == NULL) {
+		scenarios = g_strdupv ((char **) default_scenarios);
+	}
+	if (socket_path == NULL) {
+		socket_path = g_build_filename (g_get_user_runtime_dir (), "zterm-bench.sock", NULL);
+	}
+	n_slots = CLAMP (n_slots, 1, 32);
+
+	char *tmp_dir = g_dir_make_tmp ("zterm-bench-XXXXXX", &error);
+	if (tmp_dir == NULL) {
+		fprintf (stderr, "throughput: %s\n", error->message);
+		return 1;
+	}
+
+	if (!bench_start (zterm_path, socket_path)) {
+		return 1;
+	}
+
+	for (int i = 0; ok && scenarios[i] != NULL; i++) {
+		ok = run (scenarios[i], false, tmp_dir) && run (scenarios[i], true, tmp_dir);
+	}
+
+	bench_stop ();
+	for (int i = 0; i < n_slots; i++) {
+		char *stamp = g_strdup_printf ("%s/stamp-%d", tmp_dir, i);
+		unlink (stamp);
+		g_free (stamp);
+	}
+	rmdir (tmp_dir);
+	g_free (tmp_dir);
+
+	return ok ? 0 : 1;
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
@@ -0,0 +1,5 @@
+#!/bin/bash
+#
+# Runs bench/throughput on a headless display, arguments are passed on to it.
+
+exec "$(dirname "$0")/headless.sh" ./bench/throughput "$@"
@@ -1,29 +1,281 @@
 #include "zterm.h"
+#include <errno.h>
 #include <libconfig.h>
-#include <regex.h>
+#include <pwd.h>
+#include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static config_t *cfg = NULL;
+
+/*
+ * Config generations.
+ *
+ * Everything from the config that the rest of zterm holds pointers into, the
+ * bindings, colors and color schemes, is built into a new config_gen_t by each
+ * load and swapped in whole by config_gen_publish.  A generation is never
+ * changed once published, the preferences dialogs change a copy from
+ * config_gen_edit and publish that instead.
+ *
+ * config_gen holds a reference to the current generation.  The swap happens
+ * on the main thread, so code there can use config_gen as it is for the length
+ * of a handler, and takes a reference to keep a generation past that, as the
+ * binding lists in the preferences do.  The old generation goes away when the
+ * last of those lets go of it.
+ *
+ * Publishing also builds the environment children are spawned with, zterm's
+ * own with the config's env entries set in it, and for each binding with an
+ * env of its own, that with the binding's on top.  A binding's envp is only an
+ * array of pointers, to the strings of the generation's envp and its env, and
+ * zterm's own environment is never changed.
+ *
+ * It also fills in the user's login shell and home directory, as last looked
+ * up by the config thread, so that spawning a shell never waits on NSS.
+ */
+config_gen_t *config_gen		= NULL;
+static guint  config_gen_serial = 0;
+static char	 *config_user_shell = NULL; // From the last load, for config_gen_publish.
+static char	 *config_user_home	= NULL;
+
+config_gen_t *config_gen_new (void)
+{
+	config_gen_t *gen = g_new0 (config_gen_t, 1);
+
+	gen->refs			  = 1;
+	gen->key_bind_mask	  = BIND_MASK_DEFAULT;
+	gen->button_bind_mask = BIND_MASK_DEFAULT;
+	memcpy (gen->colors, default_colors, sizeof (gen->colors));
+
+	return gen;
+}
+
+// A copy of from, with the lists in the same order, ready to be changed and published.
+static config_gen_t *config_gen_copy (const config_gen_t *from)
+{
+	config_gen_t *gen = g_new (config_gen_t, 1);
+
+	*gen				 = *from;
+	gen->refs			 = 1;
+	gen->serial			 = 0;
+	gen->key_table		 = NULL;
+	gen->keys			 = NULL;
+	gen->buttons		 = NULL;
+	gen->ignores		 = NULL;
+	gen->env_vars		 = NULL;
+	gen->color_overrides = NULL;
+	gen->envp			 = NULL;
+	gen->shell			 = NULL;
+	gen->home			 = NULL;
+
+	bind_t **key = &gen->keys;
+	for (const bind_t *cur = from->keys; cur; cur = cur->next, key = &(*key)->next) {
+		*key		 = g_memdup2 (cur, sizeof (*cur));
+		(*key)->argv = g_strdupv (cur->argv);
+		(*key)->env	 = g_strdupv (cur->env);
+		(*key)->envp = NULL;
+	}
+	*key = NULL;
+
+	bind_button_t **button = &gen->buttons;
+	for (const bind_button_t *cur = from->buttons; cur; cur = cur->next, button = &(*button)->next) {
+		*button = g_memdup2 (cur, sizeof (*cur));
+	}
+	*button = NULL;
+
+	bind_ignore_t **ignore = &gen->ignores;
+	for (const bind_ignore_t *cur = from->ignores; cur; cur = cur->next, ignore = &(*ignore)->next) {
+		*ignore = g_memdup2 (cur, sizeof (*cur));
+	}
+	*ignore = NULL;
+
+	color_override_t **override = &gen->color_overrides;
+	for (const color_override_t *cur = from->color_overrides; cur; cur = cur->next, override = &(*override)->next) {
+		*override = g_memdup2 (cur, sizeof (*cur));
+	}
+	*override = NULL;
+
+	env_var_t **env = &gen->env_vars;
+	for (const env_var_t *cur = from->env_vars; cur; cur = cur->next, env = &(*env)->next) {
+		*env		  = g_memdup2 (cur, sizeof (*cur));
+		(*env)->name  = strdup (cur->name);
+		(*env)->value = strdup (cur->value);
+	}
+	*env = NULL;
+
+	return gen;
+}
+
+static void config_gen_free (config_gen_t *gen)
+{
+	key_table_free (gen);
+
+	while (gen->keys != NULL) {
+		bind_t *next = gen->keys->next;
+		g_strfreev (gen->keys->argv);
+		g_strfreev (gen->keys->env);
+		g_free (gen->keys->envp);
+		free (gen->keys);
+		gen->keys = next;
+	}
+
+	while (gen->buttons != NULL) {
+		bind_button_t *next = gen->buttons->next;
+		free (gen->buttons);
+		gen->buttons = next;
+	}
+
+	while (gen->ignores != NULL) {
+		bind_ignore_t *next = gen->ignores->next;
+		free (gen->ignores);
+		gen->ignores = next;
+	}
+
+	while (gen->color_overrides != NULL) {
+		color_override_t *next = gen->color_overrides->next;
+		free (gen->color_overrides);
+		gen->color_overrides = next;
+	}
+
+	while (gen->env_vars != NULL) {
+		env_var_t *next = gen->env_vars->next;
+		free (gen->env_vars->name);
+		free (gen->env_vars->value);
+		free (gen->env_vars);
+		gen->env_vars = next;
+	}
+
+	g_strfreev (gen->envp);
+	g_free (gen->shell);
+	g_free (gen->home);
+	g_free (gen);
+}
+
+config_gen_t *config_gen_ref (config_gen_t *gen)
+{
+	g_atomic_int_inc (&gen->refs);
+	return gen;
+}
+
+void config_gen_unref (config_gen_t *gen)
+{
+	if (gen != NULL && g_atomic_int_dec_and_test (&gen->refs)) {
+		config_gen_free (gen);
+	}
+}
+
+/*
+ * envp with overrides, NAME=value strings, set in it.  Only the array is new,
+ * the strings are still those of envp and overrides, and it's freed with
+ * g_free.
+ */
+char **config_envp_layer (char *const *envp, char *const *overrides)
+{
+	guint  n	 = g_strv_length ((char **) envp);
+	char **layer = g_new (char *, n + g_strv_length ((char **) overrides) + 1);
+
+	memcpy (layer, envp, n * sizeof (char *));
+	for (int i = 0; overrides[i] != NULL; i++) {
+		const char *eq = strchr (overrides[i], '=');
+		guint		j  = 0;
+
+		if (eq == NULL || eq == overrides[i]) {
+			continue;
+		}
+		while (j < n && strncmp (layer[j], overrides[i], eq - overrides[i] + 1)) {
+			j++;
+		}
+		layer[j] = overrides[i];
+		n		 = MAX (n, j + 1);
+	}
+	layer[n] = NULL;
+
+	return layer;
+}
+
+static void config_gen_envp_build (config_gen_t *gen)
+{
+	char **envp = g_get_environ ();
+	guint  n	= 0;
 
-static config_t cfg;
-static bool		cfg_initialized = false;
+	// env_vars has the last in the config first, set them the other way around so it still wins.
+	for (const env_var_t *cur = gen->env_vars; cur; cur = cur->next) {
+		n++;
+	}
+	const env_var_t **vars = g_new (const env_var_t *, n);
+	n					   = 0;
+	for (const env_var_t *cur = gen->env_vars; cur; cur = cur->next) {
+		vars[n++] = cur;
+	}
+	while (n > 0) {
+		n--;
+		envp = g_environ_setenv (envp, vars[n]->name, vars[n]->value, TRUE);
+	}
+	g_free (vars);
+
+	g_strfreev (gen->envp);
+	gen->envp = envp;
+
+	for (bind_t *cur = gen->keys; cur; cur = cur->next) {
+		g_free (cur->envp);
+		cur->envp = cur->env != NULL ? config_envp_layer (gen->envp, cur->env) : NULL;
+	}
+}
+
+// Makes gen the current generation, taking over the caller's reference to it.
+void config_gen_publish (config_gen_t *gen)
+{
+	gen->serial = ++config_gen_serial;
+	key_table_build (gen);
+	config_gen_envp_build (gen);
+	g_free (gen->shell);
+	g_free (gen->home);
+	gen->shell = g_strdup (config_user_shell != NULL ? config_user_shell : "/bin/sh");
+	gen->home  = g_strdup (config_user_home != NULL ? config_user_home : g_get_home_dir ());
+
+	config_gen_t *old = g_atomic_pointer_exchange (&config_gen, gen);
+	TRACE ("config_gen", gen->serial, old != NULL ? old->serial : 0);
+	config_gen_unref (old);
+}
+
+// A private copy of the current generation, for the preferences to change and publish.
+config_gen_t *config_gen_edit (void)
+{
+	return config_gen_copy (config_gen);
+}
 
-static int zregcomp (regex_t *restrict preg, const char *restrict regex, int cflags)
+// The copy's version of bind, a binding from the current generation, NULL if it's no longer in it.
+bind_t *config_gen_edit_key (config_gen_t *copy, const bind_t *bind)
 {
-	int ret = regcomp (preg, regex, cflags);
-	if (ret) {
-		char errbuf[128] = {0};
+	bind_t *mine = copy->keys;
 
-		regerror (ret, preg, errbuf, sizeof (errbuf) - 1);
-		errorf ("regcomp failed: %d (%s) for regex '%s'", ret, errbuf, regex);
+	for (const bind_t *cur = config_gen->keys; cur && mine; cur = cur->next, mine = mine->next) {
+		if (cur == bind) {
+			return mine;
+		}
 	}
+	return NULL;
+}
+
+bind_button_t *config_gen_edit_button (config_gen_t *copy, const bind_button_t *bind)
+{
+	bind_button_t *mine = copy->buttons;
 
-	return ret;
+	for (const bind_button_t *cur = config_gen->buttons; cur && mine; cur = cur->next, mine = mine->next) {
+		if (cur == bind) {
+			return mine;
+		}
+	}
+	return NULL;
 }
 
-static void zterm_parse_bind_switch (int base, char *state, char *key_min, char *key_max, char **argv, char **env)
+static void zterm_parse_bind_switch (config_gen_t *gen, int base, char *state, char *key_min, char *key_max, char **argv,
+									 char **env)
 {
 	bind_t *bind = calloc (1, sizeof (bind_t));
-	bind->next	 = terms.keys;
-	terms.keys	 = bind;
+	bind->next	 = gen->keys;
+	gen->keys	 = bind;
 
 	bind->action = BIND_ACT_SWITCH;
 	bind->base = base, bind->state = strtol (state, NULL, 0);
@@ -44,6 +296,17 @@ static void zterm_parse_bind_switch (int base, char *state, char *key_min, char
 	else
 		bind->key_max = bind->key_min;
 
+	// Each key in the range is a terminal, and an entry in the key table.
+	if (bind->key_max >= bind->key_min && bind->key_max - bind->key_min >= MAX_BIND_RANGE) {
+		errorf ("Error: %s-%s is over %d keys, skipping bind: %d %s %s-%s", key_min, key_max, MAX_BIND_RANGE, base, state,
+				key_min, key_max);
+		gen->keys = bind->next;
+		g_strfreev (argv);
+		g_strfreev (env);
+		free (bind);
+		return;
+	}
+
 	bind->argv = argv;
 	bind->env  = env;
 
@@ -55,18 +318,7 @@ static void zterm_parse_bind_switch (int base, char *state, char *key_min, char
 	}
 }
 
-static void temu_parse_bind_switch (char **subs)
-{
-	int	   base = strtol (subs[0], NULL, 0);
-	char **argv = NULL;
-	if (subs[6]) {
-		argv = &subs[6];
-	}
-
-	zterm_parse_bind_switch (base, subs[1], subs[2], subs[4], argv, NULL);
-}
-
-static void zterm_parse_bind_action (char *action, char *state, char *key)
+static void zterm_parse_bind_action (config_gen_t *gen, char *action, char *state, char *key)
 {
 	char	bind_str[128] = {0};
 	bind_t *bind		  = calloc (1, sizeof (bind_t));
@@ -91,8 +343,8 @@ static void zterm_parse_bind_action (char *action, char *state, char *key)
 		return;
 	}
 
-	bind->next = terms.keys;
-	terms.keys = bind;
+	bind->next = gen->keys;
+	gen->keys  = bind;
 
 	// The new style is actually a GTK accelerator string, but with only the modifier component.
 	snprintf (bind_str, sizeof (bind_str) - 1, "%s%s", state, key);
@@ -119,12 +371,7 @@ static void zterm_parse_bind_action (char *action, char *state, char *key)
 			key);
 }
 
-static void temu_parse_bind_action (char **subs)
-{
-	zterm_parse_bind_action (subs[0], subs[1], subs[2]);
-}
-
-static void zterm_parse_bind_button (char *action, char *state, int button)
+static void zterm_parse_bind_button (config_gen_t *gen, char *action, char *state, int button)
 {
 	bind_button_t *bind = calloc (1, sizeof (bind_button_t));
 
@@ -141,8 +388,8 @@ static void zterm_parse_bind_button (char *action, char *state, int button)
 
 	bind->button = button;
 
-	bind->next	  = terms.buttons;
-	terms.buttons = bind;
+	bind->next	 = gen->buttons;
+	gen->buttons = bind;
 
 	int ret = gtk_accelerator_parse (state, NULL, &bind->state);
 	debugf ("Parsing '%s' as partial accelerator, result: state: 0x%x, button: %d, ret: %d", state, bind->state, bind->button,
@@ -152,7 +399,7 @@ static void zterm_parse_bind_button (char *action, char *state, int button)
 		if (bind->state) {
 			debugf ("Parsing '%s' as numeric value, result: state: 0x%x, button: %d, ret: %d", state, bind->state, bind->button,
 					ret);
-			button_bind_mask |= bind->state;
+			gen->button_bind_mask |= bind->state;
 		} else {
 			errorf ("Error: Unable to parse '%s' as GTK Accelerator, skipping bind: %s %s %d", state, action, state, button);
 			return;
@@ -172,12 +419,7 @@ static void zterm_parse_bind_button (char *action, char *state, int button)
 	g_free (name);
 }
 
-static void temu_parse_bind_button (char **subs)
-{
-	zterm_parse_bind_button (subs[0], subs[1], strtol (subs[2], NULL, 0));
-}
-
-static void zterm_parse_bind_ignore (char *state_input)
+static void zterm_parse_bind_ignore (config_gen_t *gen, char *state_input)
 {
 	guint key, state;
 
@@ -190,272 +432,475 @@ static void zterm_parse_bind_ignore (char *state_input)
 		exit (1);
 	}
 
-	key_bind_mask &= ~state;
-	button_bind_mask &= ~state;
+	gen->key_bind_mask &= ~state;
+	gen->button_bind_mask &= ~state;
 
 	/* Track the ignore for saving */
 	bind_ignore_t *ignore = calloc (1, sizeof (bind_ignore_t));
 	ignore->state		  = state;
-	ignore->next		  = terms.ignores;
-	terms.ignores		  = ignore;
+	ignore->next		  = gen->ignores;
+	gen->ignores		  = ignore;
 }
 
-static void temu_parse_bind_ignore (char **subs)
+// What zterm_parse_config and temu_parse_config keep outside of the config generation.
+static void zterm_free_settings (void)
 {
-	zterm_parse_bind_ignore (subs[0]);
+	match_regexes_free ();
+
+	g_strfreev (terms.match_patterns);
+	terms.match_patterns = NULL;
 }
 
-static void zterm_free_settings (void)
+static void zterm_parse_color (config_gen_t *gen, int index, const char *value)
 {
-	while (terms.keys != NULL) {
-		bind_t *next = terms.keys->next;
+	if (index < 0 || index >= (int) G_N_ELEMENTS (gen->colors)) {
+		return;
+	}
 
-		free (terms.keys);
+	gdk_rgba_parse (&gen->colors[index], value);
 
-		terms.keys = next;
+	/* Track the color override for saving */
+	color_override_t *override = calloc (1, sizeof (color_override_t));
+	override->index			   = index;
+	override->color			   = gen->colors[index];
+	override->next			   = gen->color_overrides;
+	gen->color_overrides	   = override;
+}
+
+// Set in the environment of children, by config_gen_envp_build.
+static void zterm_parse_env (config_gen_t *gen, const char *name, const char *value)
+{
+	if (name == NULL || value == NULL) {
+		return;
 	}
 
-	while (terms.ignores != NULL) {
-		bind_ignore_t *next = terms.ignores->next;
-		free (terms.ignores);
-		terms.ignores = next;
+	env_var_t *env = calloc (1, sizeof (env_var_t));
+	env->name	   = strdup (name);
+	env->value	   = strdup (value);
+	env->next	   = gen->env_vars;
+	gen->env_vars  = env;
+}
+
+/*
+ * The legacy config, ~/.zterm/config, is parsed in a single pass over the
+ * file as read by the config thread.  Each line is copied into a buffer on
+ * the stack and split into words in place, so nothing is allocated for a line
+ * unless a setting keeps part of it.  Problems are reported with the file,
+ * line and column.
+ *
+ * A line is blank, a # comment, or "directive: arguments".
+ */
+
+#define LEGACY_LINE_MAX 4096
+
+typedef struct legacy_line_s {
+	config_gen_t *gen; // Being built.
+	const char	 *filename;
+	int			  number;
+	char		 *pos; // The first character in buf not yet taken.
+	char		  buf[LEGACY_LINE_MAX];
+} legacy_line_t;
+
+static void legacy_error (legacy_line_t *line, const char *at, const char *fmt, ...) __attribute__ ((format (printf, 3, 4)));
+
+static void legacy_error (legacy_line_t *line, const char *at, const char *fmt, ...)
+{
+	char	message[256];
+	va_list ap;
+
+	va_start (ap, fmt);
+	vsnprintf (message, sizeof (message), fmt, ap);
+	va_end (ap);
+
+	errorf ("%s:%d:%d: %s", line->filename, line->number, (int) (at - line->buf) + 1, message);
+}
+
+static char *legacy_skip (char *p)
+{
+	while (*p == ' ' || *p == '\t') {
+		p++;
+	}
+	return p;
+}
+
+// The next word, or NULL at the end of the line.
+static char *legacy_word (legacy_line_t *line)
+{
+	char *start = legacy_skip (line->pos);
+	char *end	= start;
+
+	while (*end != '\0' && *end != ' ' && *end != '\t') {
+		end++;
+	}
+
+	line->pos = *end != '\0' ? end + 1 : end;
+	*end	  = '\0';
+	return end != start ? start : NULL;
+}
+
+// The next word, which has to be there.
+static char *legacy_need (legacy_line_t *line, const char *what)
+{
+	char *word = legacy_word (line);
+
+	if (word == NULL) {
+		legacy_error (line, line->pos, "expected %s", what);
+	}
+	return word;
+}
+
+// Everything left on the line, which has to be something.
+static char *legacy_rest (legacy_line_t *line, const char *what)
+{
+	char *start = legacy_skip (line->pos);
+
+	line->pos = start + strlen (start);
+	if (*start == '\0') {
+		legacy_error (line, start, "expected %s", what);
+		return NULL;
+	}
+	return start;
+}
+
+static bool legacy_end (legacy_line_t *line)
+{
+	char *extra = legacy_skip (line->pos);
+
+	if (*extra != '\0') {
+		legacy_error (line, extra, "unexpected '%s'", extra);
+		return false;
 	}
+	return true;
+}
+
+static bool legacy_number (legacy_line_t *line, const char *word, long *value)
+{
+	char *end;
+
+	errno  = 0;
+	*value = strtol (word, &end, 0);
+	if (end == word || *end != '\0' || errno) {
+		legacy_error (line, word, "expected a number, not '%s'", word);
+		return false;
+	}
+	return true;
+}
 
-	while (terms.color_overrides != NULL) {
-		color_override_t *next = terms.color_overrides->next;
-		free (terms.color_overrides);
-		terms.color_overrides = next;
+// Splits the last word off text, which has no trailing blanks, leaving text with what was before it.
+static char *legacy_last_word (char *text)
+{
+	char *word = text + strlen (text);
+
+	while (word > text && word[-1] != ' ' && word[-1] != '\t') {
+		word--;
 	}
 
-	while (terms.env_vars != NULL) {
-		env_var_t *next = terms.env_vars->next;
-		free (terms.env_vars->name);
-		free (terms.env_vars->value);
-		free (terms.env_vars);
-		terms.env_vars = next;
+	char *end = word;
+	while (end > text && (end[-1] == ' ' || end[-1] == '\t')) {
+		end--;
 	}
+	if (end != word) {
+		*end = '\0';
+	}
+	return word;
 }
 
-static void zterm_parse_color (int index, const char *value)
+/*
+ * bind: <base> <state> <key_min>[-<key_max>] [command]
+ * bind: <action> <state> <key>
+ *
+ * The command of a switch binding is run through /bin/sh -c, see term_spawn.
+ */
+static void legacy_bind (legacy_line_t *line)
 {
-	if (index < 0 || index >= (int) (sizeof (colors) / sizeof (colors[0]))) {
+	char *first = legacy_need (line, "a terminal number or an action");
+	char *state, *key_min, *key_max, *command;
+	long  base;
+
+	if (first == NULL || (state = legacy_need (line, "a modifier state")) == NULL ||
+		(key_min = legacy_need (line, "a key")) == NULL) {
 		return;
 	}
 
-	gdk_rgba_parse (&colors[index], value);
+	if (!g_ascii_isdigit (first[0])) {
+		if (legacy_end (line)) {
+			zterm_parse_bind_action (line->gen, first, state, key_min);
+		}
+		return;
+	}
 
-	/* Track the color override for saving */
-	color_override_t *override = calloc (1, sizeof (color_override_t));
-	override->index			   = index;
-	override->color			   = colors[index];
-	override->next			   = terms.color_overrides;
-	terms.color_overrides	   = override;
+	if (!legacy_number (line, first, &base)) {
+		return;
+	}
+
+	key_max = strchr (key_min + 1, '-');
+	if (key_max != NULL) {
+		*key_max++ = '\0';
+		if (*key_max == '\0') {
+			legacy_error (line, key_max, "expected a key after '-'");
+			return;
+		}
+	}
+
+	char **argv = NULL;
+	command		= legacy_skip (line->pos);
+	if (*command != '\0') {
+		argv	= g_new0 (char *, 2);
+		argv[0] = g_strdup (command);
+	}
+
+	zterm_parse_bind_switch (line->gen, base, state, key_min, key_max, argv, NULL);
 }
 
-static void temu_parse_color (char **subs)
+// bind_button: <action> <state> <button>
+static void legacy_bind_button (legacy_line_t *line)
 {
-	int n = strtol (subs[0], NULL, 0);
-	zterm_parse_color (n, subs[1]);
+	char *action, *state, *button;
+	long  n;
+
+	if ((action = legacy_need (line, "an action")) != NULL && (state = legacy_need (line, "a modifier state")) != NULL &&
+		(button = legacy_need (line, "a button number")) != NULL && legacy_number (line, button, &n) && legacy_end (line)) {
+		zterm_parse_bind_button (line->gen, action, state, n);
+	}
 }
 
-static void temu_parse_font (char **subs)
+// ignore_mod: <state>
+static void legacy_ignore_mod (legacy_line_t *line)
 {
-	if (terms.font)
-		free (terms.font);
-	terms.font = strdup (subs[0]);
+	char *state = legacy_need (line, "a modifier state");
+
+	if (state != NULL && legacy_end (line)) {
+		zterm_parse_bind_ignore (line->gen, state);
+	}
 }
 
-static void temu_parse_size (char **subs)
+// color: <index> <color>
+static void legacy_color (legacy_line_t *line)
 {
-	start_width	 = strtol (subs[0], NULL, 10);
-	start_height = strtol (subs[1], NULL, 10);
+	char *index = legacy_need (line, "a color index"), *value;
+	long  n;
+
+	if (index != NULL && legacy_number (line, index, &n) && (value = legacy_rest (line, "a color")) != NULL) {
+		zterm_parse_color (line->gen, n, value);
+	}
 }
 
-static void gen_subs (char *str, char *subs[], regmatch_t matches[], size_t count)
+// color_scheme: <name, which may have spaces> <#foreground> <#background>
+static void legacy_color_scheme (legacy_line_t *line, int *n_color_scheme)
 {
-	int i;
+	char *name = legacy_rest (line, "a name and two colors");
 
-	for (i = 1; i < count; i++) {
-		if (matches[i].rm_so != -1) {
-			int len = matches[i].rm_eo - matches[i].rm_so;
-			if (subs[i - 1] != NULL) {
-				free (subs[i - 1]);
-				subs[i - 1] = NULL;
-			}
-			subs[i - 1] = calloc (1, len + 1);
-			memcpy (subs[i - 1], str + matches[i].rm_so, len);
-		}
+	if (name == NULL) {
+		return;
 	}
+
+	char *background = legacy_last_word (name);
+	char *foreground = background != name ? legacy_last_word (name) : name;
+
+	if (foreground == name) {
+		legacy_error (line, name, "expected a name and two colors");
+		return;
+	}
+
+	if (*n_color_scheme >= MAX_COLOR_SCHEMES) {
+		legacy_error (line, name, "too many color schemes, '%s' is ignored", name);
+		return;
+	}
+
+	color_scheme_t *scheme = &line->gen->color_schemes[*n_color_scheme];
+	if (foreground[0] != '#' || !gdk_rgba_parse (&scheme->foreground, foreground)) {
+		legacy_error (line, foreground, "expected a #rrggbb color, not '%s'", foreground);
+		return;
+	}
+	if (background[0] != '#' || !gdk_rgba_parse (&scheme->background, background)) {
+		legacy_error (line, background, "expected a #rrggbb color, not '%s'", background);
+		return;
+	}
+
+	strlcpy (scheme->name, name, sizeof (scheme->name));
+	snprintf (scheme->action, sizeof (scheme->action), "color_scheme.%d", *n_color_scheme);
+	(*n_color_scheme)++;
 }
 
-static void free_subs (char *subs[], size_t count)
+// size: <width>x<height>
+static void legacy_size (legacy_line_t *line)
 {
-	int i;
-	for (i = 0; i < count; i++) {
-		if (subs[i] != NULL) {
-			free (subs[i]);
-			subs[i] = NULL;
-		}
+	char *size = legacy_need (line, "a size"), *end;
+
+	if (size == NULL) {
+		return;
+	}
+
+	long width = strtol (size, &end, 10);
+	if (end == size || *end != 'x') {
+		legacy_error (line, end, "expected <width>x<height>");
+		return;
+	}
+
+	char *height_start = end + 1;
+	long  height	   = strtol (height_start, &end, 10);
+	if (end == height_start || *end != '\0') {
+		legacy_error (line, end, "expected <width>x<height>");
+		return;
+	}
+
+	if (legacy_end (line)) {
+		start_width	 = width;
+		start_height = height;
 	}
 }
 
-// REG_ENHANCED does not exist on Linux, but we still want to compile. (I know, picky picky.)
-#ifndef REG_ENHANCED
-#	define REG_ENHANCED 0
-#endif
-
-bool temu_parse_config (void)
-{
-#define MATCHES 16
-	regex_t	   bind_action, bind_button, bind_switch, bind_ignore, color, color_scheme, font, size, env, other;
-	regmatch_t regexp_matches[MATCHES];
-	char	  *subs[MATCHES] = {0};
-	FILE	  *f;
-	char	  *file = NULL;
-	long	   f_len;
-	int		   j, ret;
-	char	  *t1, *t2;
-	char	   conffile[512] = {0};
-	size_t	   read;
-	int		   n_color_scheme = 0;
-
-	zregcomp (&bind_action, "^bind:[ \t]+([a-zA-Z_]+)[ \t]+([^\\s]+)[ \t]+([a-zA-Z0-9_]+)$", REG_ENHANCED | REG_EXTENDED);
-	zregcomp (&bind_button, "^bind_button:[ \t]+([a-zA-Z_]+)[ \t]+([^\\s]+)[ \t]+([0-9_]+)$", REG_ENHANCED | REG_EXTENDED);
-	zregcomp (&bind_switch, "^bind:[ \t]+([0-9]+)[ \t]+([^\\s]+)[ \t]+([a-zA-Z0-9_]+)(-([a-zA-Z0-9_]+))?([ \t]+(.*?)+)?$",
-			  REG_ENHANCED | REG_EXTENDED);
-
-	zregcomp (&bind_ignore, "^ignore_mod:[ \t]+([^ \t]+)$", REG_ENHANCED | REG_EXTENDED);
-	zregcomp (&color, "^color:[ \t]+([0-9]+)[ \t]+(.*?)$", REG_ENHANCED | REG_EXTENDED);
-	zregcomp (&color_scheme, "^color_scheme:[ \t]+([-a-zA-Z0-9_ ]*?)[ \t]+(#[0-9a-fA-F]+)[ \t]+(#[0-9a-fA-F]+)$",
-			  REG_ENHANCED | REG_EXTENDED);
-	zregcomp (&font, "^font:[ \t]+(.*?)$", REG_ENHANCED | REG_EXTENDED);
-	zregcomp (&size, "^size:[ \t]+([0-9]+)x([0-9]+)$", REG_ENHANCED | REG_EXTENDED);
-	zregcomp (&env, "^env:[ \t]+([^=]*?)=(.*?)$", REG_ENHANCED | REG_EXTENDED);
-	zregcomp (&other, "^([^: ]*):[ \t]+(.*?)$", REG_ENHANCED | REG_EXTENDED);
+// env: <name>=<value>
+static void legacy_env (legacy_line_t *line)
+{
+	char *name = legacy_rest (line, "<name>=<value>");
+	char *value;
 
-	zterm_free_settings ();
-	// FIXME: We need to correctly handle the case where this number changes with a reload, it's going to be a bit rough.
-	terms.n_active = 0;
+	if (name == NULL) {
+		return;
+	}
 
-	snprintf (conffile, sizeof (conffile) - 1, "%s/.zterm/config", getenv ("HOME"));
-	f = fopen (conffile, "r");
-	if (!f)
-		goto done;
-	fseek (f, 0, SEEK_END);
-	f_len = ftell (f);
-	fseek (f, 0, SEEK_SET);
-	file = calloc (1, f_len + 1);
-	read = fread (file, f_len, 1, f);
-	fclose (f);
-	if (read != 1)
-		goto done;
-
-	t1 = file;
-	while (*t1) {
-		t2	  = strchr (t1, '\n');
-		*t2++ = '\0';
-
-		j = t1[0] == '#' ? 1 : 0;
-		if (!j) {
-			j = t1[0] == '\0' ? 1 : 0;
-		}
+	value = strchr (name, '=');
+	if (value == NULL || value == name) {
+		legacy_error (line, value != NULL ? value : name, "expected <name>=<value>");
+		return;
+	}
 
-#define add_regex(name)                                                                                                          \
-	do {                                                                                                                         \
-		if (!j) {                                                                                                                \
-			ret = regexec (&name, t1, MATCHES, regexp_matches, 0);                                                               \
-			if (!ret) {                                                                                                          \
-				debugf ();                                                                                                       \
-				gen_subs (t1, subs, regexp_matches, MATCHES);                                                                    \
-				temu_parse_##name (subs);                                                                                        \
-				free_subs (subs, MATCHES);                                                                                       \
-				j++;                                                                                                             \
-			}                                                                                                                    \
-		}                                                                                                                        \
-	} while (0)
-
-		add_regex (bind_action);
-		add_regex (bind_switch);
-		add_regex (bind_ignore);
-		add_regex (bind_button);
-		add_regex (color);
-		add_regex (font);
-		add_regex (size);
-
-		if (!j && n_color_scheme < (sizeof (terms.color_schemes) / sizeof (terms.color_schemes[0]))) {
-			ret = regexec (&color_scheme, t1, MATCHES, regexp_matches, 0);
-			if (!ret) {
-				gen_subs (t1, subs, regexp_matches, MATCHES);
-				strlcpy (terms.color_schemes[n_color_scheme].name, subs[0], sizeof (terms.color_schemes[n_color_scheme].name));
-				snprintf (terms.color_schemes[n_color_scheme].action, sizeof (terms.color_schemes[n_color_scheme].action),
-						  "color_scheme.%d", n_color_scheme);
-				gdk_rgba_parse (&terms.color_schemes[n_color_scheme].foreground, subs[1]);
-				gdk_rgba_parse (&terms.color_schemes[n_color_scheme].background, subs[2]);
-				n_color_scheme++;
-				free_subs (subs, MATCHES);
-				j++;
-			}
-		}
+	*value++ = '\0';
+	zterm_parse_env (line->gen, name, value);
+}
 
-		if (!j) {
-			ret = regexec (&env, t1, MATCHES, regexp_matches, 0);
-			if (!ret) {
-				gen_subs (t1, subs, regexp_matches, MATCHES);
-				setenv (subs[0], subs[1], 1);
-				free_subs (subs, MATCHES);
-				j++;
-			}
-		}
+// Anything else with a single value.
+static void legacy_option (legacy_line_t *line, const char *name)
+{
+	char *value = legacy_rest (line, "a value");
 
-		if (!j) {
-			ret = regexec (&other, t1, MATCHES, regexp_matches, 0);
-			if (!ret) {
-				gen_subs (t1, subs, regexp_matches, MATCHES);
-				if (!strcmp (subs[0], "audible_bell")) {
-					terms.audible_bell = atoi (subs[1]);
-				} else if (!strcmp (subs[0], "word_char_exceptions")) {
-					strlcpy (terms.word_char_exceptions, subs[1], sizeof (terms.word_char_exceptions));
-				} else if (!strcmp (subs[0], "font_scale")) {
-					terms.font_scale = atof (subs[1]);
-				} else if (!strcmp (subs[0], "scroll_on_output")) {
-					terms.scroll_on_output = atoi (subs[1]);
-				} else if (!strcmp (subs[0], "scroll_on_keystroke")) {
-					terms.scroll_on_keystroke = atoi (subs[1]);
-				} else if (!strcmp (subs[0], "scrollback_lines")) {
-					terms.scrollback_lines = atoi (subs[1]);
-				} else if (!strcmp (subs[0], "bold_is_bright")) {
-					terms.bold_is_bright = atoi (subs[1]);
-				} else if (!strcmp (subs[0], "mouse_autohide")) {
-					terms.mouse_autohide = atoi (subs[1]);
-				} else {
-					errorf ("Unable to parse line in config: '%s' (%s)", t1, subs[0]);
-				}
-				free_subs (subs, MATCHES);
-				j++;
-			}
+	if (value == NULL) {
+		return;
+	}
+
+	if (!strcmp (name, "font")) {
+		free (terms.font);
+		terms.font = strdup (value);
+	} else if (!strcmp (name, "audible_bell")) {
+		terms.audible_bell = atoi (value);
+	} else if (!strcmp (name, "word_char_exceptions")) {
+		free (terms.word_char_exceptions);
+		terms.word_char_exceptions = strdup (value);
+	} else if (!strcmp (name, "font_scale")) {
+		terms.font_scale = atof (value);
+	} else if (!strcmp (name, "scroll_on_output")) {
+		terms.scroll_on_output = atoi (value);
+	} else if (!strcmp (name, "scroll_on_keystroke")) {
+		terms.scroll_on_keystroke = atoi (value);
+	} else if (!strcmp (name, "scrollback_lines")) {
+		terms.scrollback_lines = atoi (value);
+	} else if (!strcmp (name, "scrollback_budget")) {
+		terms.scrollback_budget = atoi (value);
+	} else if (!strcmp (name, "bold_is_bright")) {
+		terms.bold_is_bright = atoi (value);
+	} else if (!strcmp (name, "mouse_autohide")) {
+		terms.mouse_autohide = atoi (value);
+	} else if (!strcmp (name, "pool_size")) {
+		terms.pool_size = atoi (value);
+	} else if (!strcmp (name, "pool_prespawn")) {
+		terms.pool_prespawn = atoi (value);
+	} else if (!strcmp (name, "fast_start")) {
+		terms.fast_start = atoi (value);
+	} else if (!strcmp (name, "auto_reload")) {
+		terms.auto_reload = atoi (value);
+	} else if (!strcmp (name, "latency_stats")) {
+		terms.latency_stats = atoi (value);
+	} else if (!strcmp (name, "watchdog_ms")) {
+		terms.watchdog_ms = atoi (value);
+	} else if (!strcmp (name, "trace_buffer")) {
+		terms.trace_buffer = atoi (value);
+	} else if (!strcmp (name, "spawn_helper")) {
+		terms.spawn_helper = atoi (value);
+	} else {
+		legacy_error (line, line->buf, "unknown setting '%s'", name);
+	}
+}
+
+static void legacy_parse_line (legacy_line_t *line, int *n_color_scheme)
+{
+	char *name = legacy_skip (line->buf);
+	char *colon;
+
+	if (*name == '\0' || *name == '#') {
+		return;
+	}
+
+	for (colon = name; *colon != ':' && *colon != '\0' && *colon != ' ' && *colon != '\t'; colon++) {
+	}
+	if (*colon != ':') {
+		legacy_error (line, colon, "expected ':' after '%.*s'", (int) (colon - name), name);
+		return;
+	}
+	*colon	  = '\0';
+	line->pos = colon + 1;
+
+	if (!strcmp (name, "bind")) {
+		legacy_bind (line);
+	} else if (!strcmp (name, "bind_button")) {
+		legacy_bind_button (line);
+	} else if (!strcmp (name, "ignore_mod")) {
+		legacy_ignore_mod (line);
+	} else if (!strcmp (name, "color")) {
+		legacy_color (line);
+	} else if (!strcmp (name, "color_scheme")) {
+		legacy_color_scheme (line, n_color_scheme);
+	} else if (!strcmp (name, "size")) {
+		legacy_size (line);
+	} else if (!strcmp (name, "env")) {
+		legacy_env (line);
+	} else {
+		legacy_option (line, name);
+	}
+}
+
+// Takes the legacy config, ~/.zterm/config, as read by config_load_run, or NULL if there isn't one.
+static void temu_parse_config (const char *filename, const char *data, gsize len)
+{
+	PROBE ();
+
+	legacy_line_t line;
+	const char	 *end			 = data + len;
+	int			  n_color_scheme = 0;
+
+	zterm_free_settings ();
+	// FIXME: We need to correctly handle the case where this number changes with a reload, it's going to be a bit rough.
+	terms.n_active = 0;
+
+	line.gen	  = config_gen_new ();
+	line.filename = filename;
+	line.number	  = 0;
+	for (const char *p = data; p != NULL && p < end;) {
+		const char *eol		 = memchr (p, '\n', end - p);
+		const char *next	 = eol != NULL ? eol + 1 : end;
+		gsize		line_len = (eol != NULL ? eol : end) - p;
+
+		line.number++;
+		if (line_len >= sizeof (line.buf)) {
+			line.buf[0] = '\0';
+			legacy_error (&line, line.buf, "line is over %d characters long, skipped", LEGACY_LINE_MAX - 1);
+			p = next;
+			continue;
 		}
 
-		if (!j) {
-			errorf ("Unable to parse line in config: '%s'", t1);
+		// Trailing blanks, and the \r of a CRLF file, are never part of a value.
+		while (line_len > 0 && (p[line_len - 1] == ' ' || p[line_len - 1] == '\t' || p[line_len - 1] == '\r')) {
+			line_len--;
 		}
+		memcpy (line.buf, p, line_len);
+		line.buf[line_len] = '\0';
+		line.pos		   = line.buf;
 
-		t1 = t2;
+		legacy_parse_line (&line, &n_color_scheme);
+		p = next;
 	}
 
-done:
-	regfree (&bind_action);
-	regfree (&bind_button);
-	regfree (&bind_switch);
-	regfree (&bind_ignore);
-	regfree (&color);
-	regfree (&color_scheme);
-	regfree (&font);
-	regfree (&size);
-	regfree (&env);
-	regfree (&other);
-	free (file);
-
-	return true;
+	config_gen_publish (line.gen);
 }
 
 char **get_config_str_vec (config_t *cfg, const char *path)
@@ -475,22 +920,6 @@ char **get_config_str_vec (config_t *cfg, const char *path)
 	return g_strdupv ((char **) vec);
 }
 
-static void zterm_parse_env (const char *name, const char *value)
-{
-	if (name == NULL || value == NULL) {
-		return;
-	}
-
-	setenv (name, value, 1);
-
-	/* Track the env var for saving */
-	env_var_t *env = calloc (1, sizeof (env_var_t));
-	env->name	   = strdup (name);
-	env->value	   = strdup (value);
-	env->next	   = terms.env_vars;
-	terms.env_vars = env;
-}
-
 const char *zterm_config_file ()
 {
 	static char conffile[512] = {0};
@@ -505,31 +934,30 @@ const char *zterm_config_file ()
 	return conffile;
 }
 
-bool zterm_parse_config ()
+// Applies zterm.conf, as read by config_load_run, and keeps it for zterm_save_config.
+static void zterm_parse_config (config_t *loaded)
 {
-	if (cfg_initialized) {
-		config_destroy (&cfg);
-		cfg_initialized = false;
+	PROBE ();
+
+	if (cfg != NULL) {
+		config_destroy (cfg);
+		g_free (cfg);
 	}
-	config_init (&cfg);
-	cfg_initialized = true;
+	cfg = loaded;
 
-	const char *filename = zterm_config_file ();
+	config_gen_t *gen = config_gen_new ();
 
-	if (!config_read_file (&cfg, filename)) {
-		errorf ("Unable to read config file '%s': %s at line %d", filename, config_error_text (&cfg), config_error_line (&cfg));
-		return false;
-	}
+	zterm_free_settings ();
 
 	/* Parse environment variables */
-	config_setting_t *env_setting = config_lookup (&cfg, "env");
+	config_setting_t *env_setting = config_lookup (cfg, "env");
 	if (env_setting != NULL) {
 		int n = config_setting_length (env_setting);
 		for (int i = 0; i < n; i++) {
 			config_setting_t *item	= config_setting_get_elem (env_setting, i);
 			const char		 *name	= config_setting_name (item);
 			const char		 *value = config_setting_get_string (item);
-			zterm_parse_env (name, value);
+			zterm_parse_env (gen, name, value);
 		}
 	}
 
@@ -538,52 +966,95 @@ bool zterm_parse_config ()
 	int			int_value;
 	double		double_value;
 
-	if (config_lookup_string (&cfg, "font", &str_value)) {
+	if (config_lookup_string (cfg, "font", &str_value)) {
 		if (terms.font)
 			free (terms.font);
 		terms.font = strdup (str_value);
 	}
 
-	if (config_lookup_string (&cfg, "word_char_exceptions", &str_value)) {
+	if (config_lookup_string (cfg, "control_socket", &str_value)) {
+		free (terms.control_socket);
+		terms.control_socket = strdup (str_value);
+	}
+
+	if (config_lookup_string (cfg, "word_char_exceptions", &str_value)) {
 		if (terms.word_char_exceptions)
 			free (terms.word_char_exceptions);
 		terms.word_char_exceptions = strdup (str_value);
 	}
 
-	if (config_lookup_bool (&cfg, "audible_bell", &int_value)) {
+	if (config_lookup_bool (cfg, "audible_bell", &int_value)) {
 		terms.audible_bell = int_value ? true : false;
 	}
 
-	if (config_lookup_float (&cfg, "font_scale", &double_value)) {
+	if (config_lookup_float (cfg, "font_scale", &double_value)) {
 		terms.font_scale = double_value;
 	}
 
-	if (config_lookup_bool (&cfg, "scroll_on_output", &int_value)) {
+	if (config_lookup_bool (cfg, "scroll_on_output", &int_value)) {
 		terms.scroll_on_output = int_value ? true : false;
 	}
 
-	if (config_lookup_bool (&cfg, "scroll_on_keystroke", &int_value)) {
+	if (config_lookup_bool (cfg, "scroll_on_keystroke", &int_value)) {
 		terms.scroll_on_keystroke = int_value ? true : false;
 	}
 
-	if (config_lookup_int (&cfg, "scrollback_lines", &int_value)) {
+	if (config_lookup_int (cfg, "scrollback_lines", &int_value)) {
 		terms.scrollback_lines = int_value;
 	}
 
-	if (config_lookup_bool (&cfg, "bold_is_bright", &int_value)) {
+	if (config_lookup_int (cfg, "scrollback_budget", &int_value)) {
+		terms.scrollback_budget = int_value;
+	}
+
+	if (config_lookup_bool (cfg, "bold_is_bright", &int_value)) {
 		terms.bold_is_bright = int_value ? true : false;
 	}
 
-	if (config_lookup_bool (&cfg, "mouse_autohide", &int_value)) {
+	if (config_lookup_bool (cfg, "mouse_autohide", &int_value)) {
 		terms.mouse_autohide = int_value ? true : false;
 	}
 
-	if (config_lookup_string (&cfg, "size", &str_value)) {
+	if (config_lookup_int (cfg, "pool_size", &int_value)) {
+		terms.pool_size = int_value;
+	}
+
+	if (config_lookup_bool (cfg, "pool_prespawn", &int_value)) {
+		terms.pool_prespawn = int_value ? true : false;
+	}
+
+	if (config_lookup_bool (cfg, "fast_start", &int_value)) {
+		terms.fast_start = int_value ? true : false;
+	}
+
+	if (config_lookup_bool (cfg, "auto_reload", &int_value)) {
+		terms.auto_reload = int_value ? true : false;
+	}
+
+	if (config_lookup_bool (cfg, "latency_stats", &int_value)) {
+		terms.latency_stats = int_value ? true : false;
+	}
+
+	if (config_lookup_int (cfg, "watchdog_ms", &int_value)) {
+		terms.watchdog_ms = int_value;
+	}
+
+	if (config_lookup_bool (cfg, "trace_buffer", &int_value)) {
+		terms.trace_buffer = int_value ? true : false;
+	}
+
+	if (config_lookup_bool (cfg, "spawn_helper", &int_value)) {
+		terms.spawn_helper = int_value ? true : false;
+	}
+
+	terms.match_patterns = get_config_str_vec (cfg, "match_patterns");
+
+	if (config_lookup_string (cfg, "size", &str_value)) {
 		sscanf (str_value, "%dx%d", &start_width, &start_height);
 	}
 
 	/* Parse color overrides */
-	config_setting_t *color_list = config_lookup (&cfg, "color");
+	config_setting_t *color_list = config_lookup (cfg, "color");
 	if (color_list != NULL) {
 		int n = config_setting_length (color_list);
 		for (int i = 0; i < n; i++) {
@@ -591,18 +1062,18 @@ bool zterm_parse_config ()
 			int				  index;
 			const char		 *value;
 			if (config_setting_lookup_int (color, "index", &index) && config_setting_lookup_string (color, "value", &value)) {
-				if (index >= 0 && index < (int) (sizeof (colors) / sizeof (colors[0]))) {
-					zterm_parse_color (index, value);
+				if (index >= 0 && index < (int) G_N_ELEMENTS (gen->colors)) {
+					zterm_parse_color (gen, index, value);
 				} else {
 					errorf ("%s:%d Invalid color index %d, max is %d", config_setting_source_file (color),
-							config_setting_source_line (color), index, (int) (sizeof (colors) / sizeof (colors[0])) - 1);
+							config_setting_source_line (color), index, (int) G_N_ELEMENTS (gen->colors) - 1);
 				}
 			}
 		}
 	}
 
 	/* Parse color schemes */
-	config_setting_t *scheme_list = config_lookup (&cfg, "color_schemes");
+	config_setting_t *scheme_list = config_lookup (cfg, "color_schemes");
 	if (scheme_list != NULL) {
 		int n = config_setting_length (scheme_list);
 		for (int i = 0; i < n && i < MAX_COLOR_SCHEMES; i++) {
@@ -615,14 +1086,14 @@ bool zterm_parse_config ()
 			}
 
 			debugf ("Parsing color scheme '%s'", name);
-			strlcpy (terms.color_schemes[i].name, name, sizeof (terms.color_schemes[i].name));
-			snprintf (terms.color_schemes[i].action, sizeof (terms.color_schemes[i].action), "color_scheme.%d", i);
+			strlcpy (gen->color_schemes[i].name, name, sizeof (gen->color_schemes[i].name));
+			snprintf (gen->color_schemes[i].action, sizeof (gen->color_schemes[i].action), "color_scheme.%d", i);
 
 			if (config_setting_lookup_string (scheme, "foreground", &fg)) {
-				gdk_rgba_parse (&terms.color_schemes[i].foreground, fg);
+				gdk_rgba_parse (&gen->color_schemes[i].foreground, fg);
 			}
 			if (config_setting_lookup_string (scheme, "background", &bg)) {
-				gdk_rgba_parse (&terms.color_schemes[i].background, bg);
+				gdk_rgba_parse (&gen->color_schemes[i].background, bg);
 			}
 		}
 		if (n > MAX_COLOR_SCHEMES) {
@@ -631,7 +1102,7 @@ bool zterm_parse_config ()
 	}
 
 	/* Parse bind_action entries */
-	config_setting_t *bind_action_list = config_lookup (&cfg, "bind_action");
+	config_setting_t *bind_action_list = config_lookup (cfg, "bind_action");
 	if (bind_action_list != NULL) {
 		int n = config_setting_length (bind_action_list);
 		for (int i = 0; i < n; i++) {
@@ -639,13 +1110,13 @@ bool zterm_parse_config ()
 			const char		 *action, *state, *key;
 			if (config_setting_lookup_string (bind, "action", &action) && config_setting_lookup_string (bind, "state", &state) &&
 				config_setting_lookup_string (bind, "key", &key)) {
-				zterm_parse_bind_action ((char *) action, (char *) state, (char *) key);
+				zterm_parse_bind_action (gen, (char *) action, (char *) state, (char *) key);
 			}
 		}
 	}
 
 	/* Parse bind_button_action entries */
-	config_setting_t *bind_button_list = config_lookup (&cfg, "bind_button_action");
+	config_setting_t *bind_button_list = config_lookup (cfg, "bind_button_action");
 	if (bind_button_list != NULL) {
 		int n = config_setting_length (bind_button_list);
 		for (int i = 0; i < n; i++) {
@@ -654,13 +1125,13 @@ bool zterm_parse_config ()
 			int				  button;
 			if (config_setting_lookup_string (bind, "action", &action) && config_setting_lookup_string (bind, "state", &state) &&
 				config_setting_lookup_int (bind, "button", &button)) {
-				zterm_parse_bind_button ((char *) action, (char *) state, button);
+				zterm_parse_bind_button (gen, (char *) action, (char *) state, button);
 			}
 		}
 	}
 
 	/* Parse bind_switch entries */
-	config_setting_t *bind_switch_list = config_lookup (&cfg, "bind_switch");
+	config_setting_t *bind_switch_list = config_lookup (cfg, "bind_switch");
 	if (bind_switch_list != NULL) {
 		int n = config_setting_length (bind_switch_list);
 		for (int i = 0; i < n; i++) {
@@ -680,27 +1151,459 @@ bool zterm_parse_config ()
 			char **argv = NULL;
 			char **env	= NULL;
 
-			argv = get_config_str_vec (&cfg, "cmd");
-			env	 = get_config_str_vec (&cfg, "env");
+			argv = get_config_str_vec (cfg, "cmd");
+			env	 = get_config_str_vec (cfg, "env");
 
-			zterm_parse_bind_switch (base, (char *) state, (char *) key_min, (char *) key_max, argv, env);
+			zterm_parse_bind_switch (gen, base, (char *) state, (char *) key_min, (char *) key_max, argv, env);
 		}
 	}
 
 	/* Parse bind_ignore entries */
-	config_setting_t *bind_ignore_list = config_lookup (&cfg, "bind_ignore");
+	config_setting_t *bind_ignore_list = config_lookup (cfg, "bind_ignore");
 	if (bind_ignore_list != NULL) {
 		int n = config_setting_length (bind_ignore_list);
 		for (int i = 0; i < n; i++) {
 			config_setting_t *bind = config_setting_get_elem (bind_ignore_list, i);
 			const char		 *state;
 			if (config_setting_lookup_string (bind, "state", &state)) {
-				zterm_parse_bind_ignore ((char *) state);
+				zterm_parse_bind_ignore (gen, (char *) state);
 			}
 		}
 	}
 
-	return true;
+	config_gen_publish (gen);
+}
+
+/*
+ * Reading the config happens on a thread of its own, so that a slow home
+ * directory never holds up the main loop.  The thread reads and parses
+ * zterm.conf into a config_t, or if it can't, reads in the legacy config.
+ * Nothing touches that until the main thread has joined it, and applies it
+ * to terms.
+ *
+ * main starts the first load before g_application_run, for activate to pick
+ * up, and reloads go through the same thread, being applied from an idle.
+ */
+typedef struct config_load_s {
+	char	 *filename;
+	char	 *legacy_filename;
+	bool	  reload;
+	char	 *previous;	 // What zterm.conf had in it last time, for a reload by the watcher.
+	bool	  unchanged; // Which it still does.
+	char	 *text;		 // As read, for next time.
+	config_t *cfg;		 // zterm.conf, if it could be read.
+	char	 *error;	 // Otherwise, why not.
+	char	 *legacy;	 // And the legacy config, if there is one.
+	gsize	  legacy_len;
+	char	 *shell;	 // The user's login shell and home directory, from the password database.
+	char	 *home;
+} config_load_t;
+
+static GThread *config_thread		 = NULL;
+static bool		config_reload_queued = false; // Asked for while a reload was already running.
+static bool		config_queued_watch	 = false; // And only by the watcher.
+static bool		config_thread_watch	 = false; // Whether the running load is only for the watcher.
+static bool		config_from_file	 = false; // What we have came from zterm.conf, not the legacy config.
+static char	   *config_text			 = NULL;  // What zterm.conf has in it, as last read or saved by us.
+
+static gboolean config_reload_ready (gpointer data);
+
+/*
+ * Looks the user up, for their login shell and home directory, which can take
+ * a while with LDAP or the like.  Without them, $SHELL or /bin/sh, as VTE
+ * does, and $HOME.
+ */
+static void config_load_user (config_load_t *load)
+{
+	struct passwd  pwd;
+	struct passwd *pass = NULL;
+	long		   len	= MAX (sysconf (_SC_GETPW_R_SIZE_MAX), 16384);
+	char		  *buf	= g_malloc (len);
+	int			   err;
+
+	// Entries with a lot of groups or a long gecos can outgrow what sysconf suggests.
+	while ((err = getpwuid_r (getuid (), &pwd, buf, len, &pass)) == ERANGE && len < 1024 * 1024) {
+		len *= 2;
+		buf = g_realloc (buf, len);
+	}
+
+	if (pass == NULL) {
+		errorf ("Unable to look up user %d: %s", (int) getuid (), err ? strerror (err) : "no such user");
+	}
+
+	if (pass != NULL && pass->pw_shell != NULL && pass->pw_shell[0] != '\0') {
+		load->shell = g_strdup (pass->pw_shell);
+	} else if (g_getenv ("SHELL") != NULL) {
+		load->shell = g_strdup (g_getenv ("SHELL"));
+	} else {
+		load->shell = g_strdup ("/bin/sh");
+	}
+	if (pass != NULL && pass->pw_dir != NULL && pass->pw_dir[0] != '\0') {
+		load->home = g_strdup (pass->pw_dir);
+	} else {
+		load->home = g_strdup (g_get_home_dir ());
+	}
+	g_free (buf);
+}
+
+static gpointer config_load_run (gpointer data)
+{
+	config_load_t *load	 = data;
+	GError		  *error = NULL;
+
+	config_load_user (load);
+
+	if (!g_file_get_contents (load->filename, &load->text, NULL, &error)) {
+		load->error = g_strdup (error->message);
+		g_error_free (error);
+	} else if (load->previous != NULL && !strcmp (load->text, load->previous)) {
+		// Our own save, or an editor writing out what was already there.
+		load->unchanged = true;
+	} else {
+		load->cfg = g_new (config_t, 1);
+		config_init (load->cfg);
+		if (!config_read_string (load->cfg, load->text)) {
+			load->error = g_strdup_printf ("%s at line %d", config_error_text (load->cfg), config_error_line (load->cfg));
+			config_destroy (load->cfg);
+			g_free (load->cfg);
+			load->cfg = NULL;
+		}
+	}
+
+	if (load->cfg == NULL && !load->unchanged) {
+		// Read rather than mapped, so a slow home directory never faults on the main thread.
+		g_file_get_contents (load->legacy_filename, &load->legacy, &load->legacy_len, NULL);
+	}
+
+	if (load->reload) {
+		g_idle_add (config_reload_ready, NULL);
+	}
+	return load;
+}
+
+/*
+ * Starts reading the config, for config_load_apply.  A reload from the watcher
+ * does nothing if zterm.conf is as it was, as for our own saves, one from the
+ * user always applies it again.
+ */
+void config_load_start (bool reload, bool watched)
+{
+	if (config_thread != NULL) {
+		config_queued_watch	 = watched && (config_queued_watch || !config_reload_queued);
+		config_reload_queued = reload;
+		return;
+	}
+
+	config_load_t *load	  = g_new0 (config_load_t, 1);
+	load->filename		  = g_strdup (zterm_config_file ());
+	load->legacy_filename = g_build_filename (g_get_home_dir (), ".zterm", "config", NULL);
+	load->reload		  = reload;
+	load->previous		  = reload && watched ? g_strdup (config_text) : NULL;
+
+	config_thread_watch = watched;
+	config_thread		= g_thread_new ("config", config_load_run, load);
+}
+
+static void config_load_free (config_load_t *load)
+{
+	if (load->cfg != NULL) {
+		config_destroy (load->cfg);
+		g_free (load->cfg);
+	}
+	g_free (load->filename);
+	g_free (load->legacy_filename);
+	g_free (load->previous);
+	g_free (load->text);
+	g_free (load->error);
+	g_free (load->shell);
+	g_free (load->home);
+	g_free (load->legacy);
+	g_free (load);
+}
+
+/*
+ * Waits for the config_load_start to finish, if it hasn't, and applies what
+ * it read.  False if that was nothing new, or defined no terminals.
+ *
+ * On a reload, a zterm.conf that can't be read leaves the config as it was,
+ * unless that came from the legacy config to begin with.
+ */
+bool config_load_apply (void)
+{
+	bool applied = true;
+
+	if (config_thread == NULL) {
+		return false;
+	}
+
+	config_load_t *load = g_thread_join (config_thread);
+	config_thread		= NULL;
+
+	g_free (config_user_shell);
+	g_free (config_user_home);
+	config_user_shell = g_steal_pointer (&load->shell);
+	config_user_home  = g_steal_pointer (&load->home);
+
+	if (load->unchanged) {
+		applied = false;
+	} else if (load->cfg != NULL) {
+		zterm_parse_config (load->cfg);
+		load->cfg		 = NULL;
+		config_from_file = true;
+		g_free (config_text);
+		config_text = g_steal_pointer (&load->text);
+	} else if (load->reload && config_from_file) {
+		errorf ("Unable to read config file '%s': %s, keeping the current config.", load->filename, load->error);
+		applied = false;
+	} else {
+		errorf ("Unable to read config file '%s': %s", load->filename, load->error);
+		errorf ("Unable to read new config, falling back to legacy config.");
+		temu_parse_config (load->legacy_filename, load->legacy, load->legacy_len);
+
+		// So that saving the preferences writes out a zterm.conf.
+		if (cfg == NULL) {
+			cfg = g_new (config_t, 1);
+			config_init (cfg);
+		}
+	}
+	config_load_free (load);
+
+	// Whatever became of the config, the user's shell or home directory may have changed.
+	if (config_gen != NULL && (g_strcmp0 (config_gen->shell, config_user_shell) ||
+							   g_strcmp0 (config_gen->home, config_user_home))) {
+		config_gen_publish (config_gen_edit ());
+	}
+
+	if (applied && !terms.n_active) {
+		errorf ("Unable to read config file, or no terminals defined.");
+		return false;
+	}
+	return applied;
+}
+
+static gboolean config_reload_ready (gpointer data)
+{
+	int	 old_n_active = terms.n_active;
+	bool by_user	  = !config_thread_watch;
+
+	if (config_load_apply ()) {
+		config_reloaded (old_n_active, by_user);
+	}
+
+	if (config_reload_queued) {
+		config_reload_queued = false;
+		config_load_start (true, config_queued_watch);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+// At exit, in case a load is still running.
+void config_load_stop (void)
+{
+	if (config_thread != NULL) {
+		config_load_free (g_thread_join (config_thread));
+		config_thread = NULL;
+	}
+}
+
+/*
+ * Saving.  The config is serialized on the main thread, and written out by a
+ * worker through a temporary file, fsync and rename, so the file is never
+ * seen half written and a slow home directory never holds up the main loop.
+ *
+ * There is only ever one write at a time, and a save that comes in while
+ * one is running replaces whatever was still waiting, so a burst of edits
+ * ends up as one or two writes.
+ */
+typedef struct config_save_s {
+	char  *filename;
+	char  *data;
+	size_t len;
+} config_save_t;
+
+static GThreadPool	 *config_save_pool	  = NULL;
+static GMutex		  config_save_lock;
+static config_save_t *config_save_pending = NULL; // Under config_save_lock.
+
+static void config_save_free (config_save_t *save)
+{
+	g_free (save->filename);
+	free (save->data);
+	g_free (save);
+}
+
+static void config_save_run (gpointer data, gpointer user_data)
+{
+	GError *error = NULL;
+
+	g_mutex_lock (&config_save_lock);
+	config_save_t *save = config_save_pending;
+	config_save_pending = NULL;
+	g_mutex_unlock (&config_save_lock);
+
+	// Already written, along with a later save.
+	if (save == NULL) {
+		return;
+	}
+
+	/*
+	 * The rename that makes the write atomic would replace a symlink, as in a
+	 * dotfiles checkout, with a file of its own, so write where it points, and
+	 * keep the file's permissions.
+	 */
+	char	   *target = realpath (save->filename, NULL);
+	struct stat st;
+	int			mode   = 0666;
+
+	if (target != NULL && stat (target, &st) == 0) {
+		mode = st.st_mode & 07777;
+	}
+
+	if (!g_file_set_contents_full (target != NULL ? target : save->filename, save->data, save->len,
+								   G_FILE_SET_CONTENTS_CONSISTENT | G_FILE_SET_CONTENTS_DURABLE, mode, &error)) {
+		errorf ("Unable to save config: %s", error->message);
+		g_error_free (error);
+	}
+	free (target);
+	config_save_free (save);
+}
+
+static void config_save_queue (void)
+{
+	config_save_t *save = g_new0 (config_save_t, 1);
+	FILE		  *io	= open_memstream (&save->data, &save->len);
+
+	if (io == NULL) {
+		errorf ("Unable to save config: %s", strerror (errno));
+		g_free (save);
+		return;
+	}
+	config_write (cfg, io);
+	fclose (io);
+	save->filename = g_strdup (zterm_config_file ());
+
+	// So that watching the file doesn't reload what we just saved.
+	g_free (config_text);
+	config_text = g_strndup (save->data, save->len);
+
+	if (config_save_pool == NULL) {
+		config_save_pool = g_thread_pool_new (config_save_run, NULL, 1, false, NULL);
+	}
+
+	g_mutex_lock (&config_save_lock);
+	if (config_save_pending != NULL) {
+		config_save_free (config_save_pending);
+	}
+	config_save_pending = save;
+	g_mutex_unlock (&config_save_lock);
+
+	g_thread_pool_push (config_save_pool, GINT_TO_POINTER (1), NULL);
+}
+
+// At exit, waits for any save still being written.
+void config_save_finish (void)
+{
+	if (config_save_pool != NULL) {
+		g_thread_pool_free (config_save_pool, false, true);
+		config_save_pool = NULL;
+	}
+}
+
+/*
+ * With auto_reload, watching zterm.conf for changes.
+ *
+ * Editors save by writing a new file and renaming it over the old one, or
+ * by truncating and writing in several goes, so this watches the directory
+ * the config is in, and that of the file a symlink points to, and waits for
+ * the changes to stop for CONFIG_WATCH_DELAY_MS before reloading.
+ */
+#define CONFIG_WATCH_DELAY_MS 300
+
+static GFileMonitor *config_monitors[2] = {NULL};
+static char			*config_watched[2]	= {NULL}; // The file's name, in each directory.
+static guint		 config_watch_timer = 0;
+
+static gboolean config_watch_fire (gpointer data)
+{
+	config_watch_timer = 0;
+	infof ("Config file changed, reloading.");
+	config_load_start (true, true);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void config_watch_changed (GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event,
+								  gpointer user_data)
+{
+	const char *watched = config_watched[GPOINTER_TO_INT (user_data)];
+	char	   *name	= g_file_get_basename (file);
+	char	   *other	= other_file ? g_file_get_basename (other_file) : NULL;
+	bool		ours	= !strcmp (name, watched) || (other && !strcmp (other, watched));
+
+	g_free (name);
+	g_free (other);
+	if (!ours || event == G_FILE_MONITOR_EVENT_DELETED || event == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED) {
+		return;
+	}
+
+	if (config_watch_timer) {
+		g_source_remove (config_watch_timer);
+	}
+	config_watch_timer = g_timeout_add (CONFIG_WATCH_DELAY_MS, config_watch_fire, NULL);
+}
+
+void config_watch_stop (void)
+{
+	for (int i = 0; i < 2; i++) {
+		if (config_monitors[i] != NULL) {
+			g_file_monitor_cancel (config_monitors[i]);
+			g_clear_object (&config_monitors[i]);
+		}
+		g_free (config_watched[i]);
+		config_watched[i] = NULL;
+	}
+	if (config_watch_timer) {
+		g_source_remove (config_watch_timer);
+		config_watch_timer = 0;
+	}
+}
+
+static void config_watch_add (int i, const char *path)
+{
+	char   *dir_name = g_path_get_dirname (path);
+	GFile  *dir		 = g_file_new_for_path (dir_name);
+	GError *error	 = NULL;
+
+	config_monitors[i] = g_file_monitor_directory (dir, G_FILE_MONITOR_WATCH_MOVES, NULL, &error);
+	if (config_monitors[i] == NULL) {
+		errorf ("Unable to watch '%s' for config changes: %s", dir_name, error->message);
+		g_error_free (error);
+	} else {
+		config_watched[i] = g_path_get_basename (path);
+		g_signal_connect (config_monitors[i], "changed", G_CALLBACK (config_watch_changed), GINT_TO_POINTER (i));
+	}
+
+	g_object_unref (dir);
+	g_free (dir_name);
+}
+
+// Starts or stops watching to match terms.auto_reload.
+void config_watch_start (void)
+{
+	const char *filename = zterm_config_file ();
+
+	config_watch_stop ();
+	if (!terms.auto_reload) {
+		return;
+	}
+
+	config_watch_add (0, filename);
+
+	char *resolved = realpath (filename, NULL);
+	if (resolved != NULL && strcmp (resolved, filename)) {
+		config_watch_add (1, resolved);
+	}
+	free (resolved);
 }
 
 static const char *bind_action_to_string (bind_actions_t action)
@@ -777,48 +1680,65 @@ static void set_config_float (config_t *cfg, const char *path, double value)
 
 void zterm_save_config ()
 {
-	if (!cfg_initialized) {
+	PROBE ();
+
+	const config_gen_t *gen = config_gen;
+
+	if (cfg == NULL) {
 		return;
 	}
 
 	/* Save simple settings */
 	if (terms.font != NULL) {
-		set_config_string (&cfg, "font", terms.font);
+		set_config_string (cfg, "font", terms.font);
 	}
 
 	if (terms.word_char_exceptions != NULL) {
-		set_config_string (&cfg, "word_char_exceptions", terms.word_char_exceptions);
-	}
-
-	set_config_bool (&cfg, "audible_bell", terms.audible_bell);
-	set_config_float (&cfg, "font_scale", terms.font_scale);
-	set_config_bool (&cfg, "scroll_on_output", terms.scroll_on_output);
-	set_config_bool (&cfg, "scroll_on_keystroke", terms.scroll_on_keystroke);
-	set_config_int (&cfg, "scrollback_lines", terms.scrollback_lines);
-	set_config_bool (&cfg, "bold_is_bright", terms.bold_is_bright);
-	set_config_bool (&cfg, "mouse_autohide", terms.mouse_autohide);
+		set_config_string (cfg, "word_char_exceptions", terms.word_char_exceptions);
+	}
+
+	if (terms.control_socket != NULL) {
+		set_config_string (cfg, "control_socket", terms.control_socket);
+	}
+
+	set_config_bool (cfg, "audible_bell", terms.audible_bell);
+	set_config_float (cfg, "font_scale", terms.font_scale);
+	set_config_bool (cfg, "scroll_on_output", terms.scroll_on_output);
+	set_config_bool (cfg, "scroll_on_keystroke", terms.scroll_on_keystroke);
+	set_config_int (cfg, "scrollback_lines", terms.scrollback_lines);
+	set_config_int (cfg, "scrollback_budget", terms.scrollback_budget);
+	set_config_bool (cfg, "bold_is_bright", terms.bold_is_bright);
+	set_config_bool (cfg, "mouse_autohide", terms.mouse_autohide);
+	set_config_int (cfg, "pool_size", terms.pool_size);
+	set_config_bool (cfg, "pool_prespawn", terms.pool_prespawn);
+	set_config_bool (cfg, "fast_start", terms.fast_start);
+	set_config_bool (cfg, "auto_reload", terms.auto_reload);
+	set_config_bool (cfg, "latency_stats", terms.latency_stats);
+	set_config_int (cfg, "watchdog_ms", terms.watchdog_ms);
+	set_config_bool (cfg, "trace_buffer", terms.trace_buffer);
+	set_config_bool (cfg, "spawn_helper", terms.spawn_helper);
 
 	/* Save size */
 	char size_str[32];
 	snprintf (size_str, sizeof (size_str), "%dx%d", start_width, start_height);
-	set_config_string (&cfg, "size", size_str);
+	set_config_string (cfg, "size", size_str);
 
 	/* Save color schemes */
-	config_setting_t *scheme_list = config_lookup (&cfg, "color_schemes");
+	config_setting_t *scheme_list = config_lookup (cfg, "color_schemes");
 	if (scheme_list != NULL) {
-		config_setting_remove (config_root_setting (&cfg), "color_schemes");
+		config_setting_remove (config_root_setting (cfg), "color_schemes");
 	}
-	scheme_list = config_setting_add (config_root_setting (&cfg), "color_schemes", CONFIG_TYPE_LIST);
-	for (int i = 0; i < MAX_COLOR_SCHEMES && terms.color_schemes[i].name[0]; i++) {
+	scheme_list = config_setting_add (config_root_setting (cfg), "color_schemes", CONFIG_TYPE_LIST);
+	for (int i = 0; i < MAX_COLOR_SCHEMES && gen->color_schemes[i].name[0]; i++) {
 		config_setting_t *scheme = config_setting_add (scheme_list, NULL, CONFIG_TYPE_GROUP);
 		config_setting_t *name	 = config_setting_add (scheme, "name", CONFIG_TYPE_STRING);
-		config_setting_set_string (name, terms.color_schemes[i].name);
+		config_setting_set_string (name, gen->color_schemes[i].name);
 
 		char fg_str[32], bg_str[32];
-		snprintf (fg_str, sizeof (fg_str), "#%02x%02x%02x", (int) (terms.color_schemes[i].foreground.red * 255),
-				  (int) (terms.color_schemes[i].foreground.green * 255), (int) (terms.color_schemes[i].foreground.blue * 255));
-		snprintf (bg_str, sizeof (bg_str), "#%02x%02x%02x", (int) (terms.color_schemes[i].background.red * 255),
-				  (int) (terms.color_schemes[i].background.green * 255), (int) (terms.color_schemes[i].background.blue * 255));
+		snprintf (fg_str, sizeof (fg_str), "#%02x%02x%02x", (int) (gen->color_schemes[i].foreground.red * 255),
+				  (int) (gen->color_schemes[i].foreground.green * 255), (int) (gen->color_schemes[i].foreground.blue * 255));
+		snprintf (bg_str, sizeof (bg_str), "#%02x%02x%02x", (int) (gen->color_schemes[i].background.red * 255),
+				  (int) (gen->color_schemes[i].background.green * 255), (int) (gen->color_schemes[i].background.blue * 255));
 
 		config_setting_t *fg = config_setting_add (scheme, "foreground", CONFIG_TYPE_STRING);
 		config_setting_set_string (fg, fg_str);
@@ -827,12 +1747,12 @@ void zterm_save_config ()
 	}
 
 	/* Save bind_action entries (non-switch key bindings) */
-	config_setting_t *bind_action_list = config_lookup (&cfg, "bind_action");
+	config_setting_t *bind_action_list = config_lookup (cfg, "bind_action");
 	if (bind_action_list != NULL) {
-		config_setting_remove (config_root_setting (&cfg), "bind_action");
+		config_setting_remove (config_root_setting (cfg), "bind_action");
 	}
-	bind_action_list = config_setting_add (config_root_setting (&cfg), "bind_action", CONFIG_TYPE_LIST);
-	for (bind_t *cur = terms.keys; cur; cur = cur->next) {
+	bind_action_list = config_setting_add (config_root_setting (cfg), "bind_action", CONFIG_TYPE_LIST);
+	for (bind_t *cur = gen->keys; cur; cur = cur->next) {
 		if (cur->action == BIND_ACT_SWITCH) {
 			continue; /* Switch bindings are saved separately */
 		}
@@ -859,12 +1779,12 @@ void zterm_save_config ()
 	}
 
 	/* Save bind_button_action entries */
-	config_setting_t *bind_button_list = config_lookup (&cfg, "bind_button_action");
+	config_setting_t *bind_button_list = config_lookup (cfg, "bind_button_action");
 	if (bind_button_list != NULL) {
-		config_setting_remove (config_root_setting (&cfg), "bind_button_action");
+		config_setting_remove (config_root_setting (cfg), "bind_button_action");
 	}
-	bind_button_list = config_setting_add (config_root_setting (&cfg), "bind_button_action", CONFIG_TYPE_LIST);
-	for (bind_button_t *cur = terms.buttons; cur; cur = cur->next) {
+	bind_button_list = config_setting_add (config_root_setting (cfg), "bind_button_action", CONFIG_TYPE_LIST);
+	for (bind_button_t *cur = gen->buttons; cur; cur = cur->next) {
 		const char *action_str = bind_action_to_string (cur->action);
 		if (action_str == NULL) {
 			continue;
@@ -885,12 +1805,12 @@ void zterm_save_config ()
 	}
 
 	/* Save bind_switch entries */
-	config_setting_t *bind_switch_list = config_lookup (&cfg, "bind_switch");
+	config_setting_t *bind_switch_list = config_lookup (cfg, "bind_switch");
 	if (bind_switch_list != NULL) {
-		config_setting_remove (config_root_setting (&cfg), "bind_switch");
+		config_setting_remove (config_root_setting (cfg), "bind_switch");
 	}
-	bind_switch_list = config_setting_add (config_root_setting (&cfg), "bind_switch", CONFIG_TYPE_LIST);
-	for (bind_t *cur = terms.keys; cur; cur = cur->next) {
+	bind_switch_list = config_setting_add (config_root_setting (cfg), "bind_switch", CONFIG_TYPE_LIST);
+	for (bind_t *cur = gen->keys; cur; cur = cur->next) {
 		if (cur->action != BIND_ACT_SWITCH) {
 			continue;
 		}
@@ -939,12 +1859,12 @@ void zterm_save_config ()
 	}
 
 	/* Save bind_ignore entries */
-	config_setting_t *bind_ignore_list = config_lookup (&cfg, "bind_ignore");
+	config_setting_t *bind_ignore_list = config_lookup (cfg, "bind_ignore");
 	if (bind_ignore_list != NULL) {
-		config_setting_remove (config_root_setting (&cfg), "bind_ignore");
+		config_setting_remove (config_root_setting (cfg), "bind_ignore");
 	}
-	bind_ignore_list = config_setting_add (config_root_setting (&cfg), "bind_ignore", CONFIG_TYPE_LIST);
-	for (bind_ignore_t *cur = terms.ignores; cur; cur = cur->next) {
+	bind_ignore_list = config_setting_add (config_root_setting (cfg), "bind_ignore", CONFIG_TYPE_LIST);
+	for (bind_ignore_t *cur = gen->ignores; cur; cur = cur->next) {
 		config_setting_t *bind	= config_setting_add (bind_ignore_list, NULL, CONFIG_TYPE_GROUP);
 		config_setting_t *state = config_setting_add (bind, "state", CONFIG_TYPE_STRING);
 
@@ -954,12 +1874,12 @@ void zterm_save_config ()
 	}
 
 	/* Save color overrides */
-	config_setting_t *color_list = config_lookup (&cfg, "color");
+	config_setting_t *color_list = config_lookup (cfg, "color");
 	if (color_list != NULL) {
-		config_setting_remove (config_root_setting (&cfg), "color");
+		config_setting_remove (config_root_setting (cfg), "color");
 	}
-	color_list = config_setting_add (config_root_setting (&cfg), "color", CONFIG_TYPE_LIST);
-	for (color_override_t *cur = terms.color_overrides; cur; cur = cur->next) {
+	color_list = config_setting_add (config_root_setting (cfg), "color", CONFIG_TYPE_LIST);
+	for (color_override_t *cur = gen->color_overrides; cur; cur = cur->next) {
 		config_setting_t *color = config_setting_add (color_list, NULL, CONFIG_TYPE_GROUP);
 		config_setting_t *index = config_setting_add (color, "index", CONFIG_TYPE_INT);
 		config_setting_t *value = config_setting_add (color, "value", CONFIG_TYPE_STRING);
@@ -973,18 +1893,17 @@ void zterm_save_config ()
 	}
 
 	/* Save environment variables */
-	config_setting_t *env_list = config_lookup (&cfg, "env");
+	config_setting_t *env_list = config_lookup (cfg, "env");
 	if (env_list != NULL) {
-		config_setting_remove (config_root_setting (&cfg), "env");
+		config_setting_remove (config_root_setting (cfg), "env");
 	}
-	env_list = config_setting_add (config_root_setting (&cfg), "env", CONFIG_TYPE_GROUP);
-	for (env_var_t *cur = terms.env_vars; cur; cur = cur->next) {
+	env_list = config_setting_add (config_root_setting (cfg), "env", CONFIG_TYPE_GROUP);
+	for (env_var_t *cur = gen->env_vars; cur; cur = cur->next) {
 		config_setting_t *var = config_setting_add (env_list, cur->name, CONFIG_TYPE_STRING);
 		config_setting_set_string (var, cur->value);
 	}
 
-	const char *filename = zterm_config_file ();
-	config_write_file (&cfg, filename);
+	config_save_queue ();
 }
 
 // vim: set ts=4 sw=4 noexpandtab :
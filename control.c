@@ -0,0 +1,714 @@
+#include "zterm.h"
+
+#include <errno.h>
+#include <gio/gunixsocketaddress.h>
+#include <json-glib/json-glib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * The control socket, for automation that needs more than zterm-ctl.
+ *
+ * Opt in with control_socket in zterm.conf, a path, relative to
+ * $XDG_RUNTIME_DIR unless absolute.  The socket is only accessible by us.
+ *
+ * The protocol is line delimited JSON.  Each line is a command object, or
+ * an array of them to run as a batch, and gets exactly one line back, in
+ * order, so clients can pipeline as much as they like:
+ *
+ *   {"cmd": "switch", "target": "5"}
+ *   {"cmd": "switch", "target": "alt-F5", "argv": ["top"], "window": 1}
+ *   {"cmd": "send", "term": 5, "text": "ls\n"}
+ *   {"cmd": "move", "term": 5, "window": 1}
+ *   {"cmd": "color_scheme", "window": 0, "scheme": "Black on White"}
+ *   {"cmd": "titles"}
+ *   {"cmd": "stats", "reset": true}
+ *   {"cmd": "latency", "term": 5, "reset": true}
+ *   {"cmd": "trace", "enable": true, "limit": 100, "clear": true}
+ *
+ * Terminals are numbered from 1 and windows from 0, as in zterm --list.
+ * Replies are {"ok": true, ...} or {"ok": false, "error": "..."}, plus the
+ * command's "id", if it had one.
+ */
+
+typedef struct control_conn_s {
+	GSocketConnection *connection;
+	GDataInputStream  *in;
+	GOutputStream	  *out;
+	GString			  *pending; // Replies not yet handed to the output stream.
+	GBytes			  *writing; // Replies the output stream is working on.
+	bool			   reading;
+	bool			   failed; // The client stopped listening, just drain its commands.
+} control_conn_t;
+
+typedef bool (*control_handler_t) (JsonObject *cmd, JsonBuilder *reply, const char **error);
+
+static GSocketService *control_service = NULL;
+static char			  *control_path	   = NULL;
+
+static void control_read (control_conn_t *conn);
+
+// Both the read and the write side have to be done with a connection before it goes.
+static void control_conn_done (control_conn_t *conn)
+{
+	if (conn->reading || conn->writing) {
+		return;
+	}
+
+	debugf ("conn: %p", conn);
+	g_object_unref (conn->in);
+	g_object_unref (conn->connection);
+	g_string_free (conn->pending, true);
+	g_free (conn);
+}
+
+// A term number from a command, converted to a slot.
+static bool control_get_term (JsonObject *cmd, long *n, const char **error)
+{
+	if (!json_object_has_member (cmd, "term")) {
+		*error = "Missing 'term'.";
+		return false;
+	}
+
+	*n = json_object_get_int_member (cmd, "term") - 1;
+	if (*n < 0 || *n >= terms.n_active) {
+		*error = "No such terminal.";
+		return false;
+	}
+
+	return true;
+}
+
+static bool control_get_window (JsonObject *cmd, int *window_i, const char **error)
+{
+	*window_i = json_object_get_int_member_with_default (cmd, "window", 0);
+	if (*window_i < 0 || *window_i >= MAX_WINDOWS) {
+		*error = "No such window.";
+		return false;
+	}
+
+	return true;
+}
+
+static char **control_get_strv (JsonObject *cmd, const char *member)
+{
+	JsonArray *array = json_object_get_array_member (cmd, member);
+	guint	   len	 = json_array_get_length (array);
+	char	 **strv	 = g_new0 (char *, len + 1);
+
+	for (guint i = 0; i < len; i++) {
+		strv[i] = g_strdup (json_array_get_string_element (array, i));
+	}
+
+	return strv;
+}
+
+static bool control_switch (JsonObject *cmd, JsonBuilder *reply, const char **error)
+{
+	cmd_t *switch_to = g_new0 (cmd_t, 1);
+
+	if (!switch_target_resolve (json_object_get_string_member_with_default (cmd, "target", ""), &switch_to->n) ||
+		!control_get_window (cmd, &switch_to->window_i, error)) {
+		if (*error == NULL) {
+			*error = "Unable to resolve switch target.";
+		}
+		g_free (switch_to);
+		return false;
+	}
+
+	if (switch_to->n >= terms.n_active) {
+		*error = "No such terminal.";
+		g_free (switch_to);
+		return false;
+	}
+
+	if (json_object_has_member (cmd, "argv") && JSON_NODE_HOLDS_ARRAY (json_object_get_member (cmd, "argv"))) {
+		switch_to->cli_exec		  = g_new0 (exec_t, 1);
+		switch_to->cli_exec->argv = control_get_strv (cmd, "argv");
+	}
+
+	json_builder_set_member_name (reply, "term");
+	json_builder_add_int_value (reply, switch_to->n + 1);
+
+	// Takes ownership of switch_to.
+	return switch_cmd (switch_to);
+}
+
+static bool control_send (JsonObject *cmd, JsonBuilder *reply, const char **error)
+{
+	long		n;
+	const char *text = json_object_get_string_member_with_default (cmd, "text", NULL);
+
+	if (!control_get_term (cmd, &n, error)) {
+		return false;
+	}
+	if (text == NULL) {
+		*error = "Missing 'text'.";
+		return false;
+	}
+	if (terms.active[n].spawn_state != TERM_SPAWN_RUNNING) {
+		*error = "Terminal is not running.";
+		return false;
+	}
+
+	vte_terminal_feed_child (VTE_TERMINAL (terms.active[n].term), text, strlen (text));
+
+	return true;
+}
+
+static bool control_move (JsonObject *cmd, JsonBuilder *reply, const char **error)
+{
+	long n;
+	int	 window_i;
+
+	if (!control_get_term (cmd, &n, error) || !control_get_window (cmd, &window_i, error)) {
+		return false;
+	}
+	if (terms.active[n].term == NULL) {
+		*error = "Terminal is not open.";
+		return false;
+	}
+
+	term_set_window (n, window_i);
+
+	// term_set_window makes a new window if the one asked for doesn't exist, so say where it ended up.
+	json_builder_set_member_name (reply, "window");
+	json_builder_add_int_value (reply, terms.active[n].window);
+
+	return true;
+}
+
+static bool control_color_scheme (JsonObject *cmd, JsonBuilder *reply, const char **error)
+{
+	JsonNode			 *scheme  = json_object_get_member (cmd, "scheme");
+	const color_scheme_t *schemes = config_gen->color_schemes;
+	int					  window_i;
+	long				  i = -1;
+
+	if (!control_get_window (cmd, &window_i, error)) {
+		return false;
+	}
+	if (!windows[window_i].window) {
+		*error = "No such window.";
+		return false;
+	}
+
+	// Either the index, or the name as shown in the menu.
+	if (scheme != NULL && json_node_get_value_type (scheme) == G_TYPE_STRING) {
+		for (int j = 0; j < MAX_COLOR_SCHEMES; j++) {
+			if (schemes[j].name[0] && !strcmp (schemes[j].name, json_node_get_string (scheme))) {
+				i = j;
+				break;
+			}
+		}
+	} else if (scheme != NULL) {
+		i = json_node_get_int (scheme);
+	}
+
+	if (i < 0 || i >= MAX_COLOR_SCHEMES || !schemes[i].name[0]) {
+		*error = "No such color scheme.";
+		return false;
+	}
+
+	do_set_window_color_scheme (NULL, NULL, (gpointer) ((i << 8) + window_i));
+
+	return true;
+}
+
+static bool control_titles (JsonObject *cmd, JsonBuilder *reply, const char **error)
+{
+	json_builder_set_member_name (reply, "terms");
+	json_builder_begin_array (reply);
+	for (int i = 0; i < terms.n_active; i++) {
+		if (terms.active[i].term == NULL) {
+			continue;
+		}
+
+		json_builder_begin_object (reply);
+		json_builder_set_member_name (reply, "term");
+		json_builder_add_int_value (reply, i + 1);
+		json_builder_set_member_name (reply, "window");
+		json_builder_add_int_value (reply, terms.active[i].window);
+		json_builder_set_member_name (reply, "pts");
+		json_builder_add_string_value (reply, terms.active[i].pts);
+		json_builder_set_member_name (reply, "title");
+		json_builder_add_string_value (reply, terms.active[i].title);
+		json_builder_set_member_name (reply, "scrollback");
+		json_builder_add_int_value (reply, term_scrollback_used (i));
+		json_builder_set_member_name (reply, "scrollback_limit");
+		json_builder_add_int_value (reply, terms.active[i].scrollback_limit);
+		json_builder_end_object (reply);
+	}
+	json_builder_end_array (reply);
+
+	return true;
+}
+
+static bool control_stats (JsonObject *cmd, JsonBuilder *reply, const char **error)
+{
+	int	  n_windows	 = 0;
+	glong scrollback = 0;
+
+	for (int i = 0; i < MAX_WINDOWS; i++) {
+		if (windows[i].window) {
+			n_windows++;
+		}
+	}
+	for (int i = 0; i < terms.n_active; i++) {
+		scrollback += term_scrollback_used (i);
+	}
+
+	json_builder_set_member_name (reply, "slots");
+	json_builder_add_int_value (reply, terms.n_active);
+	json_builder_set_member_name (reply, "alive");
+	json_builder_add_int_value (reply, terms.alive);
+	json_builder_set_member_name (reply, "windows");
+	json_builder_add_int_value (reply, n_windows);
+	json_builder_set_member_name (reply, "scrollback");
+	json_builder_add_int_value (reply, scrollback);
+	json_builder_set_member_name (reply, "scrollback_budget");
+	json_builder_add_int_value (reply, terms.scrollback_budget);
+
+	json_builder_set_member_name (reply, "frames");
+	json_builder_add_int_value (reply, frame_stats.frames);
+	json_builder_set_member_name (reply, "paint_avg_us");
+	json_builder_add_int_value (reply, frame_stats.frames ? frame_stats.paint_total / frame_stats.frames : 0);
+	json_builder_set_member_name (reply, "paint_max_us");
+	json_builder_add_int_value (reply, frame_stats.paint_max);
+	json_builder_set_member_name (reply, "frame_gap_max_us");
+	json_builder_add_int_value (reply, frame_stats.gap_max);
+
+	json_builder_set_member_name (reply, "spawns");
+	json_builder_add_int_value (reply, spawn_stats.spawns);
+	json_builder_set_member_name (reply, "spawn_avg_us");
+	json_builder_add_int_value (reply, spawn_stats.spawns ? spawn_stats.total / spawn_stats.spawns : 0);
+	json_builder_set_member_name (reply, "spawn_max_us");
+	json_builder_add_int_value (reply, spawn_stats.max);
+	json_builder_set_member_name (reply, "spawn_helper");
+	json_builder_add_boolean_value (reply, spawn_helper_running ());
+
+	// So that a benchmark can look at just its own frames and spawns.
+	if (json_object_get_boolean_member_with_default (cmd, "reset", false)) {
+		memset (&frame_stats, 0, sizeof (frame_stats));
+		memset (&spawn_stats, 0, sizeof (spawn_stats));
+	}
+
+	return true;
+}
+
+static void control_latency_add (JsonBuilder *reply, const char *name, gint64 p50, gint64 p99, gint64 max)
+{
+	json_builder_set_member_name (reply, name);
+	json_builder_begin_object (reply);
+	json_builder_set_member_name (reply, "p50_us");
+	json_builder_add_int_value (reply, p50);
+	json_builder_set_member_name (reply, "p99_us");
+	json_builder_add_int_value (reply, p99);
+	json_builder_set_member_name (reply, "max_us");
+	json_builder_add_int_value (reply, max);
+	json_builder_end_object (reply);
+}
+
+// Keystroke latency for one terminal, or all of them which have any.
+static bool control_latency (JsonObject *cmd, JsonBuilder *reply, const char **error)
+{
+	latency_stats_t stats;
+	long			first = 0, last = terms.n_active - 1;
+
+	if (!terms.latency_stats) {
+		*error = "latency_stats is not enabled.";
+		return false;
+	}
+	if (json_object_has_member (cmd, "term")) {
+		if (!control_get_term (cmd, &first, error)) {
+			return false;
+		}
+		last = first;
+	}
+
+	json_builder_set_member_name (reply, "terms");
+	json_builder_begin_array (reply);
+	for (long i = first; i <= last; i++) {
+		if (!latency_get (i, &stats)) {
+			continue;
+		}
+
+		json_builder_begin_object (reply);
+		json_builder_set_member_name (reply, "term");
+		json_builder_add_int_value (reply, i + 1);
+		json_builder_set_member_name (reply, "inputs");
+		json_builder_add_int_value (reply, stats.count);
+		json_builder_set_member_name (reply, "painted");
+		json_builder_add_int_value (reply, stats.painted);
+		control_latency_add (reply, "echo", stats.echo_p50, stats.echo_p99, stats.echo_max);
+		control_latency_add (reply, "paint", stats.paint_p50, stats.paint_p99, stats.paint_max);
+		json_builder_end_object (reply);
+	}
+	json_builder_end_array (reply);
+
+	if (json_object_get_boolean_member_with_default (cmd, "reset", false)) {
+		latency_reset ();
+	}
+
+	return true;
+}
+
+/*
+ * The most recent trace records, up to limit, oldest first.  Optionally turns
+ * tracing on or off first, and clears the ring after.
+ */
+static bool control_trace (JsonObject *cmd, JsonBuilder *reply, const char **error)
+{
+	gint64 limit = json_object_get_int_member_with_default (cmd, "limit", 256);
+
+	if (json_object_has_member (cmd, "enable")) {
+		trace_enabled = json_object_get_boolean_member (cmd, "enable");
+	}
+	if (limit < 0) {
+		*error = "limit must not be negative.";
+		return false;
+	}
+
+	trace_record_t *records = g_new (trace_record_t, MAX (1, MIN (limit, 65536)));
+	int				n		= trace_snapshot (records, MIN (limit, 65536));
+
+	json_builder_set_member_name (reply, "enabled");
+	json_builder_add_boolean_value (reply, trace_enabled);
+	json_builder_set_member_name (reply, "records");
+	json_builder_begin_array (reply);
+	for (int i = 0; i < n; i++) {
+		json_builder_begin_object (reply);
+		json_builder_set_member_name (reply, "time_us");
+		json_builder_add_int_value (reply, records[i].time);
+		json_builder_set_member_name (reply, "what");
+		json_builder_add_string_value (reply, records[i].what);
+		json_builder_set_member_name (reply, "a");
+		json_builder_add_int_value (reply, records[i].a);
+		json_builder_set_member_name (reply, "b");
+		json_builder_add_int_value (reply, records[i].b);
+		json_builder_end_object (reply);
+	}
+	json_builder_end_array (reply);
+	g_free (records);
+
+	if (json_object_get_boolean_member_with_default (cmd, "clear", false)) {
+		trace_clear ();
+	}
+
+	return true;
+}
+
+static const struct {
+	const char		 *name;
+	control_handler_t handler;
+} control_commands[] = {
+  {"switch",	   control_switch	   },
+  {"send",		   control_send		   },
+  {"move",		   control_move		   },
+  {"color_scheme", control_color_scheme},
+  {"titles",	   control_titles	   },
+  {"stats",		   control_stats	   },
+  {"latency",	   control_latency	   },
+  {"trace",		   control_trace	   },
+};
+
+static void control_run (JsonNode *node, JsonBuilder *reply)
+{
+	PROBE ();
+
+	const char *error = NULL;
+	bool		ok	  = false;
+
+	json_builder_begin_object (reply);
+
+	if (!JSON_NODE_HOLDS_OBJECT (node)) {
+		error = "Commands must be objects.";
+	} else {
+		JsonObject *cmd	 = json_node_get_object (node);
+		const char *name = json_object_get_string_member_with_default (cmd, "cmd", "");
+
+		if (json_object_has_member (cmd, "id")) {
+			json_builder_set_member_name (reply, "id");
+			json_builder_add_value (reply, json_node_copy (json_object_get_member (cmd, "id")));
+		}
+
+		error = "Unknown command.";
+		for (size_t i = 0; i < G_N_ELEMENTS (control_commands); i++) {
+			if (!strcmp (name, control_commands[i].name)) {
+				error = NULL;
+				ok	  = control_commands[i].handler (cmd, reply, &error);
+				break;
+			}
+		}
+		debugf ("cmd: %s, ok: %d, error: %s", name, ok, error);
+	}
+
+	json_builder_set_member_name (reply, "ok");
+	json_builder_add_boolean_value (reply, ok);
+	if (!ok) {
+		json_builder_set_member_name (reply, "error");
+		json_builder_add_string_value (reply, error ? error : "Failed.");
+	}
+
+	json_builder_end_object (reply);
+}
+
+static char *control_handle_line (const char *line)
+{
+	JsonParser	*parser = json_parser_new ();
+	JsonBuilder *reply	= json_builder_new ();
+	GError		*error	= NULL;
+
+	if (!json_parser_load_from_data (parser, line, -1, &error)) {
+		json_builder_begin_object (reply);
+		json_builder_set_member_name (reply, "ok");
+		json_builder_add_boolean_value (reply, false);
+		json_builder_set_member_name (reply, "error");
+		json_builder_add_string_value (reply, error->message);
+		json_builder_end_object (reply);
+		g_error_free (error);
+	} else if (JSON_NODE_HOLDS_ARRAY (json_parser_get_root (parser))) {
+		JsonArray *batch = json_node_get_array (json_parser_get_root (parser));
+
+		json_builder_begin_array (reply);
+		for (guint i = 0; i < json_array_get_length (batch); i++) {
+			control_run (json_array_get_element (batch, i), reply);
+		}
+		json_builder_end_array (reply);
+	} else {
+		control_run (json_parser_get_root (parser), reply);
+	}
+
+	JsonGenerator *generator = json_generator_new ();
+	JsonNode	  *root		 = json_builder_get_root (reply);
+
+	json_generator_set_root (generator, root);
+	char *ret = json_generator_to_data (generator, NULL);
+
+	json_node_unref (root);
+	g_object_unref (generator);
+	g_object_unref (reply);
+	g_object_unref (parser);
+
+	return ret;
+}
+
+static void control_write (control_conn_t *conn);
+
+static void control_write_done (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	control_conn_t *conn  = user_data;
+	GError		   *error = NULL;
+
+	if (!g_output_stream_write_all_finish (G_OUTPUT_STREAM (source), res, NULL, &error)) {
+		debugf ("Control write failed: %s", error->message);
+		g_error_free (error);
+		conn->failed = true;
+	}
+
+	g_clear_pointer (&conn->writing, g_bytes_unref);
+	control_write (conn);
+	control_conn_done (conn);
+}
+
+// Replies queue up in pending while a write is in flight, and go out together in the next one.
+static void control_write (control_conn_t *conn)
+{
+	if (conn->failed) {
+		g_string_truncate (conn->pending, 0);
+		return;
+	}
+
+	if (conn->writing != NULL || conn->pending->len == 0) {
+		return;
+	}
+
+	conn->writing = g_string_free_to_bytes (conn->pending);
+	conn->pending = g_string_new (NULL);
+	g_output_stream_write_all_async (conn->out, g_bytes_get_data (conn->writing, NULL), g_bytes_get_size (conn->writing),
+									 G_PRIORITY_DEFAULT, NULL, control_write_done, conn);
+}
+
+static void control_read_done (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	control_conn_t *conn  = user_data;
+	GError		   *error = NULL;
+	gsize			len	  = 0;
+	char		   *line  = g_data_input_stream_read_line_finish_utf8 (G_DATA_INPUT_STREAM (source), res, &len, &error);
+
+	if (line == NULL) {
+		if (error != NULL) {
+			debugf ("Control read failed: %s", error->message);
+			g_error_free (error);
+		}
+
+		conn->reading = false;
+		control_conn_done (conn);
+		return;
+	}
+
+	if (len > 0) {
+		char *reply = control_handle_line (line);
+
+		g_string_append (conn->pending, reply);
+		g_string_append_c (conn->pending, '\n');
+		g_free (reply);
+		control_write (conn);
+	}
+	g_free (line);
+
+	control_read (conn);
+}
+
+static void control_read (control_conn_t *conn)
+{
+	g_data_input_stream_read_line_async (conn->in, G_PRIORITY_DEFAULT, NULL, control_read_done, conn);
+}
+
+static gboolean control_incoming (GSocketService *service, GSocketConnection *connection, GObject *source_object,
+								  gpointer user_data)
+{
+	GError		 *error = NULL;
+	GCredentials *creds = g_socket_get_credentials (g_socket_connection_get_socket (connection), &error);
+	uid_t		  uid	= creds != NULL ? g_credentials_get_unix_user (creds, &error) : (uid_t) -1;
+
+	/*
+	 * The socket is only chmod'd once it's listening, and an absolute
+	 * control_socket can be anywhere, so anyone else may have got a
+	 * connection in first.
+	 */
+	if (uid != getuid ()) {
+		errorf ("Refusing control connection from uid %d: %s", (int) uid, error != NULL ? error->message : "not us");
+		g_clear_error (&error);
+		g_clear_object (&creds);
+		g_io_stream_close (G_IO_STREAM (connection), NULL, NULL);
+		return true;
+	}
+	g_object_unref (creds);
+
+	control_conn_t *conn = g_new0 (control_conn_t, 1);
+
+	conn->connection = g_object_ref (connection);
+	conn->in		 = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+	conn->out		 = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+	conn->pending	 = g_string_new (NULL);
+	conn->reading	 = true;
+	debugf ("New control connection: %p", conn);
+
+	control_read (conn);
+
+	return true;
+}
+
+void control_stop (void)
+{
+	if (control_service == NULL) {
+		return;
+	}
+
+	g_socket_service_stop (control_service);
+	g_socket_listener_close (G_SOCKET_LISTENER (control_service));
+	g_clear_object (&control_service);
+
+	unlink (control_path);
+	g_clear_pointer (&control_path, g_free);
+}
+
+/*
+ * Whether path is free for our socket, removing one a previous instance that
+ * didn't exit cleanly left behind.  Anything that isn't a socket, or a socket
+ * that something is still listening on, is left alone.
+ */
+static bool control_path_claim (const char *path)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	struct stat		   st;
+
+	if (lstat (path, &st) != 0) {
+		return errno == ENOENT;
+	}
+	if (!S_ISSOCK (st.st_mode)) {
+		errorf ("Control socket '%s' exists and is not a socket, leaving it alone.", path);
+		return false;
+	}
+
+	int fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	strlcpy (addr.sun_path, path, sizeof (addr.sun_path));
+	if (fd >= 0 && connect (fd, (struct sockaddr *) &addr, sizeof (addr)) == 0) {
+		errorf ("Something is already listening on control socket '%s'.", path);
+		close (fd);
+		return false;
+	}
+	if (fd >= 0) {
+		close (fd);
+	}
+
+	return unlink (path) == 0 || errno == ENOENT;
+}
+
+/*
+ * Start, restart or stop the control socket to match the config.  Safe to
+ * call on every config load.
+ */
+void control_start (void)
+{
+	char   *path  = NULL;
+	GError *error = NULL;
+
+	if (terms.control_socket != NULL && terms.control_socket[0]) {
+		if (g_path_is_absolute (terms.control_socket)) {
+			path = g_strdup (terms.control_socket);
+		} else {
+			path = g_build_filename (g_get_user_runtime_dir (), terms.control_socket, NULL);
+		}
+	}
+
+	if (!g_strcmp0 (path, control_path)) {
+		g_free (path);
+		return;
+	}
+
+	control_stop ();
+	if (path == NULL) {
+		return;
+	}
+
+	if (!control_path_claim (path)) {
+		g_free (path);
+		return;
+	}
+
+	GSocketAddress *address = g_unix_socket_address_new (path);
+
+	control_service = g_socket_service_new ();
+	bool ok = g_socket_listener_add_address (G_SOCKET_LISTENER (control_service), address, G_SOCKET_TYPE_STREAM,
+											 G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, &error);
+	g_object_unref (address);
+
+	if (!ok) {
+		errorf ("Unable to listen on control socket '%s': %s", path, error->message);
+		g_error_free (error);
+		g_clear_object (&control_service);
+		g_free (path);
+		return;
+	}
+
+	// Rather than a umask around the bind, which would be the whole process's, config and save threads included.
+	if (chmod (path, 0600) != 0) {
+		errorf ("Unable to restrict control socket '%s': %s", path, strerror (errno));
+		g_socket_listener_close (G_SOCKET_LISTENER (control_service));
+		g_clear_object (&control_service);
+		unlink (path);
+		g_free (path);
+		return;
+	}
+
+	control_path = path;
+	g_signal_connect (control_service, "incoming", G_CALLBACK (control_incoming), NULL);
+	g_socket_service_start (control_service);
+	infof ("Listening for control connections on '%s'.", control_path);
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
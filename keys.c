@@ -0,0 +1,69 @@
+#include "zterm.h"
+
+/*
+ * Key bindings live in config_gen->keys as a linked list of ranges, which is
+ * convenient for the config and preferences code, but walking it on every
+ * single keypress is not.
+ *
+ * So each generation of the config has them compiled into a hash table keyed
+ * on the modifier state and the keyval, with ranges such as F1-F12 expanded
+ * into one entry per key.  term_key_event then costs a single lookup, with no
+ * allocation.
+ */
+
+static inline gint64 key_table_key (guint state, guint keyval)
+{
+	return ((gint64) state << 32) | keyval;
+}
+
+void key_table_free (config_gen_t *gen)
+{
+	if (gen->key_table != NULL) {
+		g_hash_table_destroy (gen->key_table);
+		gen->key_table = NULL;
+	}
+}
+
+void key_table_build (config_gen_t *gen)
+{
+	key_table_free (gen);
+
+	gen->key_table = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL, g_free);
+
+	for (bind_t *cur = gen->keys; cur; cur = cur->next) {
+		// The config refuses longer ranges, this only keeps a bad one from taking forever.
+		if (cur->key_min == 0 || cur->key_max < cur->key_min || cur->key_max - cur->key_min >= MAX_BIND_RANGE) {
+			continue;
+		}
+
+		for (guint i = 0; i <= cur->key_max - cur->key_min; i++) {
+			guint  keyval = cur->key_min + i;
+			gint64 key	  = key_table_key (cur->state, keyval);
+
+			// The old linear walk stopped at the first match, so the first binding in the list wins.
+			if (g_hash_table_contains (gen->key_table, &key)) {
+				continue;
+			}
+
+			key_entry_t *entry = g_new0 (key_entry_t, 1);
+			entry->key		   = key;
+			entry->bind		   = cur;
+			entry->n		   = cur->base + (keyval - cur->key_min);
+
+			g_hash_table_insert (gen->key_table, &entry->key, entry);
+		}
+	}
+}
+
+key_entry_t *key_table_lookup (const config_gen_t *gen, guint state, guint keyval)
+{
+	if (gen == NULL || gen->key_table == NULL) {
+		return NULL;
+	}
+
+	gint64 key = key_table_key (state & gen->key_bind_mask, keyval);
+
+	return g_hash_table_lookup (gen->key_table, &key);
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
@@ -0,0 +1,221 @@
+#include "zterm.h"
+
+/*
+ * Keystroke to screen latency, measured when latency_stats is set in the
+ * config.
+ *
+ * term_key_event timestamps each key press it passes through to VTE, and
+ * VTE's commit signal, when it sends that to the child, puts the timestamp
+ * on the terminal's queue of input waiting to be seen.  Input that didn't
+ * come from a key press, such as a paste or the control socket's send
+ * command, is timed from the commit instead.
+ *
+ * The next contents-changed is taken to be the echo, and the end of the next
+ * frame painted with the terminal on screen is when it was seen.  Both are
+ * kept as histograms for each terminal slot, for the control socket's
+ * latency command and for the report at exit.
+ */
+
+#define LATENCY_QUEUE	64
+#define LATENCY_BUCKETS 192 // Eight per power of two, up to 16 seconds.
+
+typedef struct latency_hist_s {
+	guint64 count;
+	gint64	max;
+	guint32 buckets[LATENCY_BUCKETS];
+} latency_hist_t;
+
+typedef struct latency_slot_s {
+	gint64		   queue[LATENCY_QUEUE]; // When each input not yet on screen was typed.
+	int			   head, len;
+	int			   echoed; // How many from head the child has echoed.
+	latency_hist_t echo;
+	latency_hist_t paint;
+} latency_slot_t;
+
+static latency_slot_t *latency_slots	= NULL;
+static int			   latency_n_slots	= 0;
+static gint64		   latency_key_time = 0; // The last key press given to VTE, until its commit.
+
+static latency_slot_t *latency_slot (int n)
+{
+	if (n >= latency_n_slots) {
+		latency_slots = g_renew (latency_slot_t, latency_slots, n + 1);
+		memset (&latency_slots[latency_n_slots], 0, (n + 1 - latency_n_slots) * sizeof (latency_slot_t));
+		latency_n_slots = n + 1;
+	}
+
+	return &latency_slots[n];
+}
+
+static int latency_bucket (gint64 us)
+{
+	if (us < 8) {
+		return MAX (us, 0);
+	}
+
+	int msb = 63 - __builtin_clzll (us);
+	return MIN ((msb - 2) * 8 + ((us >> (msb - 3)) & 7), LATENCY_BUCKETS - 1);
+}
+
+// The largest value that lands in bucket i.
+static gint64 latency_bucket_max (int i)
+{
+	if (i < 8) {
+		return i;
+	}
+
+	return ((gint64) (8 + i % 8 + 1) << (i / 8 - 1)) - 1;
+}
+
+static void latency_hist_add (latency_hist_t *hist, gint64 us)
+{
+	hist->count++;
+	hist->max = MAX (hist->max, us);
+	hist->buckets[latency_bucket (us)]++;
+}
+
+static gint64 latency_hist_percentile (const latency_hist_t *hist, double q)
+{
+	guint64 want = MAX (1, (guint64) (hist->count * q + 0.999999));
+	guint64 seen = 0;
+
+	for (int i = 0; i < LATENCY_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen >= want) {
+			return MIN (latency_bucket_max (i), hist->max);
+		}
+	}
+
+	return hist->max;
+}
+
+void latency_key (void)
+{
+	if (G_UNLIKELY (terms.latency_stats)) {
+		latency_key_time = g_get_monotonic_time ();
+	}
+}
+
+static void latency_commit (VteTerminal *term, gchar *text, guint size, gpointer user_data)
+{
+	if (G_LIKELY (!terms.latency_stats)) {
+		return;
+	}
+
+	latency_slot_t *slot = latency_slot ((long) user_data);
+	gint64			now	 = g_get_monotonic_time ();
+
+	// Anything older is a key press VTE didn't send anything for, not this one.
+	if (!latency_key_time || now - latency_key_time > G_USEC_PER_SEC) {
+		latency_key_time = now;
+	}
+
+	if (slot->len == LATENCY_QUEUE) {
+		slot->head = (slot->head + 1) % LATENCY_QUEUE;
+		slot->len--;
+		slot->echoed = MAX (0, slot->echoed - 1);
+	}
+	slot->queue[(slot->head + slot->len++) % LATENCY_QUEUE] = latency_key_time;
+
+	latency_key_time = 0;
+}
+
+static void latency_contents_changed (VteTerminal *term, gpointer user_data)
+{
+	if (G_LIKELY (!terms.latency_stats)) {
+		return;
+	}
+
+	latency_slot_t *slot = latency_slot ((long) user_data);
+	gint64			now	 = g_get_monotonic_time ();
+
+	for (; slot->echoed < slot->len; slot->echoed++) {
+		latency_hist_add (&slot->echo, now - slot->queue[(slot->head + slot->echoed) % LATENCY_QUEUE]);
+	}
+
+	// Nothing is going to be painted for a terminal that isn't on screen.
+	if (!gtk_widget_get_mapped (GTK_WIDGET (term))) {
+		slot->head	 = (slot->head + slot->len) % LATENCY_QUEUE;
+		slot->len	 = 0;
+		slot->echoed = 0;
+	}
+}
+
+void latency_connect (GtkWidget *term, long n)
+{
+	g_signal_connect (G_OBJECT (term), "commit", G_CALLBACK (latency_commit), (void *) n);
+	g_signal_connect_after (G_OBJECT (term), "contents_changed", G_CALLBACK (latency_contents_changed), (void *) n);
+}
+
+// Called at the end of each frame for the window.
+void latency_painted (int window_i)
+{
+	GtkNotebook *notebook = windows[window_i].notebook;
+	int			 n;
+
+	if (G_LIKELY (!terms.latency_stats) ||
+		!term_find (gtk_notebook_get_nth_page (notebook, gtk_notebook_get_current_page (notebook)), &n) ||
+		n >= latency_n_slots) {
+		return;
+	}
+
+	latency_slot_t *slot = &latency_slots[n];
+	gint64			now	 = g_get_monotonic_time ();
+
+	for (; slot->echoed > 0; slot->echoed--) {
+		latency_hist_add (&slot->paint, now - slot->queue[slot->head]);
+		slot->head = (slot->head + 1) % LATENCY_QUEUE;
+		slot->len--;
+	}
+}
+
+bool latency_get (int n, latency_stats_t *stats)
+{
+	if (n >= latency_n_slots || !latency_slots[n].echo.count) {
+		return false;
+	}
+
+	const latency_slot_t *slot = &latency_slots[n];
+
+	stats->count	 = slot->echo.count;
+	stats->echo_p50	 = latency_hist_percentile (&slot->echo, 0.50);
+	stats->echo_p99	 = latency_hist_percentile (&slot->echo, 0.99);
+	stats->echo_max	 = slot->echo.max;
+	stats->painted	 = slot->paint.count;
+	stats->paint_p50 = latency_hist_percentile (&slot->paint, 0.50);
+	stats->paint_p99 = latency_hist_percentile (&slot->paint, 0.99);
+	stats->paint_max = slot->paint.max;
+
+	return true;
+}
+
+void latency_reset (void)
+{
+	for (int i = 0; i < latency_n_slots; i++) {
+		memset (&latency_slots[i].echo, 0, sizeof (latency_slots[i].echo));
+		memset (&latency_slots[i].paint, 0, sizeof (latency_slots[i].paint));
+	}
+}
+
+// Report and free everything, at exit.
+void latency_free (void)
+{
+	latency_stats_t stats;
+
+	for (int i = 0; i < latency_n_slots; i++) {
+		if (latency_get (i, &stats)) {
+			infof ("Term %d latency over %" G_GUINT64_FORMAT " inputs, echo p50/p99/max %" G_GINT64_FORMAT "/%" G_GINT64_FORMAT
+				   "/%" G_GINT64_FORMAT " us, on screen p50/p99/max %" G_GINT64_FORMAT "/%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT
+				   " us.",
+				   i + 1, stats.count, stats.echo_p50, stats.echo_p99, stats.echo_max, stats.paint_p50, stats.paint_p99,
+				   stats.paint_max);
+		}
+	}
+
+	g_free (latency_slots);
+	latency_slots	= NULL;
+	latency_n_slots = 0;
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
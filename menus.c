@@ -1,34 +1,32 @@
 #include "zterm.h"
 #include <alloca.h>
 
+// Reads the config in the background, and config_reloaded applies it.
 void do_reload_config (GSimpleAction *self, GVariant *parameter, gpointer user_data)
 {
-	int old_n_active = terms.n_active;
+	config_load_start (true, false);
+}
 
-	if (!zterm_parse_config ()) {
-		errorf ("Unable to read new config, falling back to legacy config.");
-		temu_parse_config ();
-	}
-	if (!terms.n_active) {
-		errorf ("Unable to read config file, or no terminals defined.");
-		return;
-	}
+// by_user is for "Reload config file", rather than the watcher noticing a change.
+void config_reloaded (int old_n_active, bool by_user)
+{
+	PROBE ();
 
 	// We actively don't want to worry about the number shrinking.  That just makes too much pain.
 	// But we absolutely have to handle it growing.
 	if (terms.n_active > old_n_active) {
 		debugf ("old_n_active: %d, terms.n_active: %d", old_n_active, terms.n_active);
-		terms.active = realloc (terms.active, terms.n_active * sizeof (*terms.active));
-		memset (&terms.active[old_n_active], 0, (terms.n_active - old_n_active) * sizeof (*terms.active));
+		term_slots_grow (old_n_active);
 	}
 
-	for (int i = 0; i < terms.n_active; i++) {
-		if (terms.active[i].term) {
-			term_config (terms.active[i].term, terms.active[i].window);
-			// vte_terminal_set_geometry_hints_for_window(VTE_TERMINAL (terms.active[i].term), GTK_WINDOW
-			// (windows[terms.active[i].window].window));
-		}
-	}
+	term_config_changed (by_user);
+	term_pool_drain ();
+	term_pool_refill ();
+	control_start ();
+	watchdog_start ();
+	trace_start ();
+	spawn_helper_apply ();
+	config_watch_start ();
 
 	rebuild_menus ();
 }
@@ -148,7 +146,7 @@ void do_move_to_window (GSimpleAction *self, GVariant *parameter, gpointer data)
 
 	if (term_find (widget, &i)) {
 		term_set_window (i, new_window_i);
-		term_switch (i, NULL, NULL, window_i);
+		term_switch (i, NULL, NULL, NULL, window_i);
 	}
 }
 
@@ -157,7 +155,7 @@ void do_switch_terminal (GSimpleAction *self, GVariant *parameter, gpointer data
 	long int i		  = ((long int) data) >> 8;
 	long int window_i = ((long int) data) & ((1 << 8) - 1);
 
-	term_switch (i, NULL, NULL, window_i);
+	term_switch (i, NULL, NULL, NULL, window_i);
 }
 
 void do_set_window_color_scheme (GSimpleAction *self, GVariant *parameter, gpointer data)
@@ -170,12 +168,12 @@ void do_set_window_color_scheme (GSimpleAction *self, GVariant *parameter, gpoin
 
 	windows[window_i].color_scheme = color_scheme;
 
+	const config_gen_t	 *gen	 = config_gen;
+	const color_scheme_t *scheme = &gen->color_schemes[color_scheme];
 	for (i = 0; i < terms.n_active; i++) {
 		if (terms.active[i].term && terms.active[i].window == window_i) {
-			vte_terminal_set_colors (VTE_TERMINAL (terms.active[i].term),
-									 &terms.color_schemes[windows[window_i].color_scheme].foreground,
-									 &terms.color_schemes[windows[window_i].color_scheme].background, &colors[0],
-									 MIN (256, sizeof (colors) / sizeof (colors[0])));
+			vte_terminal_set_colors (VTE_TERMINAL (terms.active[i].term), &scheme->foreground, &scheme->background, gen->colors,
+									 G_N_ELEMENTS (gen->colors));
 		}
 	}
 }
@@ -229,11 +227,49 @@ static void z_menu_append (GMenu *menu, ZActionEntry *actions, int *n_actions, c
 	debugf ("action: %d, name: %s", *n_actions - 1, actions[*n_actions - 1].entry.name);
 }
 
+/*
+ * Each window has one "terms" action group, with an action per slot, that
+ * lives as long as the window does.  The terminal list menu items refer to
+ * those actions by name, so the list can be rebuilt, or have single items
+ * replaced, without the actions changing underneath it.
+ */
+static void term_list_actions (long int window_n)
+{
+	GSimpleActionGroup *group = windows[window_n].term_actions;
+
+	if (group == NULL) {
+		group = g_simple_action_group_new ();
+		gtk_widget_insert_action_group (windows[window_n].window, "terms", G_ACTION_GROUP (group));
+		windows[window_n].term_actions = group;
+	}
+
+	// terms.n_active can grow on a reload.
+	for (long int i = 0; i < terms.n_active; i++) {
+		char name[64] = {0};
+
+		snprintf (name, sizeof (name), "term_%ld", i);
+		if (g_action_map_lookup_action (G_ACTION_MAP (group), name) == NULL) {
+			GActionEntry entry = {name, do_switch_terminal};
+			g_action_map_add_action_entries (G_ACTION_MAP (group), &entry, 1, (gpointer) ((i << 8) + window_n));
+		}
+	}
+}
+
+// The menu has the window's terminals in slot order, with each item pointing at terms.term_<slot>.
+static void term_list_insert (GMenu *list, int position, long int n)
+{
+	char action[64] = {0};
+
+	snprintf (action, sizeof (action), "terms.term_%ld", n);
+	g_menu_insert (list, position, terms.active[n].title, action);
+	terms.active[n].title_dirty = false;
+}
+
 void rebuild_term_list (long int window_n)
 {
-	ZActionEntry add_actions[64];
-	int			 n_add_actions = 0;
-	int			 i, j;
+	PROBE_ARGS (-1, window_n);
+
+	int i, j;
 
 	if (!windows[window_n].window) {
 		return;
@@ -245,28 +281,67 @@ void rebuild_term_list (long int window_n)
 		windows[window_n].menu_model_term_list = G_MENU_MODEL (g_menu_new ());
 	}
 
+	term_list_actions (window_n);
+
 	GMenu *list = G_MENU (windows[window_n].menu_model_term_list);
 
 	for (i = j = 0; i < terms.n_active; i++) {
 		if (terms.active[i].term && terms.active[i].window == window_n) {
+			debugf ("Window %ld, term %d, n %d", window_n, i, j);
+			term_list_insert (list, j++, i);
+		}
+	}
+}
 
-			char action[64] = {0};
+/*
+ * Replace just the menu items whose titles have changed, at most once a
+ * frame, however often the terminals retitle themselves.
+ */
+static gboolean term_list_tick (GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data)
+{
+	PROBE ();
 
-			snprintf (action, sizeof (action), "terms.term_%d", i);
-			char *_action = dupstr (action);
-			z_menu_append (list, add_actions, &n_add_actions, "terms.", terms.active[i].title, _action, do_switch_terminal,
-						   ((i << 8) + window_n));
-			debugf ("Window %ld, term %d, n %d", window_n, i, j++);
+	long int window_n = (long int) user_data;
+	GMenu	*list	  = G_MENU (windows[window_n].menu_model_term_list);
+	int		 position = 0;
+
+	windows[window_n].term_list_tick = 0;
+
+	if (list == NULL) {
+		return G_SOURCE_REMOVE;
+	}
+
+	for (int i = 0; i < terms.n_active; i++) {
+		if (!terms.active[i].term || terms.active[i].window != window_n) {
+			continue;
+		}
+
+		if (terms.active[i].title_dirty) {
+			// Should never happen, as anything which adds a terminal to the window rebuilds the list.
+			if (position >= g_menu_model_get_n_items (G_MENU_MODEL (list))) {
+				errorf ("Terminal list for window %ld is out of date, rebuilding.", window_n);
+				rebuild_term_list (window_n);
+				return G_SOURCE_REMOVE;
+			}
+
+			debugf ("Window %ld, term %d, position %d: %s", window_n, i, position, terms.active[i].title);
+			g_menu_remove (list, position);
+			term_list_insert (list, position, i);
 		}
+		position++;
 	}
 
-	GSimpleActionGroup *group = g_simple_action_group_new ();
+	return G_SOURCE_REMOVE;
+}
 
-	for (int i = 0; i < n_add_actions; i++) {
-		g_action_map_add_action_entries (G_ACTION_MAP (group), &add_actions[i].entry, 1, add_actions[i].user_data);
-		debugf ("action: %d, name: %s", i, add_actions[i].entry.name);
+void term_list_title_changed (long int window_n, long int n)
+{
+	terms.active[n].title_dirty = true;
+
+	if (windows[window_n].window && !windows[window_n].term_list_tick) {
+		windows[window_n].term_list_tick =
+		  gtk_widget_add_tick_callback (windows[window_n].window, term_list_tick, (gpointer) window_n, NULL);
 	}
-	gtk_widget_insert_action_group (windows[window_n].window, "terms", G_ACTION_GROUP (group));
 }
 
 static void rebuild_window_menu (long int window_n)
@@ -313,10 +388,11 @@ static void rebuild_window_menu (long int window_n)
 	z_menu_append(config, add_actions, &n_add_actions, "menu.", "_", "", do_, window_n);
 	*/
 
-	GMenu *schemes = g_menu_new ();
-	for (long int j = 0; j < MAX_COLOR_SCHEMES && terms.color_schemes[j].name[0]; j++) {
-		debugf ("name: %s, action: %s", terms.color_schemes[j].name, terms.color_schemes[j].action);
-		z_menu_append (schemes, add_actions, &n_add_actions, "menu.", terms.color_schemes[j].name, terms.color_schemes[j].action,
+	GMenu				 *schemes		= g_menu_new ();
+	const color_scheme_t *color_schemes = config_gen->color_schemes;
+	for (long int j = 0; j < MAX_COLOR_SCHEMES && color_schemes[j].name[0]; j++) {
+		debugf ("name: %s, action: %s", color_schemes[j].name, color_schemes[j].action);
+		z_menu_append (schemes, add_actions, &n_add_actions, "menu.", color_schemes[j].name, color_schemes[j].action,
 					   do_set_window_color_scheme, ((j << 8) + window_n));
 	}
 	g_menu_append_section (main, "Color schemes", G_MENU_MODEL (schemes));
@@ -388,6 +464,8 @@ static void rebuild_window_menu (long int window_n)
 
 void rebuild_menus (void)
 {
+	PROBE ();
+
 	for (int i = 0; i < MAX_WINDOWS; i++) {
 		if (windows[i].window) {
 			rebuild_window_menu (i);
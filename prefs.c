@@ -66,11 +66,7 @@ static void apply_preferences (PrefsDialog *prefs)
 	terms.mouse_autohide	  = gtk_check_button_get_active (GTK_CHECK_BUTTON (prefs->mouse_autohide_check));
 
 	/* Apply settings to all terminals */
-	for (int i = 0; i < terms.n_active; i++) {
-		if (terms.active[i].term) {
-			term_config (terms.active[i].term, terms.active[i].window);
-		}
-	}
+	term_config_changed (false);
 
 	/* Save configuration */
 	zterm_save_config ();
@@ -111,11 +107,7 @@ static void preview_preferences (PrefsDialog *prefs)
 	terms.mouse_autohide	  = gtk_check_button_get_active (GTK_CHECK_BUTTON (prefs->mouse_autohide_check));
 
 	/* Apply settings to all terminals */
-	for (int i = 0; i < terms.n_active; i++) {
-		if (terms.active[i].term) {
-			term_config (terms.active[i].term, terms.active[i].window);
-		}
-	}
+	term_config_changed (false);
 }
 
 /* Revert to original settings */
@@ -155,11 +147,7 @@ static void revert_preferences (PrefsDialog *prefs)
 	gtk_check_button_set_active (GTK_CHECK_BUTTON (prefs->mouse_autohide_check), prefs->original_mouse_autohide);
 
 	/* Apply reverted settings to all terminals */
-	for (int i = 0; i < terms.n_active; i++) {
-		if (terms.active[i].term) {
-			term_config (terms.active[i].term, terms.active[i].window);
-		}
-	}
+	term_config_changed (false);
 }
 
 static void free_prefs_dialog (PrefsDialog *prefs)
@@ -295,8 +283,8 @@ static void apply_color_scheme_to_window (long int window_n, const GdkRGBA *fg,
 {
 	for (int i = 0; i < terms.n_active; i++) {
 		if (terms.active[i].term && terms.active[i].window == window_n) {
-			vte_terminal_set_colors (VTE_TERMINAL (terms.active[i].term), fg, bg, &colors[0],
-									 MIN (256, sizeof (colors) / sizeof (colors[0])));
+			vte_terminal_set_colors (VTE_TERMINAL (terms.active[i].term), fg, bg, config_gen->colors,
+									 G_N_ELEMENTS (config_gen->colors));
 		}
 	}
 }
@@ -329,10 +317,9 @@ static void color_scheme_edit_cancel (ColorSchemeEditDialog *edit)
 		apply_color_scheme_to_window (edit->parent_window, &edit->original_fg, &edit->original_bg);
 	} else {
 		/* For new schemes, revert to the window's current color scheme */
-		int scheme_idx = windows[edit->parent_window].color_scheme;
-		if (terms.color_schemes[scheme_idx].name[0]) {
-			apply_color_scheme_to_window (edit->parent_window, &terms.color_schemes[scheme_idx].foreground,
-										  &terms.color_schemes[scheme_idx].background);
+		const color_scheme_t *scheme = &config_gen->color_schemes[windows[edit->parent_window].color_scheme];
+		if (scheme->name[0]) {
+			apply_color_scheme_to_window (edit->parent_window, &scheme->foreground, &scheme->background);
 		}
 	}
 
@@ -352,10 +339,13 @@ static void color_scheme_edit_ok (ColorSchemeEditDialog *edit)
 		const GdkRGBA *bg = gtk_color_dialog_button_get_rgba (GTK_COLOR_DIALOG_BUTTON (edit->bg_button));
 
 		/* Update or add the color scheme */
-		strlcpy (terms.color_schemes[idx].name, name, sizeof (terms.color_schemes[idx].name));
-		snprintf (terms.color_schemes[idx].action, sizeof (terms.color_schemes[idx].action), "color_scheme.%d", idx);
-		terms.color_schemes[idx].foreground = *fg;
-		terms.color_schemes[idx].background = *bg;
+		config_gen_t   *gen	   = config_gen_edit ();
+		color_scheme_t *scheme = &gen->color_schemes[idx];
+		strlcpy (scheme->name, name, sizeof (scheme->name));
+		snprintf (scheme->action, sizeof (scheme->action), "color_scheme.%d", idx);
+		scheme->foreground = *fg;
+		scheme->background = *bg;
+		config_gen_publish (gen);
 
 		/* Save and rebuild menus */
 		zterm_save_config ();
@@ -373,12 +363,14 @@ static void show_color_scheme_edit_dialog (int scheme_index, long int parent_win
 	edit->scheme_index			= scheme_index;
 	edit->parent_window			= parent_window;
 
+	const color_scheme_t *scheme = &config_gen->color_schemes[scheme_index];
+
 	/* Initialize colors and store originals for revert */
 	GdkRGBA foreground, background;
-	if (terms.color_schemes[scheme_index].name[0]) {
-		foreground = terms.color_schemes[scheme_index].foreground;
-		background = terms.color_schemes[scheme_index].background;
-		strlcpy (edit->original_name, terms.color_schemes[scheme_index].name, sizeof (edit->original_name));
+	if (scheme->name[0]) {
+		foreground = scheme->foreground;
+		background = scheme->background;
+		strlcpy (edit->original_name, scheme->name, sizeof (edit->original_name));
 		edit->is_new_scheme = false;
 	} else {
 		/* Default colors for new scheme */
@@ -392,9 +384,8 @@ static void show_color_scheme_edit_dialog (int scheme_index, long int parent_win
 
 	/* Create dialog window */
 	GtkWidget *dialog = gtk_window_new ();
-	gtk_window_set_title (GTK_WINDOW (dialog), scheme_index < MAX_COLOR_SCHEMES && terms.color_schemes[scheme_index].name[0]
-												 ? "Edit Color Scheme"
-												 : "New Color Scheme");
+	gtk_window_set_title (GTK_WINDOW (dialog),
+						  scheme_index < MAX_COLOR_SCHEMES && scheme->name[0] ? "Edit Color Scheme" : "New Color Scheme");
 	gtk_window_set_transient_for (GTK_WINDOW (dialog), GTK_WINDOW (windows[parent_window].window));
 	gtk_window_set_modal (GTK_WINDOW (dialog), TRUE);
 	gtk_window_set_destroy_with_parent (GTK_WINDOW (dialog), TRUE);
@@ -417,8 +408,7 @@ static void show_color_scheme_edit_dialog (int scheme_index, long int parent_win
 	/* Name */
 	gtk_grid_attach (GTK_GRID (grid), create_label ("Name:"), 0, row, 1, 1);
 	edit->name_entry = gtk_entry_new ();
-	gtk_editable_set_text (GTK_EDITABLE (edit->name_entry),
-						   terms.color_schemes[scheme_index].name[0] ? terms.color_schemes[scheme_index].name : "");
+	gtk_editable_set_text (GTK_EDITABLE (edit->name_entry), scheme->name[0] ? scheme->name : "");
 	gtk_widget_set_hexpand (edit->name_entry, TRUE);
 	gtk_grid_attach (GTK_GRID (grid), edit->name_entry, 1, row++, 1, 1);
 
@@ -467,7 +457,7 @@ static void color_scheme_add_clicked (GtkButton *button, gpointer user_data)
 	/* Find first empty slot */
 	int idx = -1;
 	for (int i = 0; i < MAX_COLOR_SCHEMES; i++) {
-		if (!terms.color_schemes[i].name[0]) {
+		if (!config_gen->color_schemes[i].name[0]) {
 			idx = i;
 			break;
 		}
@@ -494,17 +484,21 @@ static void color_scheme_delete_clicked (GtkButton *button, gpointer user_data)
 	int					   scheme_index = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (button), "scheme_index"));
 	ColorSchemeListDialog *list_dialog	= (ColorSchemeListDialog *) user_data;
 
+	config_gen_t   *gen		= config_gen_edit ();
+	color_scheme_t *schemes = gen->color_schemes;
+
 	/* Clear the scheme */
-	memset (&terms.color_schemes[scheme_index], 0, sizeof (color_scheme_t));
+	memset (&schemes[scheme_index], 0, sizeof (color_scheme_t));
 
 	/* Compact the array */
 	for (int i = scheme_index; i < MAX_COLOR_SCHEMES - 1; i++) {
-		terms.color_schemes[i] = terms.color_schemes[i + 1];
-		if (terms.color_schemes[i].name[0]) {
-			snprintf (terms.color_schemes[i].action, sizeof (terms.color_schemes[i].action), "color_scheme.%d", i);
+		schemes[i] = schemes[i + 1];
+		if (schemes[i].name[0]) {
+			snprintf (schemes[i].action, sizeof (schemes[i].action), "color_scheme.%d", i);
 		}
 	}
-	memset (&terms.color_schemes[MAX_COLOR_SCHEMES - 1], 0, sizeof (color_scheme_t));
+	memset (&schemes[MAX_COLOR_SCHEMES - 1], 0, sizeof (color_scheme_t));
+	config_gen_publish (gen);
 
 	zterm_save_config ();
 	debugf ("Calling rebuild_menus");
@@ -523,7 +517,8 @@ static void refresh_color_scheme_list (ColorSchemeListDialog *list_dialog)
 	}
 
 	/* Add rows for each color scheme */
-	for (int i = 0; i < MAX_COLOR_SCHEMES && terms.color_schemes[i].name[0]; i++) {
+	const color_scheme_t *schemes = config_gen->color_schemes;
+	for (int i = 0; i < MAX_COLOR_SCHEMES && schemes[i].name[0]; i++) {
 		GtkWidget *row_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
 		gtk_widget_set_margin_start (row_box, 6);
 		gtk_widget_set_margin_end (row_box, 6);
@@ -544,8 +539,8 @@ static void refresh_color_scheme_list (ColorSchemeListDialog *list_dialog)
 		char			css_str[256];
 		GtkCssProvider *provider = gtk_css_provider_new ();
 		snprintf (css_str, sizeof (css_str), "#%s { background-color: %s; border: 1px solid %s; }", css_name,
-				  gdk_rgba_to_string (&terms.color_schemes[i].background),
-				  gdk_rgba_to_string (&terms.color_schemes[i].foreground));
+				  gdk_rgba_to_string (&schemes[i].background),
+				  gdk_rgba_to_string (&schemes[i].foreground));
 		gtk_css_provider_load_from_string (provider, css_str);
 		gtk_style_context_add_provider_for_display (gdk_display_get_default (), GTK_STYLE_PROVIDER (provider),
 													GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
@@ -554,7 +549,7 @@ static void refresh_color_scheme_list (ColorSchemeListDialog *list_dialog)
 		gtk_box_append (GTK_BOX (row_box), preview);
 
 		/* Name label */
-		GtkWidget *name_label = gtk_label_new (terms.color_schemes[i].name);
+		GtkWidget *name_label = gtk_label_new (schemes[i].name);
 		gtk_widget_set_hexpand (name_label, TRUE);
 		gtk_widget_set_halign (name_label, GTK_ALIGN_START);
 		gtk_box_append (GTK_BOX (row_box), name_label);
@@ -664,12 +659,14 @@ static void color_override_edit_ok (ColorOverrideEditDialog *edit)
 	const GdkRGBA *color = gtk_color_dialog_button_get_rgba (GTK_COLOR_DIALOG_BUTTON (edit->color_button));
 
 	if (index >= 0 && index < 256) {
+		config_gen_t *gen = config_gen_edit ();
+
 		/* Update the color */
-		colors[index] = *color;
+		gen->colors[index] = *color;
 
 		/* Track the override */
 		color_override_t *found = NULL;
-		for (color_override_t *cur = terms.color_overrides; cur; cur = cur->next) {
+		for (color_override_t *cur = gen->color_overrides; cur; cur = cur->next) {
 			if (cur->index == index) {
 				found = cur;
 				break;
@@ -682,16 +679,13 @@ static void color_override_edit_ok (ColorOverrideEditDialog *edit)
 			color_override_t *override = calloc (1, sizeof (color_override_t));
 			override->index			   = index;
 			override->color			   = *color;
-			override->next			   = terms.color_overrides;
-			terms.color_overrides	   = override;
+			override->next			   = gen->color_overrides;
+			gen->color_overrides	   = override;
 		}
+		config_gen_publish (gen);
 
 		/* Apply to all terminals */
-		for (int i = 0; i < terms.n_active; i++) {
-			if (terms.active[i].term) {
-				term_config (terms.active[i].term, terms.active[i].window);
-			}
-		}
+		term_config_changed (false);
 
 		zterm_save_config ();
 	}
@@ -711,7 +705,7 @@ static void show_color_override_edit_dialog (int override_index, GdkRGBA *initia
 	if (initial_color) {
 		color = *initial_color;
 	} else {
-		color = colors[override_index >= 0 ? override_index : 0];
+		color = config_gen->colors[override_index >= 0 ? override_index : 0];
 	}
 
 	GtkWidget *dialog = gtk_window_new ();
@@ -777,7 +771,7 @@ static void color_override_edit_clicked (GtkButton *button, gpointer user_data)
 	int						 override_index = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (button), "override_index"));
 	ColorOverrideListDialog *list_dialog	= (ColorOverrideListDialog *) user_data;
 
-	for (color_override_t *cur = terms.color_overrides; cur; cur = cur->next) {
+	for (color_override_t *cur = config_gen->color_overrides; cur; cur = cur->next) {
 		if (cur->index == override_index) {
 			show_color_override_edit_dialog (override_index, &cur->color, list_dialog->window_n, list_dialog);
 			return;
@@ -791,8 +785,9 @@ static void color_override_delete_clicked (GtkButton *button, gpointer user_data
 	ColorOverrideListDialog *list_dialog	= (ColorOverrideListDialog *) user_data;
 
 	/* Remove from linked list */
-	color_override_t **prev = &terms.color_overrides;
-	for (color_override_t *cur = terms.color_overrides; cur; cur = cur->next) {
+	config_gen_t	  *gen	= config_gen_edit ();
+	color_override_t **prev = &gen->color_overrides;
+	for (color_override_t *cur = gen->color_overrides; cur; cur = cur->next) {
 		if (cur->index == override_index) {
 			*prev = cur->next;
 			free (cur);
@@ -800,6 +795,7 @@ static void color_override_delete_clicked (GtkButton *button, gpointer user_data
 		}
 		prev = &cur->next;
 	}
+	config_gen_publish (gen);
 
 	zterm_save_config ();
 	refresh_color_override_list (list_dialog);
@@ -816,7 +812,7 @@ static void refresh_color_override_list (ColorOverrideListDialog *list_dialog)
 	}
 
 	/* Add rows for each color override */
-	for (color_override_t *cur = terms.color_overrides; cur; cur = cur->next) {
+	for (color_override_t *cur = config_gen->color_overrides; cur; cur = cur->next) {
 		GtkWidget *row_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
 		gtk_widget_set_margin_start (row_box, 6);
 		gtk_widget_set_margin_end (row_box, 6);
@@ -1015,7 +1011,7 @@ static gboolean capture_key_pressed (GtkEventControllerKey *controller, guint ke
 	if (keyval == GDK_KEY_Shift_L || keyval == GDK_KEY_Shift_R || keyval == GDK_KEY_Control_L || keyval == GDK_KEY_Control_R ||
 		keyval == GDK_KEY_Alt_L || keyval == GDK_KEY_Alt_R || keyval == GDK_KEY_Super_L || keyval == GDK_KEY_Super_R ||
 		keyval == GDK_KEY_Meta_L || keyval == GDK_KEY_Meta_R || keyval == GDK_KEY_Hyper_L || keyval == GDK_KEY_Hyper_R) {
-		capture->captured_state = state & key_bind_mask;
+		capture->captured_state = state & config_gen->key_bind_mask;
 		update_capture_label (capture);
 		return TRUE;
 	}
@@ -1027,7 +1023,7 @@ static gboolean capture_key_pressed (GtkEventControllerKey *controller, guint ke
 	}
 
 	capture->captured_key	= keyval;
-	capture->captured_state = state & key_bind_mask;
+	capture->captured_state = state & config_gen->key_bind_mask;
 	update_capture_label (capture);
 
 	return TRUE;
@@ -1042,7 +1038,7 @@ static void capture_button_pressed (GtkGestureClick *gesture, gint n_press, gdou
 
 	/* Button 1 with no modifiers on OK/Cancel buttons should work normally */
 	/* Check if click is on one of the dialog buttons */
-	if (button == 1 && (state & button_bind_mask) == 0) {
+	if (button == 1 && (state & config_gen->button_bind_mask) == 0) {
 		/* Let the click through to buttons if we already have a capture */
 		if (capture->captured_button != 0) {
 			return; /* Don't claim, let button handle it */
@@ -1050,7 +1046,7 @@ static void capture_button_pressed (GtkGestureClick *gesture, gint n_press, gdou
 	}
 
 	capture->captured_button = button;
-	capture->captured_state	 = state & button_bind_mask;
+	capture->captured_state	 = state & config_gen->button_bind_mask;
 	update_capture_label (capture);
 
 	gtk_gesture_set_state (GTK_GESTURE (gesture), GTK_EVENT_SEQUENCE_CLAIMED);
@@ -1143,15 +1139,17 @@ typedef struct {
 	GtkWidget				   *env_label;
 	GtkWidget				   *env_entry;
 	bind_t					   *editing_bind; /* NULL for new */
+	config_gen_t			   *gen;		  /* Keeps editing_bind around */
 	long int					parent_window;
 	struct KeyBindListDialog_s *list_dialog; /* For refreshing list after edit */
 } KeyBindEditDialog;
 
 typedef struct KeyBindListDialog_s {
-	GtkWidget  *dialog;
-	GtkWidget  *column_view;
-	GListStore *store;
-	long int	window_n;
+	GtkWidget	 *dialog;
+	GtkWidget	 *column_view;
+	GListStore	 *store;
+	config_gen_t *gen; /* The generation the listed bindings are from */
+	long int	  window_n;
 } KeyBindListDialog;
 
 static void refresh_key_bind_list (KeyBindListDialog *list_dialog);
@@ -1185,6 +1183,7 @@ static KeyBindItem *key_bind_item_new (bind_t *bind)
 static void key_bind_edit_cancel (KeyBindEditDialog *edit)
 {
 	gtk_window_destroy (GTK_WINDOW (edit->dialog));
+	config_gen_unref (edit->gen);
 	free (edit);
 }
 
@@ -1240,6 +1239,13 @@ static void key_bind_edit_ok (KeyBindEditDialog *edit)
 				g_object_unref (alert);
 				return;
 			}
+			if (key_max - key_min >= MAX_BIND_RANGE) {
+				GtkAlertDialog *alert =
+				  gtk_alert_dialog_new ("%s to %s is more than %d keys.", key_str, key_max_str, MAX_BIND_RANGE);
+				gtk_alert_dialog_show (alert, GTK_WINDOW (edit->dialog));
+				g_object_unref (alert);
+				return;
+			}
 		}
 
 		int base = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (edit->base_spin));
@@ -1252,7 +1258,7 @@ static void key_bind_edit_ok (KeyBindEditDialog *edit)
 	}
 
 	/* Check for duplicate or overlapping bindings */
-	for (bind_t *cur = terms.keys; cur; cur = cur->next) {
+	for (bind_t *cur = config_gen->keys; cur; cur = cur->next) {
 		/* Skip the binding we're editing */
 		if (cur == edit->editing_bind) {
 			continue;
@@ -1286,13 +1292,22 @@ static void key_bind_edit_ok (KeyBindEditDialog *edit)
 		}
 	}
 
-	bind_t *bind;
+	/* Make the change in a copy of the configuration, and publish that */
+	config_gen_t *gen = config_gen_edit ();
+	bind_t		 *bind;
 	if (edit->editing_bind) {
-		bind = edit->editing_bind;
+		bind = config_gen_edit_key (gen, edit->editing_bind);
+		if (bind == NULL) {
+			GtkAlertDialog *alert = gtk_alert_dialog_new ("The configuration was reloaded, and this binding is no longer in it.");
+			gtk_alert_dialog_show (alert, GTK_WINDOW (edit->dialog));
+			g_object_unref (alert);
+			config_gen_unref (gen);
+			return;
+		}
 	} else {
 		bind	   = calloc (1, sizeof (bind_t));
-		bind->next = terms.keys;
-		terms.keys = bind;
+		bind->next = gen->keys;
+		gen->keys  = bind;
 	}
 
 	bind->action  = (bind_actions_t) action_idx;
@@ -1351,8 +1366,7 @@ static void key_bind_edit_ok (KeyBindEditDialog *edit)
 		if (n > terms.n_active) {
 			int old_n_active = terms.n_active;
 			terms.n_active	 = n;
-			terms.active	 = realloc (terms.active, terms.n_active * sizeof (*terms.active));
-			memset (&terms.active[old_n_active], 0, (terms.n_active - old_n_active) * sizeof (*terms.active));
+			term_slots_grow (old_n_active);
 		}
 	} else {
 		bind->key_max = bind->key_min;
@@ -1368,6 +1382,7 @@ static void key_bind_edit_ok (KeyBindEditDialog *edit)
 		}
 	}
 
+	config_gen_publish (gen);
 	zterm_save_config ();
 	debugf ("Calling rebuild_menus");
 	rebuild_menus ();
@@ -1378,6 +1393,7 @@ static void key_bind_edit_ok (KeyBindEditDialog *edit)
 	}
 
 	gtk_window_destroy (GTK_WINDOW (edit->dialog));
+	config_gen_unref (edit->gen);
 	free (edit);
 }
 
@@ -1407,6 +1423,7 @@ static void show_key_bind_edit_dialog (bind_t *editing_bind, long int parent_win
 {
 	KeyBindEditDialog *edit = g_new0 (KeyBindEditDialog, 1);
 	edit->editing_bind		= editing_bind;
+	edit->gen				= editing_bind && list_dialog ? config_gen_ref (list_dialog->gen) : NULL;
 	edit->parent_window		= parent_window;
 	edit->list_dialog		= list_dialog;
 
@@ -1575,10 +1592,12 @@ static void key_bind_delete_clicked (GtkButton *button, gpointer user_data)
 	bind_t			  *bind		   = (bind_t *) g_object_get_data (G_OBJECT (button), "bind_ptr");
 	KeyBindListDialog *list_dialog = (KeyBindListDialog *) user_data;
 
-	/* Remove from linked list */
-	bind_t **prev = &terms.keys;
-	for (bind_t *cur = terms.keys; cur; cur = cur->next) {
-		if (cur == bind) {
+	/* Remove from linked list, in a copy of the configuration */
+	config_gen_t *gen  = config_gen_edit ();
+	bind_t		 *mine = config_gen_edit_key (gen, bind);
+	bind_t		**prev = &gen->keys;
+	for (bind_t *cur = gen->keys; mine && cur; cur = cur->next) {
+		if (cur == mine) {
 			*prev = cur->next;
 			if (cur->argv)
 				g_strfreev (cur->argv);
@@ -1590,6 +1609,7 @@ static void key_bind_delete_clicked (GtkButton *button, gpointer user_data)
 		prev = &cur->next;
 	}
 
+	config_gen_publish (gen);
 	zterm_save_config ();
 	debugf ("Calling rebuild_menus");
 	rebuild_menus ();
@@ -1601,7 +1621,9 @@ static void refresh_key_bind_list (KeyBindListDialog *list_dialog)
 	/* Clear and repopulate the store */
 	g_list_store_remove_all (list_dialog->store);
 
-	for (bind_t *cur = terms.keys; cur; cur = cur->next) {
+	config_gen_unref (list_dialog->gen);
+	list_dialog->gen = config_gen_ref (config_gen);
+	for (bind_t *cur = list_dialog->gen->keys; cur; cur = cur->next) {
 		KeyBindItem *item = key_bind_item_new (cur);
 		g_list_store_append (list_dialog->store, item);
 		g_object_unref (item);
@@ -1613,6 +1635,7 @@ static void key_bind_list_close (KeyBindListDialog *list_dialog)
 	gtk_window_destroy (GTK_WINDOW (list_dialog->dialog));
 	/* Note: store is owned by the selection model which is owned by the column view,
 	 * so it will be freed when the dialog is destroyed */
+	config_gen_unref (list_dialog->gen);
 	free (list_dialog);
 }
 
@@ -1828,14 +1851,16 @@ typedef struct {
 	GtkWidget					  *state_entry;
 	GtkWidget					  *button_spin;
 	bind_button_t				  *editing_bind; /* NULL for new */
+	config_gen_t				  *gen;			 /* Keeps editing_bind around */
 	long int					   parent_window;
 	struct ButtonBindListDialog_s *list_dialog; /* For refreshing list after edit */
 } ButtonBindEditDialog;
 
 typedef struct ButtonBindListDialog_s {
-	GtkWidget *dialog;
-	GtkWidget *list_box;
-	long int   window_n;
+	GtkWidget	 *dialog;
+	GtkWidget	 *list_box;
+	config_gen_t *gen; /* The generation the listed bindings are from */
+	long int	  window_n;
 } ButtonBindListDialog;
 
 static void refresh_button_bind_list (ButtonBindListDialog *list_dialog);
@@ -1843,6 +1868,7 @@ static void refresh_button_bind_list (ButtonBindListDialog *list_dialog);
 static void button_bind_edit_cancel (ButtonBindEditDialog *edit)
 {
 	gtk_window_destroy (GTK_WINDOW (edit->dialog));
+	config_gen_unref (edit->gen);
 	free (edit);
 }
 
@@ -1865,7 +1891,7 @@ static void button_bind_edit_ok (ButtonBindEditDialog *edit)
 	gtk_accelerator_parse (state_str, NULL, &state);
 
 	/* Check for duplicate binding (same button + state combination) */
-	for (bind_button_t *cur = terms.buttons; cur; cur = cur->next) {
+	for (bind_button_t *cur = config_gen->buttons; cur; cur = cur->next) {
 		if (cur != edit->editing_bind && cur->button == button && cur->state == state) {
 			/* Duplicate found - don't add */
 			GtkAlertDialog *alert = gtk_alert_dialog_new ("A binding for this button and modifier combination already exists.");
@@ -1875,19 +1901,29 @@ static void button_bind_edit_ok (ButtonBindEditDialog *edit)
 		}
 	}
 
+	/* Make the change in a copy of the configuration, and publish that */
+	config_gen_t  *gen = config_gen_edit ();
 	bind_button_t *bind;
 	if (edit->editing_bind) {
-		bind = edit->editing_bind;
+		bind = config_gen_edit_button (gen, edit->editing_bind);
+		if (bind == NULL) {
+			GtkAlertDialog *alert = gtk_alert_dialog_new ("The configuration was reloaded, and this binding is no longer in it.");
+			gtk_alert_dialog_show (alert, GTK_WINDOW (edit->dialog));
+			g_object_unref (alert);
+			config_gen_unref (gen);
+			return;
+		}
 	} else {
-		bind		  = calloc (1, sizeof (bind_button_t));
-		bind->next	  = terms.buttons;
-		terms.buttons = bind;
+		bind		 = calloc (1, sizeof (bind_button_t));
+		bind->next	 = gen->buttons;
+		gen->buttons = bind;
 	}
 
 	bind->action = action;
 	bind->button = button;
 	bind->state	 = state;
 
+	config_gen_publish (gen);
 	zterm_save_config ();
 
 	/* Refresh the list dialog if available */
@@ -1896,6 +1932,7 @@ static void button_bind_edit_ok (ButtonBindEditDialog *edit)
 	}
 
 	gtk_window_destroy (GTK_WINDOW (edit->dialog));
+	config_gen_unref (edit->gen);
 	free (edit);
 }
 
@@ -1909,6 +1946,7 @@ static void show_button_bind_edit_dialog (bind_button_t *editing_bind, long int
 {
 	ButtonBindEditDialog *edit = g_new0 (ButtonBindEditDialog, 1);
 	edit->editing_bind		   = editing_bind;
+	edit->gen				   = editing_bind && list_dialog ? config_gen_ref (list_dialog->gen) : NULL;
 	edit->parent_window		   = parent_window;
 	edit->list_dialog		   = list_dialog;
 
@@ -2011,10 +2049,12 @@ static void button_bind_delete_clicked (GtkButton *button, gpointer user_data)
 	bind_button_t		 *bind		  = (bind_button_t *) g_object_get_data (G_OBJECT (button), "bind_ptr");
 	ButtonBindListDialog *list_dialog = (ButtonBindListDialog *) user_data;
 
-	/* Remove from linked list */
-	bind_button_t **prev = &terms.buttons;
-	for (bind_button_t *cur = terms.buttons; cur; cur = cur->next) {
-		if (cur == bind) {
+	/* Remove from linked list, in a copy of the configuration */
+	config_gen_t   *gen	 = config_gen_edit ();
+	bind_button_t  *mine = config_gen_edit_button (gen, bind);
+	bind_button_t **prev = &gen->buttons;
+	for (bind_button_t *cur = gen->buttons; mine && cur; cur = cur->next) {
+		if (cur == mine) {
 			*prev = cur->next;
 			free (cur);
 			break;
@@ -2022,6 +2062,7 @@ static void button_bind_delete_clicked (GtkButton *button, gpointer user_data)
 		prev = &cur->next;
 	}
 
+	config_gen_publish (gen);
 	zterm_save_config ();
 	refresh_button_bind_list (list_dialog);
 }
@@ -2037,7 +2078,9 @@ static void refresh_button_bind_list (ButtonBindListDialog *list_dialog)
 	}
 
 	/* Add rows for each button binding */
-	for (bind_button_t *cur = terms.buttons; cur; cur = cur->next) {
+	config_gen_unref (list_dialog->gen);
+	list_dialog->gen = config_gen_ref (config_gen);
+	for (bind_button_t *cur = list_dialog->gen->buttons; cur; cur = cur->next) {
 		GtkWidget *row_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
 		gtk_widget_set_margin_start (row_box, 6);
 		gtk_widget_set_margin_end (row_box, 6);
@@ -2083,6 +2126,7 @@ static void refresh_button_bind_list (ButtonBindListDialog *list_dialog)
 static void button_bind_list_close (ButtonBindListDialog *list_dialog)
 {
 	gtk_window_destroy (GTK_WINDOW (list_dialog->dialog));
+	config_gen_unref (list_dialog->gen);
 	free (list_dialog);
 }
 
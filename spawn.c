@@ -0,0 +1,845 @@
+#include "zterm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Spawning children for terminals, through VTE, or with spawn_helper set in
+ * the config, through the spawn helper.
+ *
+ * Once GTK is up zterm is a large process, and each fork VTE does for a child
+ * copies all of its page tables, only for the child to take copy on write
+ * faults until it gets to exec.  So main forks the helper first thing, before
+ * GTK has started or there are any other threads, and with spawn_helper,
+ * spawn_async hands it a PTY and what to run on it, and it does the fork and
+ * exec.  If spawn_helper isn't set once the config has been read, or we turn
+ * out to be passing our arguments on to another zterm, the helper is stopped,
+ * and setting it takes a restart.
+ *
+ * The helper is spoken to over a socketpair.  A request is a spawn_request_t,
+ * with the PTY attached as SCM_RIGHTS, followed by the working directory,
+ * argv and envp as NUL terminated strings.  Replies are spawn_reply_t, a
+ * SPAWN_REPLY_SPAWNED for each request, in order, and a SPAWN_REPLY_EXITED
+ * whenever one of the helper's children exits, as only the helper can wait
+ * for them.  child-exited is emitted once that has come and VTE has read all
+ * the child wrote, as VTE does for its own children.
+ *
+ * zterm never blocks on the helper, which may itself be busy writing replies.
+ * Requests are queued and written as the socket takes them.
+ *
+ * spawn_stats has the time from each spawn_async to its callback, either way,
+ * for the control socket's stats command.
+ */
+
+typedef struct spawn_request_s {
+	guint32 size; // Of the strings that follow.
+	guint32 argc;
+	guint32 envc;
+} spawn_request_t;
+
+typedef enum {
+	SPAWN_REPLY_SPAWNED, // value is 0, or the errno from starting the child.
+	SPAWN_REPLY_EXITED,	 // value is the wait status.
+} spawn_reply_type_t;
+
+typedef struct spawn_reply_s {
+	guint32 type;
+	gint32	pid;
+	gint32	value;
+} spawn_reply_t;
+
+// A spawn_async call, until its callback.
+typedef struct spawn_call_s {
+	VteTerminal				  *term;
+	VteTerminalSpawnAsyncCallback callback;
+	gpointer					  user_data;
+	gint64						  start;
+} spawn_call_t;
+
+// One of the helper's children, until child-exited has been emitted for it.
+typedef struct spawn_child_s {
+	GWeakRef term;
+	gulong	 eof_handler;
+	bool	 exited;
+	bool	 eof;
+	int		 status;
+} spawn_child_t;
+
+// A request, until the helper has taken all of it.
+typedef struct spawn_out_s {
+	char	 *data;
+	gsize len;
+	gsize sent;
+	int	  fd; // The PTY, until it has gone along with the first byte.
+} spawn_out_t;
+
+spawn_stats_t spawn_stats;
+
+static GPid		   spawn_helper_pid	   = 0;
+static int		   spawn_helper_fd	   = -1;
+static guint	   spawn_helper_source = 0;
+static guint	   spawn_out_source	   = 0;
+static GQueue	   spawn_outgoing	   = G_QUEUE_INIT; // spawn_out_t, not yet all written, oldest first.
+static GQueue	   spawn_pending	   = G_QUEUE_INIT; // spawn_call_t, waiting on the helper, oldest first.
+static GHashTable *spawn_children	   = NULL;		   // spawn_child_t, by pid.
+static char		   spawn_replies[16 * sizeof (spawn_reply_t)];
+static gsize	   spawn_replies_len = 0;
+
+// The helper's SIGCHLD self pipe, only used in the helper.
+static int spawn_helper_sigchld[2];
+
+static bool spawn_write_all (int fd, const void *data, size_t len)
+{
+	const char *p = data;
+
+	while (len > 0) {
+		ssize_t n = write (fd, p, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		p += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+static bool spawn_read_all (int fd, void *data, size_t len)
+{
+	char *p = data;
+
+	while (len > 0) {
+		ssize_t n = read (fd, p, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		p += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+/* ==================== The helper ==================== */
+
+static void spawn_helper_sigchld_handler (int sig)
+{
+	int saved = errno;
+
+	if (write (spawn_helper_sigchld[1], "", 1) < 0) {
+		// Full, there's a wakeup coming already.
+	}
+	errno = saved;
+}
+
+// execvpe, with PATH from envp rather than our own environment.
+static int spawn_helper_execvpe (char **argv, char **envp)
+{
+	const char *path = "/usr/local/bin:/usr/bin:/bin";
+	size_t		len	 = strlen (argv[0]);
+	int			error = ENOENT;
+	char		file[PATH_MAX];
+
+	if (strchr (argv[0], '/') != NULL) {
+		execve (argv[0], argv, envp);
+		return errno;
+	}
+
+	for (int i = 0; envp[i] != NULL; i++) {
+		if (!strncmp (envp[i], "PATH=", 5)) {
+			path = envp[i] + 5;
+			break;
+		}
+	}
+
+	while (*path != '\0') {
+		const char *end		= strchr (path, ':');
+		size_t		n		= end != NULL ? (size_t) (end - path) : strlen (path);
+		const char *dir		= n ? path : "."; // An empty entry is the current directory.
+		size_t		dir_len = n ? n : 1;
+
+		if (dir_len + len + 2 <= sizeof (file)) {
+			memcpy (file, dir, dir_len);
+			file[dir_len] = '/';
+			memcpy (file + dir_len + 1, argv[0], len + 1);
+			execve (file, argv, envp);
+			// Keep looking past a directory without it, but tell of anything else.
+			if (errno != ENOENT && errno != ENOTDIR) {
+				error = errno;
+			}
+		}
+		path += n + (end != NULL ? 1 : 0);
+	}
+
+	return error;
+}
+
+// In the forked child, everything up to exec, telling report what went wrong if it doesn't get there.
+static void spawn_helper_child (int master, const char *pts, const char *cwd, char **argv, char **envp, int report)
+{
+	sigset_t mask;
+	int		 slave;
+	int		 error;
+
+	sigemptyset (&mask);
+	sigprocmask (SIG_SETMASK, &mask, NULL);
+	signal (SIGCHLD, SIG_DFL);
+	signal (SIGPIPE, SIG_DFL);
+
+	if (setsid () < 0 || (slave = open (pts, O_RDWR)) < 0 || ioctl (slave, TIOCSCTTY, 0) < 0) {
+		error = errno;
+	} else {
+		dup2 (slave, 0);
+		dup2 (slave, 1);
+		dup2 (slave, 2);
+		if (slave > 2) {
+			close (slave);
+		}
+		close (master);
+
+		if (cwd[0] != '\0' && chdir (cwd) < 0) {
+			error = errno;
+		} else {
+			error = spawn_helper_execvpe (argv, envp);
+		}
+	}
+
+	if (write (report, &error, sizeof (error)) < 0) {
+		// Nothing more we can do.
+	}
+	_exit (127);
+}
+
+// Forks and execs argv on master, returning the pid, or -1 with error set.
+static pid_t spawn_helper_fork (int master, const char *cwd, char **argv, char **envp, int *error)
+{
+	int	  report[2];
+	pid_t pid;
+
+	if (argv[0] == NULL) {
+		*error = EINVAL;
+		return -1;
+	}
+
+	const char *pts = NULL;
+	if (grantpt (master) < 0 || unlockpt (master) < 0 || (pts = ptsname (master)) == NULL) {
+		*error = errno;
+		return -1;
+	}
+
+	if (pipe (report) < 0) {
+		*error = errno;
+		return -1;
+	}
+	fcntl (report[0], F_SETFD, FD_CLOEXEC);
+	fcntl (report[1], F_SETFD, FD_CLOEXEC);
+
+	pid = fork ();
+	if (pid == 0) {
+		close (report[0]);
+		spawn_helper_child (master, pts, cwd, argv, envp, report[1]);
+	} else if (pid < 0) {
+		*error = errno;
+	}
+	close (report[1]);
+
+	// Closed by exec without a word if it worked.
+	if (pid > 0) {
+		if (spawn_read_all (report[0], error, sizeof (*error))) {
+			waitpid (pid, NULL, 0);
+			pid = -1;
+		} else {
+			*error = 0;
+		}
+	}
+	close (report[0]);
+
+	return pid;
+}
+
+// One request, false once zterm has gone away.
+static bool spawn_helper_request (int fd)
+{
+	spawn_request_t request;
+	char			control[CMSG_SPACE (sizeof (int))];
+	struct iovec	iov	   = {.iov_base = &request, .iov_len = sizeof (request)};
+	struct msghdr	msg	   = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof (control)};
+	int				master = -1;
+	ssize_t			n;
+
+	do {
+		n = recvmsg (fd, &msg, 0);
+	} while (n < 0 && errno == EINTR);
+	if (n <= 0) {
+		return false;
+	}
+
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (&msg); cmsg != NULL; cmsg = CMSG_NXTHDR (&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+			memcpy (&master, CMSG_DATA (cmsg), sizeof (master));
+			fcntl (master, F_SETFD, FD_CLOEXEC);
+		}
+	}
+
+	if ((size_t) n < sizeof (request) && !spawn_read_all (fd, (char *) &request + n, sizeof (request) - n)) {
+		return false;
+	}
+
+	char *strings = malloc (request.size + 1);
+	if (strings == NULL || !spawn_read_all (fd, strings, request.size)) {
+		return false;
+	}
+	strings[request.size] = '\0';
+
+	// The working directory, then argv, then envp.
+	char **argv = calloc (request.argc + request.envc + 2, sizeof (char *));
+	char **envp = argv + request.argc + 1;
+	char  *p	= strings + strlen (strings) + 1;
+	for (guint32 i = 0; i < request.argc + request.envc && p < strings + request.size; i++) {
+		if (i < request.argc) {
+			argv[i] = p;
+		} else {
+			envp[i - request.argc] = p;
+		}
+		p += strlen (p) + 1;
+	}
+
+	spawn_reply_t reply = {.type = SPAWN_REPLY_SPAWNED};
+	if (master < 0) {
+		reply.pid	= -1;
+		reply.value = EBADF;
+	} else {
+		reply.pid = spawn_helper_fork (master, strings, argv, envp, &reply.value);
+		close (master);
+	}
+	free (argv);
+	free (strings);
+
+	return spawn_write_all (fd, &reply, sizeof (reply));
+}
+
+// Tells zterm of every child that has exited.
+static bool spawn_helper_reap (int fd)
+{
+	spawn_reply_t reply = {.type = SPAWN_REPLY_EXITED};
+	char		  drain[64];
+	pid_t		  pid;
+	int			  status;
+
+	while (read (spawn_helper_sigchld[0], drain, sizeof (drain)) > 0) {
+		// Only there to wake us up.
+	}
+
+	while ((pid = waitpid (-1, &status, WNOHANG)) > 0) {
+		reply.pid	= pid;
+		reply.value = status;
+		if (!spawn_write_all (fd, &reply, sizeof (reply))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void spawn_helper_run (int fd)
+{
+	struct sigaction action = {.sa_handler = spawn_helper_sigchld_handler, .sa_flags = SA_RESTART | SA_NOCLDSTOP};
+
+	// Nothing of zterm's but the socket and stdio.
+	if (fd != 3) {
+		dup2 (fd, 3);
+		close (fd);
+		fd = 3;
+	}
+	closefrom (4);
+	fcntl (fd, F_SETFD, FD_CLOEXEC);
+
+	if (pipe (spawn_helper_sigchld) < 0) {
+		_exit (1);
+	}
+	for (int i = 0; i < 2; i++) {
+		fcntl (spawn_helper_sigchld[i], F_SETFD, FD_CLOEXEC);
+		fcntl (spawn_helper_sigchld[i], F_SETFL, O_NONBLOCK);
+	}
+	sigemptyset (&action.sa_mask);
+	sigaction (SIGCHLD, &action, NULL);
+	signal (SIGPIPE, SIG_IGN);
+
+	struct pollfd fds[2] = {{.fd = fd, .events = POLLIN}, {.fd = spawn_helper_sigchld[0], .events = POLLIN}};
+	for (;;) {
+		if (poll (fds, G_N_ELEMENTS (fds), -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			_exit (1);
+		}
+		if (fds[1].revents && !spawn_helper_reap (fd)) {
+			_exit (0);
+		}
+		if (fds[0].revents && !spawn_helper_request (fd)) {
+			_exit (0);
+		}
+	}
+}
+
+/* ==================== zterm's side ==================== */
+
+// Called from main, before GTK starts up.
+void spawn_helper_start (void)
+{
+	int fds[2];
+
+	if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+		errorf ("Unable to create the spawn helper's socket: %s", strerror (errno));
+		return;
+	}
+
+	pid_t pid = fork ();
+	if (pid < 0) {
+		errorf ("Unable to fork the spawn helper: %s", strerror (errno));
+		close (fds[0]);
+		close (fds[1]);
+		return;
+	}
+	if (pid == 0) {
+		close (fds[0]);
+		spawn_helper_run (fds[1]);
+		_exit (0);
+	}
+
+	close (fds[1]);
+	fcntl (fds[0], F_SETFD, FD_CLOEXEC);
+	spawn_helper_pid = pid;
+	spawn_helper_fd	 = fds[0];
+}
+
+static void spawn_call_done (spawn_call_t *call, GPid pid, GError *error)
+{
+	gint64 took = g_get_monotonic_time () - call->start;
+
+	spawn_stats.spawns++;
+	spawn_stats.total += took;
+	spawn_stats.max = MAX (spawn_stats.max, took);
+
+	call->callback (call->term, pid, error, call->user_data);
+	g_object_unref (call->term);
+	g_free (call);
+}
+
+static void spawn_child_free (gpointer data)
+{
+	spawn_child_t *child = data;
+	GObject		  *term	 = g_weak_ref_get (&child->term);
+
+	if (term != NULL) {
+		g_signal_handler_disconnect (term, child->eof_handler);
+		g_object_unref (term);
+	}
+	g_weak_ref_clear (&child->term);
+	g_free (child);
+}
+
+// Emits child-exited, once the child has exited and its output has all been read.
+static void spawn_child_check (GPid pid, spawn_child_t *child)
+{
+	if (!child->exited || !child->eof) {
+		return;
+	}
+
+	VteTerminal *term	= g_weak_ref_get (&child->term);
+	int			 status = child->status;
+
+	g_hash_table_remove (spawn_children, GINT_TO_POINTER (pid));
+	if (term != NULL) {
+		g_signal_emit_by_name (term, "child-exited", status);
+		g_object_unref (term);
+	}
+}
+
+static void spawn_child_eof (VteTerminal *term, gpointer data)
+{
+	GPid		   pid	 = GPOINTER_TO_INT (data);
+	spawn_child_t *child = g_hash_table_lookup (spawn_children, data);
+
+	if (child != NULL) {
+		child->eof = true;
+		spawn_child_check (pid, child);
+	}
+}
+
+static void spawn_child_exited (GPid pid, int status)
+{
+	spawn_child_t *child = g_hash_table_lookup (spawn_children, GINT_TO_POINTER (pid));
+	GObject		  *term;
+
+	if (child == NULL) {
+		return;
+	}
+
+	child->exited = true;
+	child->status = status;
+
+	// With the terminal gone, there's nobody to tell.
+	if ((term = g_weak_ref_get (&child->term)) == NULL) {
+		g_hash_table_remove (spawn_children, GINT_TO_POINTER (pid));
+		return;
+	}
+	g_object_unref (term);
+	spawn_child_check (pid, child);
+}
+
+static void spawn_helper_reply (const spawn_reply_t *reply)
+{
+	if (reply->type == SPAWN_REPLY_EXITED) {
+		spawn_child_exited (reply->pid, reply->value);
+		return;
+	}
+
+	spawn_call_t *call = g_queue_pop_head (&spawn_pending);
+	if (call == NULL) {
+		errorf ("Spawn helper reply for pid %d without a request.", reply->pid);
+		return;
+	}
+
+	if (reply->value != 0) {
+		GError *error = g_error_new (G_IO_ERROR, g_io_error_from_errno (reply->value), "Unable to spawn: %s",
+									 g_strerror (reply->value));
+		spawn_call_done (call, -1, error);
+		g_error_free (error);
+		return;
+	}
+
+	spawn_child_t *child = g_new0 (spawn_child_t, 1);
+	g_weak_ref_init (&child->term, call->term);
+	child->eof_handler = g_signal_connect (call->term, "eof", G_CALLBACK (spawn_child_eof), GINT_TO_POINTER (reply->pid));
+	g_hash_table_insert (spawn_children, GINT_TO_POINTER (reply->pid), child);
+	spawn_call_done (call, reply->pid, NULL);
+}
+
+static void spawn_out_free (gpointer data)
+{
+	spawn_out_t *out = data;
+
+	if (out->fd >= 0) {
+		close (out->fd);
+	}
+	g_free (out->data);
+	g_free (out);
+}
+
+// Drops anything still waiting to be written.
+static void spawn_outgoing_clear (void)
+{
+	if (spawn_out_source) {
+		g_source_remove (spawn_out_source);
+		spawn_out_source = 0;
+	}
+	g_queue_clear_full (&spawn_outgoing, spawn_out_free);
+}
+
+// The helper is gone, fail what it had yet to answer, and spawn directly from now on.
+static void spawn_helper_lost (void)
+{
+	errorf ("The spawn helper went away, spawning directly from now on.");
+
+	if (spawn_helper_source) {
+		g_source_remove (spawn_helper_source);
+		spawn_helper_source = 0;
+	}
+	spawn_outgoing_clear ();
+	close (spawn_helper_fd);
+	spawn_helper_fd	  = -1;
+	spawn_replies_len = 0;
+	waitpid (spawn_helper_pid, NULL, 0);
+	spawn_helper_pid = 0;
+
+	spawn_call_t *call;
+	while ((call = g_queue_pop_head (&spawn_pending)) != NULL) {
+		GError *error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE, "The spawn helper went away");
+		spawn_call_done (call, -1, error);
+		g_error_free (error);
+	}
+
+	// Nobody is going to tell us when these exit, so go by their output ending.
+	GList *pids = g_hash_table_get_keys (spawn_children);
+	for (GList *cur = pids; cur; cur = cur->next) {
+		spawn_child_t *child = g_hash_table_lookup (spawn_children, cur->data);
+		child->exited		 = true;
+		spawn_child_check (GPOINTER_TO_INT (cur->data), child);
+	}
+	g_list_free (pids);
+}
+
+static gboolean spawn_helper_readable (gint fd, GIOCondition condition, gpointer data)
+{
+	PROBE ();
+
+	ssize_t n = read (fd, spawn_replies + spawn_replies_len, sizeof (spawn_replies) - spawn_replies_len);
+	if (n < 0 && errno == EINTR) {
+		return G_SOURCE_CONTINUE;
+	}
+	if (n <= 0) {
+		spawn_helper_lost ();
+		return G_SOURCE_REMOVE;
+	}
+
+	spawn_replies_len += n;
+	gsize done = 0;
+	for (; spawn_replies_len - done >= sizeof (spawn_reply_t); done += sizeof (spawn_reply_t)) {
+		spawn_reply_t reply;
+		memcpy (&reply, spawn_replies + done, sizeof (reply));
+		spawn_helper_reply (&reply);
+	}
+	memmove (spawn_replies, spawn_replies + done, spawn_replies_len - done);
+	spawn_replies_len -= done;
+
+	return G_SOURCE_CONTINUE;
+}
+
+// Once the config has been read, stops the helper if it isn't wanted.
+void spawn_helper_apply (void)
+{
+	static bool warned = false;
+
+	if (!terms.spawn_helper) {
+		// Anything it started still needs it, to hear of them exiting.
+		if (spawn_helper_fd >= 0 && spawn_children == NULL) {
+			spawn_helper_stop ();
+		}
+		return;
+	}
+
+	if (spawn_helper_fd < 0) {
+		if (!warned) {
+			infof ("spawn_helper takes effect once zterm is restarted.");
+			warned = true;
+		}
+		return;
+	}
+
+	if (!spawn_helper_source) {
+		spawn_children		= g_hash_table_new_full (NULL, NULL, NULL, spawn_child_free);
+		spawn_helper_source = g_unix_fd_add (spawn_helper_fd, G_IO_IN | G_IO_HUP | G_IO_ERR, spawn_helper_readable, NULL);
+		infof ("Spawning through the spawn helper, pid %d.", spawn_helper_pid);
+	}
+}
+
+void spawn_helper_stop (void)
+{
+	spawn_call_t *call;
+
+	if (spawn_helper_source) {
+		g_source_remove (spawn_helper_source);
+		spawn_helper_source = 0;
+	}
+	spawn_outgoing_clear ();
+	if (spawn_helper_fd >= 0) {
+		close (spawn_helper_fd);
+		spawn_helper_fd = -1;
+	}
+	if (spawn_helper_pid) {
+		waitpid (spawn_helper_pid, NULL, 0);
+		spawn_helper_pid = 0;
+	}
+
+	// Shutting down, nobody is waiting on these.
+	while ((call = g_queue_pop_head (&spawn_pending)) != NULL) {
+		g_object_unref (call->term);
+		g_free (call);
+	}
+	if (spawn_children != NULL) {
+		g_hash_table_destroy (spawn_children);
+		spawn_children = NULL;
+	}
+}
+
+bool spawn_helper_running (void)
+{
+	return terms.spawn_helper && spawn_helper_source;
+}
+
+// What VTE sets in the environment of the children it spawns.
+static char *const *spawn_vte_env (void)
+{
+	static char	 version[32];
+	static char *env[] = {"TERM=xterm-256color", "COLORTERM=truecolor", version, NULL};
+
+	if (version[0] == '\0') {
+		snprintf (version, sizeof (version), "VTE_VERSION=%d",
+				  VTE_MAJOR_VERSION * 10000 + VTE_MINOR_VERSION * 100 + VTE_MICRO_VERSION);
+	}
+
+	return env;
+}
+
+static gboolean spawn_helper_writable (gint fd, GIOCondition condition, gpointer data);
+
+// Writes as much of spawn_outgoing as the socket will take without blocking, false if the helper is gone.
+static bool spawn_helper_flush (void)
+{
+	spawn_out_t *out;
+
+#ifndef MSG_NOSIGNAL
+#	define MSG_NOSIGNAL 0
+#endif
+	while ((out = g_queue_peek_head (&spawn_outgoing)) != NULL) {
+		char		  control[CMSG_SPACE (sizeof (int))];
+		struct iovec  iov = {.iov_base = out->data + out->sent, .iov_len = out->len - out->sent};
+		struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1};
+		ssize_t		  n;
+
+		if (out->fd >= 0) {
+			struct cmsghdr *cmsg;
+
+			memset (control, 0, sizeof (control));
+			msg.msg_control	   = control;
+			msg.msg_controllen = sizeof (control);
+			cmsg			   = CMSG_FIRSTHDR (&msg);
+			cmsg->cmsg_level   = SOL_SOCKET;
+			cmsg->cmsg_type	   = SCM_RIGHTS;
+			cmsg->cmsg_len	   = CMSG_LEN (sizeof (int));
+			memcpy (CMSG_DATA (cmsg), &out->fd, sizeof (out->fd));
+		}
+
+		do {
+			n = sendmsg (spawn_helper_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+		} while (n < 0 && errno == EINTR);
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			if (!spawn_out_source) {
+				spawn_out_source = g_unix_fd_add (spawn_helper_fd, G_IO_OUT, spawn_helper_writable, NULL);
+			}
+			return true;
+		}
+		if (n <= 0) {
+			return false;
+		}
+
+		if (out->fd >= 0) {
+			close (out->fd);
+			out->fd = -1;
+		}
+		out->sent += n;
+		if (out->sent == out->len) {
+			spawn_out_free (g_queue_pop_head (&spawn_outgoing));
+		}
+	}
+
+	return true;
+}
+
+static gboolean spawn_helper_writable (gint fd, GIOCondition condition, gpointer data)
+{
+	PROBE ();
+
+	if (!spawn_helper_flush ()) {
+		spawn_out_source = 0;
+		spawn_helper_lost ();
+		return G_SOURCE_REMOVE;
+	}
+	if (g_queue_is_empty (&spawn_outgoing)) {
+		spawn_out_source = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+// Gives term a new PTY and asks the helper to run argv on it, false if that couldn't be done.
+static bool spawn_helper_send (VteTerminal *term, const char *working_directory, char **argv, char **envp)
+{
+	GError *error = NULL;
+	VtePty *pty	  = vte_pty_new_sync (VTE_PTY_DEFAULT, NULL, &error);
+
+	if (pty == NULL) {
+		errorf ("Unable to open a PTY: %s", error->message);
+		g_error_free (error);
+		return false;
+	}
+
+	// Our own copy of the PTY, as term may be gone by the time the request is written.
+	int fd = fcntl (vte_pty_get_fd (pty), F_DUPFD_CLOEXEC, 0);
+	if (fd < 0) {
+		errorf ("Unable to pass on the PTY: %s", strerror (errno));
+		g_object_unref (pty);
+		return false;
+	}
+
+	spawn_request_t request = {0};
+	GString		   *message = g_string_new (NULL);
+	char		  **env		= config_envp_layer (envp, spawn_vte_env ());
+
+	// The header, filled in once the strings are all there.
+	g_string_append_len (message, (const char *) &request, sizeof (request));
+	g_string_append_len (message, working_directory != NULL ? working_directory : "",
+						 (working_directory != NULL ? strlen (working_directory) : 0) + 1);
+	for (; argv[request.argc] != NULL; request.argc++) {
+		g_string_append_len (message, argv[request.argc], strlen (argv[request.argc]) + 1);
+	}
+	for (; env[request.envc] != NULL; request.envc++) {
+		g_string_append_len (message, env[request.envc], strlen (env[request.envc]) + 1);
+	}
+	g_free (env);
+	request.size = message->len - sizeof (request);
+	memcpy (message->str, &request, sizeof (request));
+
+	// With the PTY set first, the child starts out at the right size.
+	vte_terminal_set_pty (term, pty);
+	g_object_unref (pty);
+
+	spawn_out_t *out = g_new0 (spawn_out_t, 1);
+	out->fd			 = fd;
+	out->len		 = message->len;
+	out->data		 = g_string_free (message, false);
+	g_queue_push_tail (&spawn_outgoing, out);
+
+	// Only write now if nothing is already waiting for the socket to drain.
+	if (!spawn_out_source && !spawn_helper_flush ()) {
+		spawn_helper_lost ();
+		return false;
+	}
+	return true;
+}
+
+static void spawn_vte_done (VteTerminal *term, GPid pid, GError *error, gpointer user_data)
+{
+	spawn_call_done (user_data, pid, error);
+}
+
+/*
+ * vte_terminal_spawn_async, through the helper while it's in use.  timeout
+ * only applies to spawning through VTE, the helper answers as soon as the
+ * child has exec'd or failed to.
+ */
+void spawn_async (VteTerminal *term, const char *working_directory, char **argv, char **envp, int timeout,
+				  VteTerminalSpawnAsyncCallback callback, gpointer user_data)
+{
+	spawn_call_t *call = g_new0 (spawn_call_t, 1);
+
+	call->term		= g_object_ref (term);
+	call->callback	= callback;
+	call->user_data = user_data;
+	call->start		= g_get_monotonic_time ();
+
+	if (spawn_helper_running () && spawn_helper_send (term, working_directory, argv, envp)) {
+		g_queue_push_tail (&spawn_pending, call);
+		return;
+	}
+
+	vte_terminal_spawn_async (term, VTE_PTY_DEFAULT, working_directory, argv, envp, G_SPAWN_DEFAULT, NULL, NULL, NULL, timeout,
+							  NULL, spawn_vte_done, call);
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
@@ -0,0 +1,181 @@
+#include "zterm.h"
+
+#include <errno.h>
+#include <glib-unix.h>
+#include <signal.h>
+#include <unistd.h>
+
+/*
+ * The trace ring buffer, with trace_buffer set in the config, or turned on
+ * and off through the control socket's trace command.
+ *
+ * TRACE () points write a fixed size record, a timestamp, a name and two
+ * numbers, into a ring of the most recent TRACE_RECORDS.  Nothing is
+ * formatted until the ring is dumped, by SIGUSR1 to a file in
+ * $XDG_RUNTIME_DIR, or by the trace command.
+ *
+ * Writers claim a record with an atomic increment and mark it complete by
+ * storing its sequence number last, so any thread may trace.  A reader only
+ * takes records whose sequence number is the one it expects, skipping any
+ * that are being written or were overwritten while it looked.
+ *
+ * Separately, --trace FILE writes Chrome trace event JSON, for Perfetto or
+ * chrome://tracing.  Every handler marked with PROBE () becomes a complete
+ * event with its duration, and the terminal slot and window it was for when
+ * it has them, along with a startup event from main to the first frame.
+ */
+
+#define TRACE_RECORDS 8192 // A power of two.
+
+bool trace_enabled = false;
+
+static trace_record_t trace_ring[TRACE_RECORDS];
+static guint64		  trace_next   = 0;
+static guint		  trace_signal = 0;
+
+bool		 trace_file_enabled = false;
+static FILE *trace_file			= NULL;
+static bool	 trace_file_empty	= true;
+
+void trace_record (const char *what, gint64 a, gint64 b)
+{
+	guint64			i	   = __atomic_fetch_add (&trace_next, 1, __ATOMIC_RELAXED);
+	trace_record_t *record = &trace_ring[i % TRACE_RECORDS];
+
+	__atomic_store_n (&record->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+	record->time = g_get_monotonic_time ();
+	record->what = what;
+	record->a	 = a;
+	record->b	 = b;
+	__atomic_store_n (&record->seq, i + 1, __ATOMIC_RELEASE);
+}
+
+// Copies out up to max of the most recent records, oldest first, returning how many.
+int trace_snapshot (trace_record_t *out, int max)
+{
+	guint64 end	  = __atomic_load_n (&trace_next, __ATOMIC_ACQUIRE);
+	guint64 start = end > (guint64) MIN (max, TRACE_RECORDS) ? end - MIN (max, TRACE_RECORDS) : 0;
+	int		n	  = 0;
+
+	for (guint64 i = start; i < end; i++) {
+		const trace_record_t *record = &trace_ring[i % TRACE_RECORDS];
+
+		if (__atomic_load_n (&record->seq, __ATOMIC_ACQUIRE) != i + 1) {
+			continue;
+		}
+		out[n] = *record;
+		__atomic_thread_fence (__ATOMIC_ACQUIRE);
+		if (__atomic_load_n (&record->seq, __ATOMIC_RELAXED) == i + 1) {
+			n++;
+		}
+	}
+
+	return n;
+}
+
+void trace_clear (void)
+{
+	for (int i = 0; i < TRACE_RECORDS; i++) {
+		__atomic_store_n (&trace_ring[i].seq, 0, __ATOMIC_RELAXED);
+	}
+}
+
+static gboolean trace_dump (gpointer data)
+{
+	trace_record_t *records = g_new (trace_record_t, TRACE_RECORDS);
+	int				n		= trace_snapshot (records, TRACE_RECORDS);
+	char			name[64];
+
+	snprintf (name, sizeof (name), "zterm-trace.%d", getpid ());
+	char *filename = g_build_filename (g_get_user_runtime_dir (), name, NULL);
+	FILE *io	   = fopen (filename, "w");
+
+	if (io == NULL) {
+		errorf ("Unable to write trace to '%s': %s", filename, strerror (errno));
+	} else {
+		for (int i = 0; i < n; i++) {
+			fprintf (io, "%" G_GINT64_FORMAT " %s %" G_GINT64_FORMAT " %" G_GINT64_FORMAT "\n", records[i].time,
+					 records[i].what, records[i].a, records[i].b);
+		}
+		fclose (io);
+		infof ("Wrote %d trace records to '%s'%s.", n, filename, trace_enabled ? "" : ", trace_buffer is not enabled");
+	}
+
+	g_free (filename);
+	g_free (records);
+	return G_SOURCE_CONTINUE;
+}
+
+// Applies terms.trace_buffer, and sets up SIGUSR1 the first time.
+void trace_start (void)
+{
+	trace_enabled = terms.trace_buffer;
+
+	if (!trace_signal) {
+		trace_signal = g_unix_signal_add (SIGUSR1, trace_dump, NULL);
+	}
+}
+
+void trace_stop (void)
+{
+	trace_enabled = false;
+
+	if (trace_signal) {
+		g_source_remove (trace_signal);
+		trace_signal = 0;
+	}
+}
+
+bool trace_file_open (const char *filename)
+{
+	trace_file = fopen (filename, "w");
+	if (trace_file == NULL) {
+		errorf ("Unable to open trace file '%s': %s", filename, strerror (errno));
+		return false;
+	}
+
+	fputs ("[\n", trace_file);
+	trace_file_empty   = true;
+	trace_file_enabled = true;
+	probes_update ();
+	return true;
+}
+
+// One complete event, from start until now, with slot and window numbered as for the control socket.
+void trace_file_span (const char *name, gint64 start, long slot, int window)
+{
+	gint64 now = g_get_monotonic_time ();
+
+	if (trace_file == NULL) {
+		return;
+	}
+
+	fprintf (trace_file,
+			 "%s{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %" G_GINT64_FORMAT ", \"dur\": %" G_GINT64_FORMAT
+			 ", \"pid\": %d, \"tid\": 1, \"args\": {",
+			 trace_file_empty ? "" : ",\n", name, start, now - start, getpid ());
+	if (slot >= 0) {
+		fprintf (trace_file, "\"slot\": %ld%s", slot + 1, window >= 0 ? ", " : "");
+	}
+	if (window >= 0) {
+		fprintf (trace_file, "\"window\": %d", window);
+	}
+	fputs ("}}", trace_file);
+	trace_file_empty = false;
+}
+
+void trace_file_close (void)
+{
+	if (trace_file == NULL) {
+		return;
+	}
+
+	fputs ("\n]\n", trace_file);
+	fclose (trace_file);
+	trace_file		   = NULL;
+	trace_file_enabled = false;
+	probes_update ();
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
@@ -0,0 +1,224 @@
+#include "zterm.h"
+
+/*
+ * The stall watchdog, with watchdog_ms set in the config.
+ *
+ * The main loop beats a heartbeat from a high priority timeout, while a
+ * thread of our own watches for it to stop.  When it has been quiet for more
+ * than watchdog_ms, the thread samples which zterm handler the main thread is
+ * in, from the PROBE markers, until the heartbeat comes back and reports the
+ * stall with its duration and the samples.  If no handler was running, the
+ * time went to GTK or VTE, most likely in processing a flood of output.
+ *
+ * The same markers time each handler for --trace, see trace.c, and are a
+ * test of probes_enabled when neither is on.
+ */
+
+#define PROBE_DEPTH		16
+#define WATCHDOG_SAMPLES 8
+
+typedef struct watchdog_sample_s {
+	char  where[256];
+	guint count;
+} watchdog_sample_t;
+
+bool probes_enabled = false;
+
+// Only the main thread writes these, the watchdog reads them while the main thread is stuck.
+static const char *probe_stack[PROBE_DEPTH];
+static gint		   probe_depth = 0;
+
+// For --trace, only ever touched by the main thread.
+static gint64 probe_start[PROBE_DEPTH];
+static long	  probe_slot[PROBE_DEPTH];
+static int	  probe_window[PROBE_DEPTH];
+
+static GThread *watchdog_thread = NULL;
+static guint	watchdog_source = 0;
+static GMutex	watchdog_lock;
+static GCond	watchdog_cond;
+
+// The rest are under watchdog_lock.
+static bool				 watchdog_stopping	= false;
+static gint64			 watchdog_interval	= 0;
+static gint64			 watchdog_threshold = 0;
+static gint64			 watchdog_beat		= 0;
+static bool				 watchdog_stuck		= false;
+static int				 watchdog_n_samples = 0;
+static watchdog_sample_t watchdog_samples[WATCHDOG_SAMPLES];
+static char				 watchdog_last[256]; // Where the latest sample was, whether or not the table had room for it.
+
+void probe_enter (const char *name, long slot, int window)
+{
+	gint depth = probe_depth;
+
+	if (depth < PROBE_DEPTH) {
+		g_atomic_pointer_set (&probe_stack[depth], name);
+		probe_start[depth]	= trace_file_enabled ? g_get_monotonic_time () : 0;
+		probe_slot[depth]	= slot;
+		probe_window[depth] = window;
+	}
+	g_atomic_int_set (&probe_depth, depth + 1);
+}
+
+void probe_pop (void)
+{
+	gint depth = MAX (0, probe_depth - 1);
+
+	if (depth < PROBE_DEPTH && probe_start[depth] && trace_file_enabled) {
+		trace_file_span (probe_stack[depth], probe_start[depth], probe_slot[depth], probe_window[depth]);
+	}
+	g_atomic_int_set (&probe_depth, depth);
+}
+
+// The markers are wanted by the watchdog, --trace, or both.
+void probes_update (void)
+{
+	probes_enabled = watchdog_thread != NULL || trace_file_enabled;
+}
+
+// What the main thread is in right now, outermost first.
+static void watchdog_where (char *where, size_t len)
+{
+	gint depth = MIN (g_atomic_int_get (&probe_depth), PROBE_DEPTH);
+
+	if (!depth) {
+		strlcpy (where, "no zterm handler", len);
+		return;
+	}
+
+	where[0] = '\0';
+	for (int i = 0; i < depth; i++) {
+		if (i) {
+			strlcat (where, " > ", len);
+		}
+		strlcat (where, g_atomic_pointer_get (&probe_stack[i]), len);
+	}
+}
+
+// Called with watchdog_lock held.
+static void watchdog_sample (void)
+{
+	char where[256];
+
+	watchdog_where (where, sizeof (where));
+	strlcpy (watchdog_last, where, sizeof (watchdog_last));
+	for (int i = 0; i < watchdog_n_samples; i++) {
+		if (!strcmp (watchdog_samples[i].where, where)) {
+			watchdog_samples[i].count++;
+			return;
+		}
+	}
+
+	if (watchdog_n_samples < WATCHDOG_SAMPLES) {
+		strlcpy (watchdog_samples[watchdog_n_samples].where, where, sizeof (watchdog_samples[0].where));
+		watchdog_samples[watchdog_n_samples++].count = 1;
+	}
+}
+
+static gpointer watchdog_run (gpointer data)
+{
+	g_mutex_lock (&watchdog_lock);
+	while (!watchdog_stopping) {
+		g_cond_wait_until (&watchdog_cond, &watchdog_lock, g_get_monotonic_time () + watchdog_interval);
+		if (watchdog_stopping) {
+			break;
+		}
+
+		gint64 quiet = g_get_monotonic_time () - watchdog_beat - watchdog_interval;
+		if (quiet < watchdog_threshold) {
+			continue;
+		}
+
+		watchdog_sample ();
+
+		// The heartbeat reports the stall once it's over, but it may never be.
+		if (!watchdog_stuck && quiet > 10 * watchdog_threshold) {
+			watchdog_stuck = true;
+			errorf ("Main loop stuck for %" G_GINT64_FORMAT " ms so far, in %s.", quiet / 1000, watchdog_last);
+		}
+	}
+	g_mutex_unlock (&watchdog_lock);
+
+	return NULL;
+}
+
+static gboolean watchdog_heartbeat (gpointer data)
+{
+	watchdog_sample_t samples[WATCHDOG_SAMPLES];
+	gint64			  now = g_get_monotonic_time ();
+
+	g_mutex_lock (&watchdog_lock);
+	gint64 stall	   = now - watchdog_beat - watchdog_interval;
+	int	   n_samples   = watchdog_n_samples;
+	watchdog_beat	   = now;
+	watchdog_stuck	   = false;
+	watchdog_n_samples = 0;
+	memcpy (samples, watchdog_samples, n_samples * sizeof (samples[0]));
+	g_mutex_unlock (&watchdog_lock);
+
+	if (stall < watchdog_threshold) {
+		return G_SOURCE_CONTINUE;
+	}
+
+	char report[1024];
+	report[0] = '\0';
+	for (int i = 0; i < n_samples; i++) {
+		char sample[300];
+		snprintf (sample, sizeof (sample), "%s%s (%u)", i ? ", " : "", samples[i].where, samples[i].count);
+		strlcat (report, sample, sizeof (report));
+	}
+	errorf ("Main loop stalled for %" G_GINT64_FORMAT " ms, in: %s", stall / 1000, n_samples ? report : "unknown");
+
+	return G_SOURCE_CONTINUE;
+}
+
+void watchdog_stop (void)
+{
+	if (!watchdog_thread) {
+		return;
+	}
+
+	g_source_remove (watchdog_source);
+	watchdog_source = 0;
+
+	g_mutex_lock (&watchdog_lock);
+	watchdog_stopping = true;
+	g_cond_signal (&watchdog_cond);
+	g_mutex_unlock (&watchdog_lock);
+
+	g_thread_join (watchdog_thread);
+	watchdog_thread	  = NULL;
+	watchdog_stopping = false;
+	probes_update ();
+}
+
+// Starts, restarts or stops the watchdog to match terms.watchdog_ms.
+void watchdog_start (void)
+{
+	gint64 threshold = MAX (0, terms.watchdog_ms) * (gint64) 1000;
+
+	if (watchdog_thread && threshold == watchdog_threshold) {
+		return;
+	}
+
+	watchdog_stop ();
+	if (!threshold) {
+		return;
+	}
+
+	// Beat often enough that a stall is seen within a quarter of the threshold.
+	watchdog_threshold = threshold;
+	watchdog_interval  = MAX (threshold / 4, 5000);
+	watchdog_beat	   = g_get_monotonic_time ();
+	watchdog_stuck	   = false;
+	watchdog_n_samples = 0;
+
+	watchdog_source = g_timeout_add_full (G_PRIORITY_HIGH, watchdog_interval / 1000, watchdog_heartbeat, NULL, NULL);
+	watchdog_thread = g_thread_new ("watchdog", watchdog_run, NULL);
+	probes_update ();
+
+	infof ("Watching for main loop stalls over %d ms.", terms.watchdog_ms);
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
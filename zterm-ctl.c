@@ -0,0 +1,218 @@
+/*
+ * zterm-ctl: Talk to a running zterm without starting GTK.
+ *
+ * Running zterm -s 5 or zterm --list works, but it means bringing up GTK and
+ * VTE just to forward the arguments to the primary instance.  This does the
+ * same forwarding with nothing but GIO, by making the
+ * org.gtk.Application.CommandLine D-Bus call that GApplication would have
+ * made for us, so the primary's command_line handler can't tell the
+ * difference.
+ *
+ * Usage: zterm-ctl [-s TARGET] [-l] [-- command [args...]]
+ *
+ * If there's no zterm running, we exec zterm itself with the same arguments,
+ * the one next to us if there is one, so that a build starts its own zterm.
+ */
+#include <errno.h>
+#include <gio/gio.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Must match zterm.c.  The object path is the one GApplication derives from the application ID.
+#ifdef DEBUG
+#	define ZTERM_NAME "zterm.debug"
+#	define ZTERM_PATH "/com/aehallh/zterm/debug"
+#else
+#	define ZTERM_NAME "zterm"
+#	define ZTERM_PATH "/com/aehallh/zterm"
+#endif
+#define ZTERM_APP_ID "com.aehallh." ZTERM_NAME
+
+extern char **environ;
+
+static const char command_line_xml[] = "<node>"
+  "  <interface name='org.gtk.private.CommandLine'>"
+  "    <method name='Print'>"
+  "      <arg type='s' name='message' direction='in'/>"
+  "    </method>"
+  "    <method name='PrintError'>"
+  "      <arg type='s' name='message' direction='in'/>"
+  "    </method>"
+  "  </interface>"
+  "</node>";
+
+typedef struct ctl_s {
+	GMainLoop *loop;
+	int		   status;
+	bool	   no_instance;
+} ctl_t;
+
+static char	   *switch_target = NULL;
+static gboolean list_terms	  = FALSE;
+static char	  **remaining	  = NULL;
+
+static const GOptionEntry cli_options[] = {
+  {"switch", 's', 0, G_OPTION_ARG_STRING, &switch_target, "Switch to terminal by number, key, or PTS", "TARGET"},
+  {"list", 'l', 0, G_OPTION_ARG_NONE, &list_terms, "List terminals", NULL},
+  {G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &remaining, NULL, NULL},
+  {NULL},
+};
+
+// The primary instance calls back into us for anything it wants printed.
+static void command_line_method_call (GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+									  const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+									  GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	const char *message;
+
+	g_variant_get (parameters, "(&s)", &message);
+
+	if (!strcmp (method_name, "Print")) {
+		fputs (message, stdout);
+		fflush (stdout);
+	} else {
+		fputs (message, stderr);
+	}
+
+	g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static const GDBusInterfaceVTable command_line_vtable = {.method_call = command_line_method_call};
+
+static void command_line_done (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	ctl_t	 *ctl	= user_data;
+	GError	 *error = NULL;
+	GVariant *reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+
+	if (reply != NULL) {
+		g_variant_get (reply, "(i)", &ctl->status);
+		g_variant_unref (reply);
+	} else {
+		if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN) ||
+			g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_NAME_HAS_NO_OWNER)) {
+			ctl->no_instance = true;
+		} else {
+			fprintf (stderr, "zterm-ctl: %s\n", error->message);
+		}
+		g_error_free (error);
+		ctl->status = 1;
+	}
+
+	g_main_loop_quit (ctl->loop);
+}
+
+static GVariant *build_platform_data (void)
+{
+	GVariantBuilder builder, options;
+	char		   *cwd = g_get_current_dir ();
+
+	g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+	if (switch_target != NULL) {
+		g_variant_builder_add (&options, "{sv}", "switch", g_variant_new_string (switch_target));
+	}
+	if (list_terms) {
+		g_variant_builder_add (&options, "{sv}", "list", g_variant_new_boolean (true));
+	}
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "cwd", g_variant_new_bytestring (cwd));
+	g_variant_builder_add (&builder, "{sv}", "environ", g_variant_new_bytestring_array ((const gchar *const *) environ, -1));
+	g_variant_builder_add (&builder, "{sv}", "options", g_variant_builder_end (&options));
+
+	g_free (cwd);
+
+	return g_variant_builder_end (&builder);
+}
+
+static GVariant *build_arguments (const char *argv0)
+{
+	GVariantBuilder builder;
+
+	// Like GApplication, the options have already been taken out, so this is argv[0] and the command to run, if any.
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_BYTESTRING_ARRAY);
+	g_variant_builder_add_value (&builder, g_variant_new_bytestring (argv0));
+	for (int i = 0; remaining != NULL && remaining[i] != NULL; i++) {
+		g_variant_builder_add_value (&builder, g_variant_new_bytestring (remaining[i]));
+	}
+
+	return g_variant_builder_end (&builder);
+}
+
+// The zterm in the same directory as zterm-ctl, or failing that, whichever is first in $PATH.
+static char *zterm_path (void)
+{
+	char *self = g_file_read_link ("/proc/self/exe", NULL);
+
+	if (self != NULL) {
+		char *dir  = g_path_get_dirname (self);
+		char *path = g_build_filename (dir, "zterm", NULL);
+
+		g_free (dir);
+		g_free (self);
+		if (g_file_test (path, G_FILE_TEST_IS_EXECUTABLE)) {
+			return path;
+		}
+		g_free (path);
+	}
+
+	return g_strdup ("zterm");
+}
+
+int main (int argc, char *argv[])
+{
+	GOptionContext *context = g_option_context_new ("[-- COMMAND [ARGS...]]");
+	GError		   *error	= NULL;
+	ctl_t			ctl		= {0};
+	char		  **args	= g_strdupv (argv); // For the fallback, as option parsing eats argv.
+
+	g_option_context_add_main_entries (context, cli_options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		fprintf (stderr, "zterm-ctl: %s\n", error->message);
+		return 2;
+	}
+	g_option_context_free (context);
+
+	GDBusConnection *bus = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+	if (bus == NULL) {
+		fprintf (stderr, "zterm-ctl: Unable to connect to the session bus: %s\n", error->message);
+		return 1;
+	}
+
+	GDBusNodeInfo *info = g_dbus_node_info_new_for_xml (command_line_xml, NULL);
+	char		  *path = g_strdup_printf ("/org/gtk/Application/CommandLine/zterm_ctl_%d", getpid ());
+	guint		   id	= g_dbus_connection_register_object (bus, path, info->interfaces[0], &command_line_vtable, NULL, NULL,
+															 &error);
+	if (!id) {
+		fprintf (stderr, "zterm-ctl: Unable to export %s: %s\n", path, error->message);
+		return 1;
+	}
+
+	ctl.loop = g_main_loop_new (NULL, false);
+	g_dbus_connection_call (bus, ZTERM_APP_ID, ZTERM_PATH, "org.gtk.Application", "CommandLine",
+							g_variant_new ("(o@aay@a{sv})", path, build_arguments (argv[0]), build_platform_data ()),
+							G_VARIANT_TYPE ("(i)"), G_DBUS_CALL_FLAGS_NO_AUTO_START, G_MAXINT, NULL, command_line_done, &ctl);
+	g_main_loop_run (ctl.loop);
+
+	g_dbus_connection_unregister_object (bus, id);
+	g_main_loop_unref (ctl.loop);
+	g_dbus_node_info_unref (info);
+	g_object_unref (bus);
+	g_free (path);
+
+	if (ctl.no_instance) {
+		// Nobody to forward to, so become the primary instance instead.
+		g_free (args[0]);
+		args[0] = zterm_path ();
+		execvp (args[0], args);
+		fprintf (stderr, "zterm-ctl: No running zterm, and unable to start one: %s\n", g_strerror (errno));
+		return 1;
+	}
+
+	return ctl.status;
+}
+
+// vim: set ts=4 sw=4 noexpandtab :
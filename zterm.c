@@ -5,7 +5,6 @@
 #include <gdk/gdk.h>
 #include <gio/gio.h>
 #include <gtk/gtk.h>
-#include <pwd.h>
 #include <sched.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -18,9 +17,8 @@
 #define PCRE2_CODE_UNIT_WIDTH 0
 #include <pcre2.h>
 
-extern char **environ;
-
-GdkRGBA colors[256] = {
+// The palette, before any color overrides from the config, see config_gen_new.
+const GdkRGBA default_colors[256] = {
 #include "256colors.h"
 };
 
@@ -72,37 +70,89 @@ int _fprintf (bool print, FILE *io, const char *fmt, ...)
 	return ret;
 }
 
-// This exists just to ensure that the arguments are always evaluated.
-int _fnullf (const FILE *io, const char *fmt, ...)
-{
-	return 0;
-}
-
 int start_width	 = 1024;
 int start_height = 768;
 
 int char_width	= 0;
 int char_height = 0;
 
-unsigned int key_bind_mask = (GDK_MODIFIER_MASK & ~GDK_LOCK_MASK) ^
-							 (GDK_BUTTON1_MASK | GDK_BUTTON2_MASK | GDK_BUTTON3_MASK | GDK_BUTTON4_MASK | GDK_BUTTON5_MASK);
-
-unsigned int button_bind_mask = (GDK_MODIFIER_MASK & ~GDK_LOCK_MASK) ^
-								(GDK_BUTTON1_MASK | GDK_BUTTON2_MASK | GDK_BUTTON3_MASK | GDK_BUTTON4_MASK | GDK_BUTTON5_MASK);
-
-terms_t	 terms;
-window_t windows[MAX_WINDOWS];
+terms_t		  terms;
+window_t	  windows[MAX_WINDOWS];
+frame_stats_t frame_stats;
 
 GtkApplication *app;
 
 static const GOptionEntry cli_options[] = {
   {"switch", 's', 0, G_OPTION_ARG_STRING, NULL, "Switch to terminal by number, key, or PTS", "TARGET"},
   {"list", 'l', 0, G_OPTION_ARG_NONE, NULL, "List terminals", NULL},
+  {"trace", 0, 0, G_OPTION_ARG_FILENAME, NULL, "Write a Chrome trace of event handling to FILE", "FILE"},
+  {"startup-profile", 0, 0, G_OPTION_ARG_NONE, NULL, "Print how long each step of starting up took", NULL},
   {NULL},
 };
 
 static cmd_t *initial_cmd = NULL;
 
+/*
+ * --startup-profile, the time from main to each step of starting up, ending
+ * with the first output from a terminal making it to the screen.
+ */
+#define STARTUP_MARKS 16
+
+typedef struct startup_mark_s {
+	const char *what;
+	gint64		time;
+} startup_mark_t;
+
+static gint64		  main_started	  = 0;
+static bool			  first_paint	  = false;
+static bool			  startup_profile = false;
+static bool			  startup_output  = false; // Seen the first output, waiting for it to be painted.
+static bool			  startup_defer	  = false; // fast_start, and the menus are not built yet.
+static bool			  startup_spawned = false; // The first terminal has its child, startup_finish can go once it's painted.
+static guint		  startup_source  = 0;
+static startup_mark_t startup_marks[STARTUP_MARKS];
+static int			  startup_n_marks = 0;
+
+static void startup_mark (const char *what)
+{
+	if (G_UNLIKELY (startup_profile) && startup_n_marks < STARTUP_MARKS) {
+		startup_marks[startup_n_marks].what	  = what;
+		startup_marks[startup_n_marks++].time = g_get_monotonic_time ();
+	}
+}
+
+static void startup_report (void)
+{
+	gint64 last = main_started;
+
+	infof ("Startup profile%s, ms since main:", terms.fast_start ? " with fast_start" : "");
+	for (int i = 0; i < startup_n_marks; i++) {
+		infof ("%9.2f (+%8.2f)  %s", (startup_marks[i].time - main_started) / 1000.0, (startup_marks[i].time - last) / 1000.0,
+			   startup_marks[i].what);
+		last = startup_marks[i].time;
+	}
+	startup_profile = false;
+}
+
+static gboolean startup_finish (gpointer data);
+
+// With fast_start, the rest of starting up, once.
+static void startup_finish_queue (void)
+{
+	if (startup_defer && !startup_source) {
+		startup_source = g_idle_add_full (G_PRIORITY_LOW, startup_finish, NULL, NULL);
+	}
+}
+
+static void startup_first_output (VteTerminal *term, gpointer user_data)
+{
+	g_signal_handlers_disconnect_by_func (G_OBJECT (term), G_CALLBACK (startup_first_output), user_data);
+	if (startup_profile && !startup_output) {
+		startup_mark ("first output");
+		startup_output = true;
+	}
+}
+
 static bool switch_target_is_number (const char *target, long *out)
 {
 	char *end = NULL;
@@ -134,26 +184,13 @@ static bool switch_target_is_key (const char *target, long *out)
 		return false;
 	}
 
-	for (bind_t *cur = terms.keys; cur; cur = cur->next) {
-		if (cur->action != BIND_ACT_SWITCH) {
-			continue;
-		}
-
-		if ((state & key_bind_mask) != cur->state) {
-			continue;
-		}
-
-		if (key < cur->key_min || key > cur->key_max) {
-			continue;
-		}
-
-		long n = cur->base + (key - cur->key_min);
-
-		*out = n;
-		return true;
+	key_entry_t *entry = key_table_lookup (config_gen, state, key);
+	if (entry == NULL || entry->bind->action != BIND_ACT_SWITCH) {
+		return false;
 	}
 
-	return false;
+	*out = entry->n;
+	return true;
 }
 
 static bool switch_target_is_pts (const char *target, long *out)
@@ -164,38 +201,17 @@ static bool switch_target_is_pts (const char *target, long *out)
 		needle = target + 5;
 	}
 
-	if (!terms.active) {
+	if (!terms.active || !terms.pts_index) {
 		return false;
 	}
 
-	for (int i = 0; i < terms.n_active; i++) {
-		if (terms.active[i].term == NULL) {
-			continue;
-		}
-
-		VtePty *pty = vte_terminal_get_pty (VTE_TERMINAL (terms.active[i].term));
-		if (!pty) {
-			continue;
-		}
-
-		int	  fd  = vte_pty_get_fd (pty);
-		char *pts = ptsname (fd);
-
-		if (!pts) {
-			continue;
-		}
-
-		if (g_str_has_prefix (pts, "/dev/")) {
-			pts += 5;
-		}
-
-		if (!strcmp (pts, needle)) {
-			*out = i;
-			return true;
-		}
+	long n = GPOINTER_TO_INT (g_hash_table_lookup (terms.pts_index, needle)) - 1;
+	if (n < 0 || n >= terms.n_active || terms.active[n].term == NULL) {
+		return false;
 	}
 
-	return false;
+	*out = n;
+	return true;
 }
 
 static void free_cli_exec (exec_t **cli_exec_ptr)
@@ -231,8 +247,16 @@ static void free_cmd (cmd_t **cmd_ptr)
 	*cmd_ptr = NULL;
 }
 
-static bool switch_cmd (cmd_t *cmd)
+// A terminal number, key binding, or PTS, as taken by --switch.
+bool switch_target_resolve (const char *target, long *n)
 {
+	return switch_target_is_number (target, n) || switch_target_is_key (target, n) || switch_target_is_pts (target, n);
+}
+
+bool switch_cmd (cmd_t *cmd)
+{
+	PROBE_ARGS (cmd->n, cmd->window_i);
+
 	if (!terms.active) {
 		initial_cmd = cmd;
 		return true;
@@ -250,11 +274,11 @@ static bool switch_cmd (cmd_t *cmd)
 				debugf ("  argv[%d]: '%s'", i, cmd->cli_exec->argv[i]);
 			}
 		}
-		term_switch (cmd->n, cmd->cli_exec->argv, cmd->cli_exec->env, cmd->window_i);
+		term_switch (cmd->n, cmd->cli_exec->argv, cmd->cli_exec->env, NULL, cmd->window_i);
 	} else {
 		bind_t *found = NULL;
 
-		for (bind_t *cur = terms.keys; cur; cur = cur->next) {
+		for (bind_t *cur = config_gen->keys; cur; cur = cur->next) {
 			if (cmd->n >= cur->base && cmd->n <= (cur->base + (cur->key_max - cur->key_min))) {
 				found = cur;
 				break;
@@ -262,9 +286,9 @@ static bool switch_cmd (cmd_t *cmd)
 		}
 
 		if (found != NULL) {
-			term_switch (cmd->n, found->argv, found->env, 0);
+			term_switch (cmd->n, found->argv, found->envp, config_gen, cmd->window_i);
 		} else {
-			term_switch (cmd->n, NULL, NULL, cmd->window_i);
+			term_switch (cmd->n, NULL, NULL, NULL, cmd->window_i);
 		}
 	}
 
@@ -274,6 +298,7 @@ static bool switch_cmd (cmd_t *cmd)
 
 static int command_line (GApplication *application, GApplicationCommandLine *cmdline, gpointer user_data)
 {
+	PROBE ();
 
 	GVariantDict *dict			= g_application_command_line_get_options_dict (cmdline);
 	const char	 *switch_target = NULL;
@@ -314,12 +339,7 @@ static int command_line (GApplication *application, GApplicationCommandLine *cmd
 	if (g_variant_dict_lookup (dict, "switch", "&s", &switch_target)) {
 		debugf ("Found switch argument: '%s'", switch_target);
 		if (switch_target) {
-			if (switch_target_is_number (switch_target, &cmd->n)) {
-				/* switch_lookup_command_for_index (remote_cmd->n, &cmd, &argv, &env); */
-			} else if (switch_target_is_key (switch_target, &cmd->n)) {
-				// Already set.
-			} else if (switch_target_is_pts (switch_target, &cmd->n)) {
-			} else {
+			if (!switch_target_resolve (switch_target, &cmd->n)) {
 				errorf ("Unable to resolve switch target '%s'.", switch_target);
 				g_application_command_line_set_exit_status (cmdline, 1);
 				return 1;
@@ -331,7 +351,7 @@ static int command_line (GApplication *application, GApplicationCommandLine *cmd
 	}
 	if (!have_term_n) {
 		for (int i = 0; i < terms.n_active; i++) {
-			if (!terms.active[i].spawned) {
+			if (terms.active[i].spawn_state == TERM_SPAWN_NONE) {
 				cmd->n		= i;
 				have_term_n = true;
 
@@ -346,21 +366,21 @@ static int command_line (GApplication *application, GApplicationCommandLine *cmd
 		for (int window_i = 0; window_i < MAX_WINDOWS; window_i++) {
 			if (windows[window_i].window) {
 				g_application_command_line_print (cmdline, "Window %d:\n", window_i);
-				g_application_command_line_print (cmdline, "  %-2s  %-6s  %-20s  %s\n", "#", "PTS", "Binding", "Title");
+				g_application_command_line_print (cmdline, "  %-2s  %-6s  %-20s  %-15s  %s\n", "#", "PTS", "Binding",
+												  "Scrollback", "Title");
 				for (int i = 0; i < terms.n_active; i++) {
 					if (terms.active[i].term && terms.active[i].window == window_i) {
-						for (bind_t *cur = terms.keys; cur; cur = cur->next) {
+						for (bind_t *cur = config_gen->keys; cur; cur = cur->next) {
 							if (cur->action == BIND_ACT_SWITCH) {
 								if (i >= cur->base && i <= (cur->base + (cur->key_max - cur->key_min))) {
-									gchar  *binding = gtk_accelerator_name (cur->key_min + (i - cur->base), cur->state);
-									VtePty *pty		= vte_terminal_get_pty (VTE_TERMINAL (terms.active[i].term));
-									int		fd		= vte_pty_get_fd (pty);
-									char   *pts		= ptsname (fd);
-									if (g_str_has_prefix (pts, "/dev/")) {
-										pts += 5;
-									}
-
-									g_application_command_line_print (cmdline, "  %-2d  %-6s  %-20s  %s\n", i + 1, pts, binding,
+									gchar *binding = gtk_accelerator_name (cur->key_min + (i - cur->base), cur->state);
+
+									char scrollback[32];
+
+									snprintf (scrollback, sizeof (scrollback), "%ld/%ld", term_scrollback_used (i),
+											  terms.active[i].scrollback_limit);
+									g_application_command_line_print (cmdline, "  %-2d  %-6s  %-20s  %-15s  %s\n", i + 1,
+																	  terms.active[i].pts, binding, scrollback,
 																	  terms.active[i].title);
 									break;
 								}
@@ -381,6 +401,47 @@ static int command_line (GApplication *application, GApplicationCommandLine *cmd
 	return 0;
 }
 
+// Options that apply to this process, rather than being passed on to the running zterm.
+static int handle_local_options (GApplication *application, GVariantDict *options, gpointer user_data)
+{
+	const char *trace_filename = NULL;
+	gboolean	profile		   = FALSE;
+	GError	   *error		   = NULL;
+
+	// Registering now, rather than in g_application_run, tells us if we're just passing our arguments on.
+	if (!g_application_register (application, NULL, &error)) {
+		errorf ("Unable to register: %s", error->message);
+		g_error_free (error);
+		return 1;
+	}
+	bool remote = g_application_get_is_remote (application);
+
+	// Started before we knew, if another zterm got there first.
+	if (remote) {
+		spawn_helper_stop ();
+	}
+
+	if (g_variant_dict_lookup (options, "trace", "^&ay", &trace_filename)) {
+		if (remote) {
+			errorf ("zterm is already running, --trace only applies when starting it.");
+			return 1;
+		}
+		if (!trace_file_open (trace_filename)) {
+			return 1;
+		}
+	}
+	if (g_variant_dict_lookup (options, "startup-profile", "b", &profile) && profile) {
+		if (remote) {
+			errorf ("zterm is already running, --startup-profile only applies when starting it.");
+			return 1;
+		}
+		startup_profile = true;
+		startup_mark ("options");
+	}
+
+	return -1;
+}
+
 static void		window_pressed_event (GtkGestureClick *gesture, gint n_press, gdouble x, double y, gpointer user_data);
 static gboolean button_event (GtkGesture *gesture, double x, double y, int64_t term_n, window_t *window);
 int				new_window (void);
@@ -422,15 +483,36 @@ static void temu_reorder (void)
 	}
 }
 
+/*
+ * Terminal widgets carry their slot, and toplevels their window index, as
+ * qdata, so that going from a widget back to terms.active or windows doesn't
+ * need a scan.  Both are stored plus one, so that NULL means unset.
+ */
+G_DEFINE_QUARK (zterm-term-slot, term_slot)
+G_DEFINE_QUARK (zterm-window-index, window_index)
+
 bool term_find (GtkWidget *term, int *i)
 {
-	for (*i = 0; *i < terms.n_active; *i = *i + 1) {
-		if (terms.active[*i].term == GTK_WIDGET (term)) {
-			return true;
-		}
+	int n = term ? GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (term), term_slot_quark ())) - 1 : -1;
+
+	// A slot may have let go of its terminal, or be using a different one by now.
+	if (n < 0 || n >= terms.n_active || terms.active[n].term != GTK_WIDGET (term)) {
+		return false;
+	}
+
+	*i = n;
+	return true;
+}
+
+static int window_find (GtkWidget *window)
+{
+	int i = window ? GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (window), window_index_quark ())) - 1 : -1;
+
+	if (i < 0 || i >= MAX_WINDOWS || windows[i].window != window) {
+		return -1;
 	}
 
-	return false; // Default to terminal 0.
+	return i;
 }
 
 static void temu_window_title_change (VteTerminal *terminal, long int n)
@@ -440,16 +522,8 @@ static void temu_window_title_change (VteTerminal *terminal, long int n)
 	int			max_windows = 0;
 	int			window_i	= terms.active[n].window;
 	int			notebook_i	= 0;
-	VtePty	   *pty			= vte_terminal_get_pty (terminal);
-	char	   *pts			= NULL;
-
-	if (pty == NULL) {
-		debugf ("pty not set for terminal %ld", n);
-	} else {
-		int pty_fd = vte_pty_get_fd (pty);
-		pts		   = ptsname (pty_fd);
-	}
 
+	TRACE ("title", n, window_i);
 	for (int i = 0; i < MAX_WINDOWS; i++) {
 		if (windows[i].window) {
 			max_windows++;
@@ -466,12 +540,8 @@ static void temu_window_title_change (VteTerminal *terminal, long int n)
 	title_str = vte_terminal_get_window_title (terminal);
 #endif
 
-	if (pts != NULL && strncmp ("/dev/", pts, 5) == 0) {
-		pts += 5;
-	}
-
 	if (snprintf (terms.active[n].title, sizeof (terms.active[n].title) - 1, "%s%s [%ld - %s]", window_str,
-				  title_str ? title_str : "zterm", n + 1, pts) < 0) {
+				  title_str ? title_str : "zterm", n + 1, terms.active[n].pts) < 0) {
 		return; // Memory allocation issue.
 	}
 
@@ -483,11 +553,13 @@ static void temu_window_title_change (VteTerminal *terminal, long int n)
 		gtk_notebook_set_tab_label_text (windows[window_i].notebook, GTK_WIDGET (terminal), terms.active[n].title);
 	}
 
-	rebuild_term_list (window_i);
+	term_list_title_changed (window_i, n);
 }
 
 static void temu_window_title_changed (VteTerminal *terminal, gpointer data)
 {
+	PROBE_ARGS ((long) data, -1);
+
 	gint n = (long) data;
 
 	temu_window_title_change (terminal, n);
@@ -529,6 +601,8 @@ static void prune_windows (void)
 
 static gboolean term_died (VteTerminal *term, int status)
 {
+	PROBE ();
+
 	int n = -1, window_i = -1;
 
 	if (!term_find (GTK_WIDGET (term), &n)) {
@@ -536,6 +610,7 @@ static gboolean term_died (VteTerminal *term, int status)
 	}
 	window_i = terms.active[n].window;
 
+	TRACE ("died", n, status);
 	if (WIFEXITED (status)) {
 		infof ("Term %d exited.  Exit code: %d", n, WEXITSTATUS (status));
 	} else if (WIFSIGNALED (status)) {
@@ -584,8 +659,162 @@ static gboolean term_died (VteTerminal *term, int status)
 	return true;
 }
 
+/*
+ * Remember the child and the PTY of a freshly spawned terminal, so that the
+ * title, --list and switching by PTY name don't have to ask VTE and ptsname
+ * for them every time.
+ */
+static void term_pty_record (long n, GPid pid)
+{
+	VtePty *pty = vte_terminal_get_pty (VTE_TERMINAL (terms.active[n].term));
+	char	pts[sizeof (terms.active[n].pts) + 5];
+
+	terms.active[n].pid = pid;
+	if (pty == NULL) {
+		debugf ("pty not set for terminal %ld", n);
+		return;
+	}
+
+	terms.active[n].pty_fd = vte_pty_get_fd (pty);
+	if (ptsname_r (terms.active[n].pty_fd, pts, sizeof (pts))) {
+		errorf ("Unable to get the PTY name for terminal %ld: %s", n + 1, strerror (errno));
+		return;
+	}
+
+	strlcpy (terms.active[n].pts, g_str_has_prefix (pts, "/dev/") ? pts + 5 : pts, sizeof (terms.active[n].pts));
+
+	if (terms.pts_index == NULL) {
+		terms.pts_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	}
+	g_hash_table_insert (terms.pts_index, g_strdup (terms.active[n].pts), GINT_TO_POINTER (n + 1));
+}
+
+static void term_pty_forget (long n)
+{
+	if (terms.pts_index != NULL && terms.active[n].pts[0]) {
+		g_hash_table_remove (terms.pts_index, terms.active[n].pts);
+	}
+
+	terms.active[n].pid	   = 0;
+	terms.active[n].pty_fd = -1;
+	terms.active[n].pts[0] = '\0';
+}
+
+// Makes room for terms.n_active slots, the ones past old_n_active empty.
+void term_slots_grow (int old_n_active)
+{
+	terms.active = realloc (terms.active, terms.n_active * sizeof (*terms.active));
+	memset (&terms.active[old_n_active], 0, (terms.n_active - old_n_active) * sizeof (*terms.active));
+	for (int i = old_n_active; i < terms.n_active; i++) {
+		terms.active[i].pty_fd = -1;
+	}
+}
+
+/*
+ * The scrollback budget.
+ *
+ * With scrollback_budget set, the scrollback of all of the terminals together
+ * is held to that many lines.  Terminals on screen always get the full
+ * scrollback_lines, and the rest get what is left of the budget, most
+ * recently on screen first, so the ones which have been idle the longest are
+ * trimmed first.
+ *
+ * VTE throws away whatever no longer fits when the limit is lowered, raising
+ * it again later doesn't bring anything back.
+ */
+static guint scrollback_source = 0;
+
+static int scrollback_lru_cmp (const void *a, const void *b)
+{
+	gint64 a_time = terms.active[*(const int *) a].last_active;
+	gint64 b_time = terms.active[*(const int *) b].last_active;
+
+	return (a_time < b_time) - (a_time > b_time);
+}
+
+static gboolean scrollback_rebalance (gpointer data)
+{
+	PROBE ();
+
+	int	  *order	 = g_new (int, terms.n_active);
+	int	   n_order	 = 0;
+	glong  remaining = terms.scrollback_budget;
+	gint64 now		 = g_get_monotonic_time ();
+
+	scrollback_source = 0;
+
+	for (int i = 0; i < terms.n_active; i++) {
+		if (terms.active[i].term) {
+			if (gtk_widget_get_mapped (terms.active[i].term)) {
+				terms.active[i].last_active = now;
+			}
+			order[n_order++] = i;
+		}
+	}
+	qsort (order, n_order, sizeof (order[0]), scrollback_lru_cmp);
+
+	for (int i = 0; i < n_order; i++) {
+		term_instance_t *active = &terms.active[order[i]];
+		glong			 limit	= terms.scrollback_lines;
+
+		if (terms.scrollback_budget > 0) {
+			if (!gtk_widget_get_mapped (active->term)) {
+				// A negative scrollback_lines is unlimited, which is more than we have.
+				limit = limit < 0 ? remaining : MIN (limit, remaining);
+			}
+			remaining = MAX (0, remaining - MAX (0, limit));
+		}
+
+		if (limit != active->scrollback_limit) {
+			debugf ("Term %d scrollback %ld -> %ld lines, %ld in use.", order[i] + 1, active->scrollback_limit, limit,
+					term_scrollback_used (order[i]));
+			vte_terminal_set_scrollback_lines (VTE_TERMINAL (active->term), limit);
+			active->scrollback_limit = limit;
+		}
+	}
+
+	g_free (order);
+	return G_SOURCE_REMOVE;
+}
+
+static void scrollback_rebalance_queue (void)
+{
+	if (!scrollback_source) {
+		scrollback_source = g_idle_add_full (G_PRIORITY_LOW, scrollback_rebalance, NULL, NULL);
+	}
+}
+
+// Lines of scrollback the terminal is holding, from the scrollbar range.
+glong term_scrollback_used (int n)
+{
+	if (!terms.active[n].term) {
+		return 0;
+	}
+
+	GtkAdjustment *adj	= gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (terms.active[n].term));
+	double		   used = gtk_adjustment_get_upper (adj) - gtk_adjustment_get_lower (adj) - gtk_adjustment_get_page_size (adj);
+
+	return MAX (0, (glong) used);
+}
+
+// Lets go of what the terminal was started with, its generation's or our own copies.
+static void term_exec_free (term_instance_t *active)
+{
+	if (active->gen != NULL) {
+		config_gen_unref (active->gen);
+	} else {
+		g_strfreev (active->argv);
+		g_strfreev (active->env);
+	}
+	active->gen	 = NULL;
+	active->argv = NULL;
+	active->env	 = NULL;
+}
+
 static gboolean term_unrealized (VteTerminal *term, gpointer user_data)
 {
+	PROBE_ARGS ((long) user_data, -1);
+
 	int n = (long) user_data;
 
 	debugf ("Got unrealize for term %d.", n);
@@ -596,9 +825,17 @@ static gboolean term_unrealized (VteTerminal *term, gpointer user_data)
 
 	g_object_unref (G_OBJECT (term));
 
-	terms.active[n].spawned--;
-	terms.active[n].term = NULL;
+	if (terms.active[n].spawn_source) {
+		g_source_remove (terms.active[n].spawn_source);
+		terms.active[n].spawn_source = 0;
+	}
+	term_pty_forget (n);
+	term_exec_free (&terms.active[n]);
+	terms.active[n].spawn_state		= TERM_SPAWN_NONE;
+	terms.active[n].pending_changes = 0;
+	terms.active[n].term			= NULL;
 	terms.alive--;
+	scrollback_rebalance_queue ();
 
 	if (!terms.alive) {
 		debugf ("Attempting to exit...");
@@ -612,6 +849,8 @@ static gboolean term_unrealized (VteTerminal *term, gpointer user_data)
 
 void term_set_window (int n, int window_i)
 {
+	PROBE_ARGS (n, window_i);
+
 	GtkWidget *term = terms.active[n].term;
 
 	// Create a new window if we are passed a non-existent window.
@@ -650,12 +889,13 @@ void term_set_window (int n, int window_i)
 		}
 	}
 
-	if (terms.color_schemes[windows[window_i].color_scheme].name[0]) {
-		vte_terminal_set_colors (VTE_TERMINAL (term), &terms.color_schemes[windows[window_i].color_scheme].foreground,
-								 &terms.color_schemes[windows[window_i].color_scheme].background, &colors[0],
-								 MIN (256, sizeof (colors) / sizeof (colors[0])));
+	const config_gen_t	 *gen	 = config_gen;
+	const color_scheme_t *scheme = &gen->color_schemes[windows[window_i].color_scheme];
+	if (scheme->name[0]) {
+		vte_terminal_set_colors (VTE_TERMINAL (term), &scheme->foreground, &scheme->background, gen->colors,
+								 G_N_ELEMENTS (gen->colors));
 	} else {
-		vte_terminal_set_colors (VTE_TERMINAL (term), NULL, NULL, &colors[0], MIN (256, sizeof (colors) / sizeof (colors[0])));
+		vte_terminal_set_colors (VTE_TERMINAL (term), NULL, NULL, gen->colors, G_N_ELEMENTS (gen->colors));
 	}
 
 	int i = gtk_notebook_append_page (windows[window_i].notebook, term, NULL);
@@ -671,50 +911,220 @@ void term_set_window (int n, int window_i)
 	temu_reorder ();
 }
 
-void term_config (GtkWidget *term, int window_i)
+// Stolen from the VTE example app in the libvte source tree.
+// And then adapted to work a little better for some corner cases.
+static char const *const builtin_dingus[] = {
+  "(((gopher|news|telnet|nntp|file|http|ftp|https)://)|(www|ftp)[-A-Za-z0-9]*\\.)[-A-Za-z0-9\\.]+(:[0-9]*)?",
+  "(((gopher|news|telnet|nntp|file|http|ftp|https)://)|(www|ftp)[-A-Za-z0-9]*\\.)[-A-Za-z0-9\\.]+(:[0-9]*)?/"
+  "[-A-Za-z0-9_\\$\\.\\+\\!\\*\\(\\),;:@&=\\?/~\\#\\%]*"
+  "[-A-Za-z0-9_\\$\\+\\!\\*\\(;:@&=\\?/~\\#\\%]",
+  NULL,
+};
+
+static void match_regexes_add (GPtrArray *regexes, const char *pattern)
+{
+	GError	 *error = NULL;
+	VteRegex *regex =
+	  vte_regex_new_for_match (pattern, -1, PCRE2_NEVER_BACKSLASH_C | PCRE2_UTF | PCRE2_MULTILINE | PCRE2_CASELESS, &error);
+
+	if (regex == NULL) {
+		errorf ("Unable to compile match pattern '%s': %s", pattern, error->message);
+		g_error_free (error);
+		return;
+	}
+
+	// Not fatal, VTE will just fall back to the interpreter.
+	if (!vte_regex_jit (regex, PCRE2_JIT_COMPLETE, &error)) {
+		debugf ("Unable to JIT match pattern '%s': %s", pattern, error->message);
+		g_clear_error (&error);
+	}
+
+	g_ptr_array_add (regexes, regex);
+}
+
+/*
+ * The URL match regexes are the same for every terminal, so compile them
+ * once per config load rather than once per term_config call.
+ *
+ * Each terminal takes its own reference in vte_terminal_match_add_regex,
+ * so match_regexes_free can drop ours whenever the config changes.
+ */
+static GPtrArray *match_regexes_get (void)
+{
+	if (terms.match_regexes != NULL) {
+		return terms.match_regexes;
+	}
+
+	terms.match_regexes = g_ptr_array_new_with_free_func ((GDestroyNotify) vte_regex_unref);
+
+	for (int i = 0; builtin_dingus[i] != NULL; i++) {
+		match_regexes_add (terms.match_regexes, builtin_dingus[i]);
+	}
+
+	for (int i = 0; terms.match_patterns != NULL && terms.match_patterns[i] != NULL; i++) {
+		match_regexes_add (terms.match_regexes, terms.match_patterns[i]);
+	}
+
+	debugf ("Compiled %u match regexes.", terms.match_regexes->len);
+
+	return terms.match_regexes;
+}
+
+void match_regexes_free (void)
 {
+	if (terms.match_regexes != NULL) {
+		g_ptr_array_unref (terms.match_regexes);
+		terms.match_regexes = NULL;
+	}
+}
+
+/*
+ * The settings term_config_apply pushes to each terminal, as of the last
+ * time the live terminals were brought up to date.
+ *
+ * term_config_changed compares this against the current settings to work out
+ * what a reload or a preferences change actually needs to touch.
+ */
+typedef struct term_settings_s {
+	bool		   valid;
+	char		  *font;
+	gdouble		   font_scale;
+	char		  *word_char_exceptions;
+	bool		   audible_bell;
+	bool		   scroll_on_output;
+	bool		   scroll_on_keystroke;
+	bool		   bold_is_bright;
+	bool		   mouse_autohide;
+	glong		   scrollback_lines;
+	glong		   scrollback_budget;
+	char		 **match_patterns;
+	GdkRGBA		   colors[256];
+	color_scheme_t color_schemes[MAX_COLOR_SCHEMES];
+} term_settings_t;
+
+static term_settings_t term_settings;
+
+static void term_settings_free (term_settings_t *settings)
+{
+	g_free (settings->font);
+	g_free (settings->word_char_exceptions);
+	g_strfreev (settings->match_patterns);
+	memset (settings, 0, sizeof (*settings));
+}
+
+static void term_settings_snapshot (term_settings_t *settings)
+{
+	settings->valid				   = true;
+	settings->font				   = g_strdup (terms.font);
+	settings->font_scale		   = terms.font_scale;
+	settings->word_char_exceptions = g_strdup (terms.word_char_exceptions);
+	settings->audible_bell		   = terms.audible_bell;
+	settings->scroll_on_output	   = terms.scroll_on_output;
+	settings->scroll_on_keystroke  = terms.scroll_on_keystroke;
+	settings->bold_is_bright	   = terms.bold_is_bright;
+	settings->mouse_autohide	   = terms.mouse_autohide;
+	settings->scrollback_lines	   = terms.scrollback_lines;
+	settings->scrollback_budget	   = terms.scrollback_budget;
+	settings->match_patterns	   = g_strdupv (terms.match_patterns);
+	memcpy (settings->colors, config_gen->colors, sizeof (settings->colors));
+	memcpy (settings->color_schemes, config_gen->color_schemes, sizeof (settings->color_schemes));
+}
+
+static unsigned term_settings_diff (const term_settings_t *a, const term_settings_t *b)
+{
+	unsigned changes = 0;
+
+	if (!a->valid || !b->valid) {
+		return TERM_CHANGE_ALL;
+	}
+
+	if (g_strcmp0 (a->font, b->font)) {
+		changes |= TERM_CHANGE_FONT;
+	}
+	if (a->font_scale != b->font_scale) {
+		changes |= TERM_CHANGE_FONT_SCALE;
+	}
+	if (g_strcmp0 (a->word_char_exceptions, b->word_char_exceptions)) {
+		changes |= TERM_CHANGE_WORD_CHARS;
+	}
+	if (a->audible_bell != b->audible_bell || a->scroll_on_output != b->scroll_on_output ||
+		a->scroll_on_keystroke != b->scroll_on_keystroke || a->bold_is_bright != b->bold_is_bright ||
+		a->mouse_autohide != b->mouse_autohide) {
+		changes |= TERM_CHANGE_BEHAVIOR;
+	}
+	if (a->scrollback_lines != b->scrollback_lines || a->scrollback_budget != b->scrollback_budget) {
+		changes |= TERM_CHANGE_SCROLLBACK;
+	}
+	/*
+	 * The regex cache is rebuilt on every parse, but the terminals hold their
+	 * own references to the old regexes, which are just as good if the
+	 * patterns haven't changed.
+	 */
+	if ((a->match_patterns == NULL) != (b->match_patterns == NULL) ||
+		(a->match_patterns != NULL && !g_strv_equal ((const gchar *const *) a->match_patterns,
+													 (const gchar *const *) b->match_patterns))) {
+		changes |= TERM_CHANGE_MATCHES;
+	}
+	if (memcmp (a->colors, b->colors, sizeof (a->colors)) ||
+		memcmp (a->color_schemes, b->color_schemes, sizeof (a->color_schemes))) {
+		changes |= TERM_CHANGE_COLORS;
+	}
+
+	return changes;
+}
+
+static void term_config_fontconfig (void)
+{
+	PROBE ();
+
 	static bool manage_fc_timestamp = false;
 
-	if (terms.font) {
-		/*
-		 * This is all to workaround https://gitlab.gnome.org/GNOME/gtk/-/issues/7039
-		 *
-		 * The very short version: Check to see if gtk-fontconfig-timestamp has been set.
-		 *
-		 * If it has, we can pretend that gtk is going to do the right thing.
-		 *
-		 * It won't until the first bug described in the issue is fixed, but
-		 * that's not too hard for the to workaround. (Make a change, then make
-		 * another change.  The first change will then be picked up correctly.)
-		 *
-		 * If it has not been set, then we need to do it ourselves.
-		 *
-		 * Use a static variable to check if we are still managing it.
-		 *
-		 * NOTE: Sadly, just setting gtk-fontconfig-timestamp to different
-		 * values in sequence isn't enough.
-		 *
-		 * FcConfigUptoDate needs to show as false during both increments.
-		 *
-		 * Sadly, we don't really have any way to trigger that.
-		 *
-		 * Without talking to the fontconfig layer of pango ourselves, we don't
-		 * really have any good options here, except for the user to make a
-		 * fontconfig change, hit reload config settings, make a second change,
-		 * and then hit reload config settings again.
-		 */
-		int timestamp = 0;
-		g_object_get (gtk_settings_get_default (), "gtk-fontconfig-timestamp", &timestamp, NULL);
+	/*
+	 * This is all to workaround https://gitlab.gnome.org/GNOME/gtk/-/issues/7039
+	 *
+	 * The very short version: Check to see if gtk-fontconfig-timestamp has been set.
+	 *
+	 * If it has, we can pretend that gtk is going to do the right thing.
+	 *
+	 * It won't until the first bug described in the issue is fixed, but
+	 * that's not too hard for the to workaround. (Make a change, then make
+	 * another change.  The first change will then be picked up correctly.)
+	 *
+	 * If it has not been set, then we need to do it ourselves.
+	 *
+	 * Use a static variable to check if we are still managing it.
+	 *
+	 * NOTE: Sadly, just setting gtk-fontconfig-timestamp to different
+	 * values in sequence isn't enough.
+	 *
+	 * FcConfigUptoDate needs to show as false during both increments.
+	 *
+	 * Sadly, we don't really have any way to trigger that.
+	 *
+	 * Without talking to the fontconfig layer of pango ourselves, we don't
+	 * really have any good options here, except for the user to make a
+	 * fontconfig change, hit reload config settings, make a second change,
+	 * and then hit reload config settings again.
+	 */
+	int timestamp = 0;
+	g_object_get (gtk_settings_get_default (), "gtk-fontconfig-timestamp", &timestamp, NULL);
 
-		debugf ("gtk-fontconfig-timestamp: %d", timestamp);
+	debugf ("gtk-fontconfig-timestamp: %d", timestamp);
 
-		if (timestamp == 0 || manage_fc_timestamp) {
-			manage_fc_timestamp = true;
-			timestamp++;
+	if (timestamp == 0 || manage_fc_timestamp) {
+		manage_fc_timestamp = true;
+		timestamp++;
 
-			g_object_set (gtk_settings_get_default (), "gtk-fontconfig-timestamp", timestamp, NULL);
-		}
+		g_object_set (gtk_settings_get_default (), "gtk-fontconfig-timestamp", timestamp, NULL);
+	}
+}
 
+// Push the settings named by changes, a mask of term_change_t bits, to a single terminal.
+void term_config_apply (GtkWidget *term, int window_i, unsigned changes)
+{
+	debugf ("term: %p, window_i: %d, changes: 0x%x", term, window_i, changes);
+
+	if ((changes & TERM_CHANGE_FONT) && terms.font) {
 		PangoFontDescription *font = pango_font_description_from_string (terms.font);
 		if (font) {
 			vte_terminal_set_font (VTE_TERMINAL (term), font);
@@ -723,151 +1133,250 @@ void term_config (GtkWidget *term, int window_i)
 			errorf ("Unable to load font '%s'", terms.font);
 		}
 	}
-	if (terms.word_char_exceptions != NULL && terms.word_char_exceptions[0] != '\0') {
-		vte_terminal_set_word_char_exceptions (VTE_TERMINAL (term), terms.word_char_exceptions);
-	} else {
-		vte_terminal_set_word_char_exceptions (VTE_TERMINAL (term), "");
+	if (changes & TERM_CHANGE_WORD_CHARS) {
+		if (terms.word_char_exceptions != NULL && terms.word_char_exceptions[0] != '\0') {
+			vte_terminal_set_word_char_exceptions (VTE_TERMINAL (term), terms.word_char_exceptions);
+		} else {
+			vte_terminal_set_word_char_exceptions (VTE_TERMINAL (term), "");
+		}
 	}
-	vte_terminal_set_audible_bell (VTE_TERMINAL (term), terms.audible_bell);
-	vte_terminal_set_font_scale (VTE_TERMINAL (term), terms.font_scale);
-	vte_terminal_set_scroll_on_output (VTE_TERMINAL (term), terms.scroll_on_output);
-	vte_terminal_set_scroll_on_keystroke (VTE_TERMINAL (term), terms.scroll_on_keystroke);
-	vte_terminal_set_bold_is_bright (VTE_TERMINAL (term), terms.bold_is_bright);
+	if (changes & TERM_CHANGE_FONT_SCALE) {
+		vte_terminal_set_font_scale (VTE_TERMINAL (term), terms.font_scale);
+	}
+	if (changes & TERM_CHANGE_BEHAVIOR) {
+		vte_terminal_set_audible_bell (VTE_TERMINAL (term), terms.audible_bell);
+		vte_terminal_set_scroll_on_output (VTE_TERMINAL (term), terms.scroll_on_output);
+		vte_terminal_set_scroll_on_keystroke (VTE_TERMINAL (term), terms.scroll_on_keystroke);
+		vte_terminal_set_bold_is_bright (VTE_TERMINAL (term), terms.bold_is_bright);
+		vte_terminal_set_mouse_autohide (VTE_TERMINAL (term), terms.mouse_autohide);
+	}
+	if (changes & TERM_CHANGE_SCROLLBACK) {
+		int n;
+
+		vte_terminal_set_scrollback_lines (VTE_TERMINAL (term), terms.scrollback_lines);
+		if (term_find (term, &n)) {
+			terms.active[n].scrollback_limit = terms.scrollback_lines;
+		}
+	}
+
+	if (changes & TERM_CHANGE_MATCHES) {
+		GPtrArray *regexes = match_regexes_get ();
+
+		vte_terminal_match_remove_all (VTE_TERMINAL (term));
+		for (guint i = 0; i < regexes->len; i++) {
+			int ret = vte_terminal_match_add_regex (VTE_TERMINAL (term), g_ptr_array_index (regexes, i), 0);
+			debugf ("regex: %p, ret: %d", g_ptr_array_index (regexes, i), ret);
+		}
+	}
+
+	if (changes & TERM_CHANGE_COLORS) {
+		const config_gen_t	 *gen	 = config_gen;
+		const color_scheme_t *scheme = &gen->color_schemes[windows[window_i].color_scheme];
+		if (scheme->name[0]) {
+			vte_terminal_set_colors (VTE_TERMINAL (term), &scheme->foreground, &scheme->background, gen->colors,
+									 G_N_ELEMENTS (gen->colors));
+		} else {
+			vte_terminal_set_colors (VTE_TERMINAL (term), NULL, NULL, gen->colors, G_N_ELEMENTS (gen->colors));
+		}
+	}
+
+	if (changes & (TERM_CHANGE_FONT | TERM_CHANGE_FONT_SCALE)) {
+		char_width	= vte_terminal_get_char_width (VTE_TERMINAL (term));
+		char_height = vte_terminal_get_char_height (VTE_TERMINAL (term));
+		debugf ("setting terminal size requests: %dx%d", char_width * 2, char_height * 2);
+		gtk_widget_set_size_request (term, char_width * 2, char_height * 2);
+	}
+}
+
+// Full configuration, for a freshly created terminal.
+void term_config (GtkWidget *term, int window_i)
+{
+	PROBE_ARGS (-1, window_i);
+
+	if (!term_settings.valid) {
+		term_settings_snapshot (&term_settings);
+	}
+
+	if (terms.font) {
+		term_config_fontconfig ();
+	}
+
 	vte_terminal_set_cursor_blink_mode (VTE_TERMINAL (term), VTE_CURSOR_BLINK_OFF);
 	vte_terminal_set_cursor_shape (VTE_TERMINAL (term), VTE_CURSOR_SHAPE_BLOCK);
-	vte_terminal_set_scrollback_lines (VTE_TERMINAL (term), terms.scrollback_lines);
-	vte_terminal_set_mouse_autohide (VTE_TERMINAL (term), terms.mouse_autohide);
 	vte_terminal_set_enable_sixel (VTE_TERMINAL (term), true);
 	vte_terminal_set_allow_hyperlink (VTE_TERMINAL (term), true);
 #if VTE_CHECK_VERSION(0, 77, 0)
 	vte_terminal_set_enable_legacy_osc777 (VTE_TERMINAL (term), true);
 #endif
 
-	// FIXME: Should this be in the config?
-	// Stolen from the VTE example app in the libvte source tree.
-	// And then adapted to work a little better for some corner cases.
-	static char const *const builtin_dingus[] = {
-	  "(((gopher|news|telnet|nntp|file|http|ftp|https)://)|(www|ftp)[-A-Za-z0-9]*\\.)[-A-Za-z0-9\\.]+(:[0-9]*)?",
-	  "(((gopher|news|telnet|nntp|file|http|ftp|https)://)|(www|ftp)[-A-Za-z0-9]*\\.)[-A-Za-z0-9\\.]+(:[0-9]*)?/"
-	  "[-A-Za-z0-9_\\$\\.\\+\\!\\*\\(\\),;:@&=\\?/~\\#\\%]*"
-	  "[-A-Za-z0-9_\\$\\+\\!\\*\\(;:@&=\\?/~\\#\\%]",
-	  NULL,
-	};
-
-	vte_terminal_match_remove_all (VTE_TERMINAL (term));
-	for (int i = 0; builtin_dingus[i] != NULL; i++) {
-		const char *pattern = builtin_dingus[i];
-		VteRegex   *regex =
-		  vte_regex_new_for_match (pattern, -1, PCRE2_NEVER_BACKSLASH_C | PCRE2_UTF | PCRE2_MULTILINE | PCRE2_CASELESS, NULL);
-		if (regex) {
-			int ret = vte_terminal_match_add_regex (VTE_TERMINAL (term), regex, 0);
-			debugf ("regex: %p, ret: %d", regex, ret);
-		} else {
-			debugf ("regex failed to compile '%s', we should add error handling.", pattern);
-		}
-		vte_regex_unref (regex);
+	term_config_apply (term, window_i, TERM_CHANGE_ALL);
+}
+
+/*
+ * Called after the settings in terms have been changed, by a reload or by
+ * the preferences dialog.
+ *
+ * Only what actually changed is pushed out.  Terminals which are on screen
+ * get it right away, everything else has it batched up in pending_changes
+ * until term_map.  The exception is refresh_font, for the user asking for a
+ * reload, as changing fontconfig and reloading is how they get a font change
+ * picked up, see term_config_fontconfig.
+ */
+void term_config_changed (bool refresh_font)
+{
+	PROBE ();
+
+	term_settings_t settings = {0};
+
+	term_settings_snapshot (&settings);
+	unsigned changes = term_settings_diff (&term_settings, &settings);
+	term_settings_free (&term_settings);
+	term_settings = settings;
+
+	if (refresh_font && terms.font) {
+		changes |= TERM_CHANGE_FONT;
 	}
 
-	if (terms.color_schemes[windows[window_i].color_scheme].name[0]) {
-		vte_terminal_set_colors (VTE_TERMINAL (term), &terms.color_schemes[windows[window_i].color_scheme].foreground,
-								 &terms.color_schemes[windows[window_i].color_scheme].background, &colors[0],
-								 MIN (256, sizeof (colors) / sizeof (colors[0])));
-	} else {
-		vte_terminal_set_colors (VTE_TERMINAL (term), NULL, NULL, &colors[0], MIN (256, sizeof (colors) / sizeof (colors[0])));
+	debugf ("changes: 0x%x", changes);
+	if (!changes) {
+		return;
+	}
+
+	if ((changes & TERM_CHANGE_FONT) && terms.font) {
+		term_config_fontconfig ();
+	}
+
+	if (changes & TERM_CHANGE_SCROLLBACK) {
+		scrollback_rebalance_queue ();
 	}
 
-	char_width	= vte_terminal_get_char_width (VTE_TERMINAL (term));
-	char_height = vte_terminal_get_char_height (VTE_TERMINAL (term));
-	debugf ("setting terminal size requests: %dx%d", char_width * 2, char_height * 2);
 	for (int i = 0; i < terms.n_active; i++) {
-		if (terms.active[i].term != NULL) {
-			gtk_widget_set_size_request (term, char_width * 2, char_height * 2);
+		if (!terms.active[i].term) {
+			continue;
+		}
+
+		if (gtk_widget_get_mapped (terms.active[i].term)) {
+			term_config_apply (terms.active[i].term, terms.active[i].window, changes | terms.active[i].pending_changes);
+			terms.active[i].pending_changes = 0;
+		} else {
+			terms.active[i].pending_changes |= changes;
 		}
 	}
 
-	/*
-	debugf ("setting size request: %dx%d", char_width * 2, char_height * 2);
-	gtk_widget_set_size_request (windows[window_i].window, char_width * 2, char_height * 2);
-	*/
+	term_pool_config (changes);
+}
+
+// Terminal n has its child running, whether spawned for it or adopted from the pool with one.
+static void term_spawned (long n, GPid pid, const char *how)
+{
+	terms.active[n].spawn_state = TERM_SPAWN_RUNNING;
+	term_pty_record (n, pid);
+	startup_mark ("child running");
+	startup_spawned = true;
+	infof ("Term %ld %s pid %d on %s, %.1f ms after it was requested.", n + 1, how, pid, terms.active[n].pts,
+		   (g_get_monotonic_time () - terms.active[n].spawn_requested) / 1000.0);
 }
 
 static void spawn_callback (VteTerminal *term, GPid pid, GError *error, gpointer user_data)
 {
-	debugf ("term: %p, pid: %d, error: %p, user_data: %p", term, pid, error, user_data);
+	PROBE_ARGS ((long) user_data, -1);
+
+	long n = (long) user_data;
+
+	TRACE ("spawned", n, pid);
+	debugf ("term: %p, pid: %d, error: %p, n: %ld", term, pid, error, n);
 	if (error != NULL) {
 		errorf ("error: domain: 0x%x, code: 0x%x, message: %s", error->domain, error->code, error->message);
-		term_died (term, -1); // This is a horrible hack.
+		startup_finish_queue (); // No first terminal to wait on.
+		term_died (term, -1);	 // This is a horrible hack.
+		return;
+	}
+
+	if (terms.active[n].term == GTK_WIDGET (term)) {
+		term_spawned (n, pid, "spawned");
+
+		// The title has the PTY name in it, which we didn't have until now.
+		temu_window_title_change (term, n);
 	}
 }
 
+/*
+ * Called once, from an idle queued by term_realized.
+ *
+ * We spawn from an idle rather than directly from the realize handler so that
+ * term_switch has finished with term_config first, and the child starts with
+ * the right font and size.
+ */
 static gboolean term_spawn (gpointer data)
 {
-	int n		 = (long int) data;
-	int realized = gtk_widget_get_realized (terms.active[n].term);
+	PROBE_ARGS ((long) data, -1);
 
-	debugf ("For terminal %d, spawned: %d, realized: %d.", n, terms.active[n].spawned, realized);
+	long			 n		= (long) data;
 	term_instance_t *active = &terms.active[n];
+
+	active->spawn_source = 0;
+
+	debugf ("For terminal %ld, spawn_state: %d.", n, active->spawn_state);
 	if (active->argv != NULL) {
 		for (int i = 0; active->argv[i] != NULL; i++) {
 			debugf ("  argv[%d]: '%s'", i, active->argv[i]);
 		}
 	}
 
-	if (!realized) {
-		return true;
-	}
-
-	if (!active->spawned) {
-		char **env = environ;
-		if (active->env != NULL) {
-			env = active->env;
-		}
-
-		if (active->argv && active->argv[0] != NULL && active->argv[1] == NULL) {
-			int argc = 0;
-			for (int i = 0; active->argv != NULL && active->argv[i] != NULL; i++) {
-				argc++;
-			}
-			char **argv = g_new0 (char *, 4 + argc);
-			argv[0]		= "/bin/sh";
-			argv[1]		= "-c";
-			debugf ("Spawning '%s' '%s' '%s' '%s'...", argv[0], argv[1], argv[2], argv[3]);
-			for (int i = 0; i < argc; i++) {
-				argv[2 + i] = active->argv[i];
-			}
-			for (int i = 0; argv[i] != NULL; i++) {
-				debugf ("  argv[%d]: '%s'", i, argv[i]);
-			}
-			vte_terminal_spawn_async (VTE_TERMINAL (active->term), VTE_PTY_DEFAULT, NULL, argv, env, G_SPAWN_DEFAULT, NULL, NULL,
-									  NULL, -1, NULL, spawn_callback, NULL);
-			g_free (argv);
-		} else if (active->argv != NULL && active->argv[0] != NULL) {
-			debugf ("Spawning with: %p '%s'", active->argv, active->argv[0]);
-			for (int i = 0; active->argv[i] != NULL; i++) {
-				debugf ("argv[%d]: '%s'", i, active->argv[i]);
-			}
-			vte_terminal_spawn_async (VTE_TERMINAL (active->term), VTE_PTY_DEFAULT, NULL, active->argv, env, G_SPAWN_DEFAULT,
-									  NULL, NULL, NULL, -1, NULL, spawn_callback, NULL);
+	if (active->spawn_state != TERM_SPAWN_QUEUED) {
+		return G_SOURCE_REMOVE;
+	}
 
-		} else {
-			struct passwd *pass = getpwuid (getuid ());
+	// Unrealized while we were queued, we'll be queued again when it is realized again.
+	if (!gtk_widget_get_realized (active->term)) {
+		active->spawn_state = TERM_SPAWN_WAITING;
+		return G_SOURCE_REMOVE;
+	}
 
-			char *argv[] = {pass->pw_shell, "--login", NULL};
-			debugf ("term: %p, shell: '%s'", VTE_TERMINAL (active->term), pass->pw_shell);
-			debugf ("Spawning with args: %s %s", argv[0], argv[1]);
-			vte_terminal_spawn_async (VTE_TERMINAL (active->term), VTE_PTY_DEFAULT, NULL, argv, env, G_SPAWN_DEFAULT, NULL, NULL,
-									  NULL, 5000, NULL, spawn_callback, NULL);
-		}
+	char **env = config_gen->envp;
+	if (active->env != NULL) {
+		env = active->env;
+	}
 
-		active->spawned++;
+	if (active->argv && active->argv[0] != NULL && active->argv[1] == NULL) {
+		int argc = 0;
+		for (int i = 0; active->argv != NULL && active->argv[i] != NULL; i++) {
+			argc++;
+		}
+		char **argv = g_new0 (char *, 4 + argc);
+		argv[0]		= "/bin/sh";
+		argv[1]		= "-c";
+		debugf ("Spawning '%s' '%s' '%s' '%s'...", argv[0], argv[1], argv[2], argv[3]);
+		for (int i = 0; i < argc; i++) {
+			argv[2 + i] = active->argv[i];
+		}
+		for (int i = 0; argv[i] != NULL; i++) {
+			debugf ("  argv[%d]: '%s'", i, argv[i]);
+		}
+		spawn_async (VTE_TERMINAL (active->term), NULL, argv, env, -1, spawn_callback, (void *) n);
+		g_free (argv);
+	} else if (active->argv != NULL && active->argv[0] != NULL) {
+		debugf ("Spawning with: %p '%s'", active->argv, active->argv[0]);
+		for (int i = 0; active->argv[i] != NULL; i++) {
+			debugf ("argv[%d]: '%s'", i, active->argv[i]);
+		}
+		spawn_async (VTE_TERMINAL (active->term), NULL, active->argv, env, -1, spawn_callback, (void *) n);
 
-		// Workaround a bug where the cursor may not be drawn when we first switch to a new terminal.
-		vte_terminal_set_cursor_blink_mode (VTE_TERMINAL (active->term), VTE_CURSOR_BLINK_ON);
-		vte_terminal_set_cursor_blink_mode (VTE_TERMINAL (active->term), VTE_CURSOR_BLINK_OFF);
-		return false;
+	} else {
+		char *argv[] = {config_gen->shell, "--login", NULL};
+		debugf ("term: %p, shell: '%s'", VTE_TERMINAL (active->term), config_gen->shell);
+		debugf ("Spawning with args: %s %s", argv[0], argv[1]);
+		spawn_async (VTE_TERMINAL (active->term), config_gen->home, argv, env, 5000, spawn_callback, (void *) n);
 	}
 
-	return true;
+	active->spawn_state = TERM_SPAWN_STARTED;
+	startup_mark ("spawn");
+
+	// Workaround a bug where the cursor may not be drawn when we first switch to a new terminal.
+	vte_terminal_set_cursor_blink_mode (VTE_TERMINAL (active->term), VTE_CURSOR_BLINK_ON);
+	vte_terminal_set_cursor_blink_mode (VTE_TERMINAL (active->term), VTE_CURSOR_BLINK_OFF);
+
+	return G_SOURCE_REMOVE;
 }
 
 static void term_show (GtkWidget *widget, void *data)
@@ -893,13 +1402,22 @@ static void term_realized (GtkWidget *widget, void *data)
 		debugf ("Realized for terminal %d, no command.", n);
 	}
 
-	if (!active->spawned) {
-		g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, &term_spawn, data, NULL);
+	/*
+	 * Normally the spawn waits for the first frame with the terminal in it,
+	 * with fast_start the first terminal's child starts up while GTK is
+	 * still laying out and painting the window.
+	 */
+	if (active->spawn_state == TERM_SPAWN_WAITING) {
+		active->spawn_state	 = TERM_SPAWN_QUEUED;
+		active->spawn_source = g_idle_add_full (startup_defer ? G_PRIORITY_HIGH_IDLE : G_PRIORITY_DEFAULT_IDLE, &term_spawn,
+												data, NULL);
 	}
 }
 
 static void term_map (GtkWidget *widget, void *data)
 {
+	PROBE_ARGS ((long) data, -1);
+
 	int				 n		= (long int) data;
 	term_instance_t *active = &terms.active[n];
 
@@ -908,6 +1426,11 @@ static void term_map (GtkWidget *widget, void *data)
 	} else {
 		debugf ("Mapped for terminal %d, no command.", n);
 	}
+
+	if (active->pending_changes) {
+		term_config_apply (widget, active->window, active->pending_changes);
+		active->pending_changes = 0;
+	}
 }
 
 static void term_hover_uri_changed (VteTerminal *term, gchar *uri, GdkRectangle *bound_box, gpointer user_data)
@@ -965,7 +1488,7 @@ static gboolean term_setup_context_menu (VteTerminal *term, VteEventContext *con
 	}
 
 	vte_event_context_get_coordinates (context, &window->menu_x, &window->menu_y);
-	if (terms.active[n].hyperlink_uri) {
+	if (n >= 0 && terms.active[n].hyperlink_uri) {
 		window->menu_hyperlink_uri = strdup (terms.active[n].hyperlink_uri);
 		debugf ("Setting menu hyperlink uri: %s", window->menu_hyperlink_uri);
 	}
@@ -1057,6 +1580,7 @@ static gboolean term_termprops_changed (VteTerminal *term, int const *props, int
 	VtePropertyType	 type;
 	VtePropertyFlags flags;
 
+	TRACE ("termprops", n, n_props);
 	debugf ("%d termprops changed on term %ld.", n_props, n);
 	for (int i = 0; i < n_props; i++) {
 		if (vte_query_termprop_by_id (props[i], &name, &type, &flags)) {
@@ -1069,57 +1593,343 @@ static gboolean term_termprops_changed (VteTerminal *term, int const *props, int
 }
 #endif
 
-void term_switch (long n, char **argv, char **env, int window_i)
+static GtkWidget *term_new (void)
+{
+	GtkWidget *term = vte_terminal_new ();
+
+	gtk_widget_set_visible (term, true);
+	gtk_widget_set_hexpand (term, true);
+	gtk_widget_set_vexpand (term, true);
+
+	return term;
+}
+
+static void term_connect_signals (GtkWidget *term, long n)
+{
+	g_object_set_qdata (G_OBJECT (term), term_slot_quark (), GINT_TO_POINTER (n + 1));
+
+	g_signal_connect_after (G_OBJECT (term), "child-exited", G_CALLBACK (term_died), (void *) n);
+	g_signal_connect_after (G_OBJECT (term), "unrealize", G_CALLBACK (term_unrealized), (void *) n);
+	g_signal_connect (G_OBJECT (term), "window_title_changed", G_CALLBACK (temu_window_title_changed), (void *) n);
+	g_signal_connect_after (G_OBJECT (term), "realize", G_CALLBACK (term_realized), (void *) n);
+	g_signal_connect_after (G_OBJECT (term), "show", G_CALLBACK (term_show), (void *) n);
+	g_signal_connect_after (G_OBJECT (term), "map", G_CALLBACK (term_map), (void *) n);
+	g_signal_connect_after (G_OBJECT (term), "hyperlink_hover_uri_changed", G_CALLBACK (term_hover_uri_changed), (void *) n);
+	g_signal_connect_after (G_OBJECT (term), "resize_window", G_CALLBACK (term_resize_window), (void *) n);
+	g_signal_connect_after (G_OBJECT (term), "increase_font_size", G_CALLBACK (term_increase_font_size), (void *) n);
+	g_signal_connect_after (G_OBJECT (term), "decrease_font_size", G_CALLBACK (term_decrease_font_size), (void *) n);
+	g_signal_connect (G_OBJECT (term), "setup_context_menu", G_CALLBACK (term_setup_context_menu), (void *) n);
+#if VTE_CHECK_VERSION(0, 77, 0)
+	g_signal_connect (G_OBJECT (term), "termprops_changed", G_CALLBACK (term_termprops_changed), (void *) n);
+#endif
+	latency_connect (term, n);
+	if (G_UNLIKELY (startup_profile)) {
+		g_signal_connect (G_OBJECT (term), "contents_changed", G_CALLBACK (startup_first_output), NULL);
+	}
+}
+
+/*
+ * Pre-warmed terminals.
+ *
+ * Building a VteTerminal and running term_config on it (font, regexes,
+ * palette) is most of the cost of the first switch to an unopened slot.  So
+ * we keep up to terms.pool_size of them built ahead of time, at idle, for
+ * term_switch to adopt.
+ *
+ * With terms.pool_prespawn, each one also gets a login shell spawned into it
+ * while it sits in the pool.  Those can only be adopted by slots that would
+ * have spawned the default login shell anyway, and only while the shell, home
+ * directory and environment are still what they were started with.
+ */
+#define MAX_TERM_POOL 16
+
+typedef struct pool_term_s {
+	GtkWidget		  *term;
+	term_spawn_state_t spawn_state;
+	unsigned		   pending_changes; // Passed on to the slot that adopts us.
+	GPid			   pid;				// Prespawned login shell, if any.
+	config_gen_t	  *gen;				// What it was spawned from.
+} pool_term_t;
+
+static pool_term_t term_pool[MAX_TERM_POOL];
+static int		   term_pool_n		= 0;
+static guint	   term_pool_source = 0;
+
+static int term_pool_find (VteTerminal *term)
+{
+	for (int i = 0; i < term_pool_n; i++) {
+		if (term_pool[i].term == GTK_WIDGET (term)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static GtkWidget *term_pool_remove (int i, term_spawn_state_t *spawn_state, unsigned *pending_changes, GPid *pid)
+{
+	GtkWidget *term = term_pool[i].term;
+
+	if (pid != NULL) {
+		*pid = term_pool[i].pid;
+	}
+
+	if (spawn_state != NULL) {
+		*spawn_state = term_pool[i].spawn_state;
+	}
+	if (pending_changes != NULL) {
+		*pending_changes = term_pool[i].pending_changes;
+	}
+	config_gen_unref (term_pool[i].gen);
+
+	term_pool_n--;
+	memmove (&term_pool[i], &term_pool[i + 1], (term_pool_n - i) * sizeof (term_pool[0]));
+
+	return term;
+}
+
+static gboolean term_pool_died (VteTerminal *term, int status, gpointer user_data)
+{
+	int i = term_pool_find (term);
+
+	debugf ("Pooled terminal %p exited, status %d, pool index %d.", term, status, i);
+	if (i >= 0) {
+		g_object_unref (G_OBJECT (term_pool_remove (i, NULL, NULL, NULL)));
+		term_pool_refill ();
+	}
+
+	return true;
+}
+
+static void term_pool_spawn_callback (VteTerminal *term, GPid pid, GError *error, gpointer user_data)
+{
+	int i = term_pool_find (term);
+
+	if (i < 0) {
+		return;
+	}
+
+	if (error != NULL) {
+		errorf ("Unable to spawn pooled terminal: domain: 0x%x, code: 0x%x, message: %s", error->domain, error->code,
+				error->message);
+		// Don't refill here, or a broken shell would have us spawning in a loop.
+		g_object_unref (G_OBJECT (term_pool_remove (i, NULL, NULL, NULL)));
+		return;
+	}
+
+	debugf ("Pooled terminal %p running pid %d.", term, pid);
+	term_pool[i].spawn_state = TERM_SPAWN_RUNNING;
+	term_pool[i].pid		 = pid;
+}
+
+static gboolean term_pool_fill (gpointer data)
+{
+	PROBE ();
+
+	int size = CLAMP (terms.pool_size, 0, MAX_TERM_POOL);
+
+	while (term_pool_n > size) {
+		g_object_unref (G_OBJECT (term_pool_remove (term_pool_n - 1, NULL, NULL, NULL)));
+	}
+
+	if (term_pool_n >= size) {
+		term_pool_source = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	// One terminal per idle, so that we never hold up the main loop for long.
+	GtkWidget	*term  = term_new ();
+	pool_term_t *entry = &term_pool[term_pool_n++];
+
+	g_object_ref_sink (G_OBJECT (term));
+	entry->term			   = term;
+	entry->spawn_state	   = TERM_SPAWN_WAITING;
+	entry->pending_changes = 0;
+	entry->pid			   = 0;
+	entry->gen			   = NULL;
+
+	term_config (term, 0);
+
+	if (terms.pool_prespawn) {
+		char *argv[] = {config_gen->shell, "--login", NULL};
+
+		g_signal_connect_after (G_OBJECT (term), "child-exited", G_CALLBACK (term_pool_died), NULL);
+		entry->spawn_state = TERM_SPAWN_STARTED;
+		entry->gen		   = config_gen_ref (config_gen);
+		spawn_async (VTE_TERMINAL (term), config_gen->home, argv, config_gen->envp, 5000, term_pool_spawn_callback, NULL);
+	}
+
+	debugf ("Pooled terminal %d of %d: %p", term_pool_n, size, term);
+
+	return G_SOURCE_CONTINUE;
+}
+
+void term_pool_refill (void)
+{
+	if (!term_pool_source && (term_pool_n != CLAMP (terms.pool_size, 0, MAX_TERM_POOL))) {
+		term_pool_source = g_idle_add_full (G_PRIORITY_LOW, term_pool_fill, NULL, NULL);
+	}
+}
+
+// Whether pooled terminal i has a shell that a slot spawning one now wouldn't start the same way.
+static bool term_pool_stale (int i)
+{
+	const config_gen_t *gen = term_pool[i].gen;
+
+	if (term_pool[i].spawn_state == TERM_SPAWN_WAITING) {
+		return false;
+	}
+	if (!terms.pool_prespawn || gen == NULL) {
+		return true;
+	}
+
+	return gen != config_gen && (g_strcmp0 (gen->shell, config_gen->shell) || g_strcmp0 (gen->home, config_gen->home) ||
+								 !g_strv_equal ((const gchar *const *) gen->envp, (const gchar *const *) config_gen->envp));
+}
+
+/*
+ * Drops the pooled shells which were started with a different shell, home
+ * directory or environment, or since pool_prespawn was turned off, and has
+ * the pool refilled.
+ */
+void term_pool_drain (void)
+{
+	bool dropped = false;
+
+	for (int i = term_pool_n - 1; i >= 0; i--) {
+		if (term_pool_stale (i)) {
+			debugf ("Dropping pooled terminal %p, its shell is out of date.", term_pool[i].term);
+			g_object_unref (G_OBJECT (term_pool_remove (i, NULL, NULL, NULL)));
+			dropped = true;
+		}
+	}
+
+	if (dropped) {
+		term_pool_refill ();
+	}
+}
+
+// Pooled terminals are never on screen, so their config changes always wait for adoption.
+void term_pool_config (unsigned changes)
+{
+	for (int i = 0; i < term_pool_n; i++) {
+		term_pool[i].pending_changes |= changes;
+	}
+}
+
+void term_pool_free (void)
+{
+	if (term_pool_source) {
+		g_source_remove (term_pool_source);
+		term_pool_source = 0;
+	}
+
+	while (term_pool_n > 0) {
+		g_object_unref (G_OBJECT (term_pool_remove (term_pool_n - 1, NULL, NULL, NULL)));
+	}
+}
+
+/*
+ * Hand out a pooled terminal for a new slot, if we have a suitable one.
+ *
+ * Returns the spawn state of the terminal in spawn_state, which is
+ * TERM_SPAWN_RUNNING for a prespawned login shell with its pid in pid, and
+ * any config changes it has missed while pooled in pending_changes.
+ */
+static GtkWidget *term_pool_take (bool default_shell, term_spawn_state_t *spawn_state, unsigned *pending_changes, GPid *pid)
+{
+	// The user's shell or home directory can change without a reload, see config_load_apply.
+	term_pool_drain ();
+
+	for (int i = 0; i < term_pool_n; i++) {
+		if (term_pool[i].spawn_state == TERM_SPAWN_WAITING ||
+			(default_shell && term_pool[i].spawn_state == TERM_SPAWN_RUNNING)) {
+			GtkWidget *term = term_pool_remove (i, spawn_state, pending_changes, pid);
+
+			g_signal_handlers_disconnect_by_func (G_OBJECT (term), G_CALLBACK (term_pool_died), NULL);
+			term_pool_refill ();
+
+			return term;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Switch to terminal n, starting it with argv and env if it isn't running.
+ * With gen, they're a binding's from that generation and are kept as they
+ * are, along with a reference to it, otherwise they're copied, with env set in
+ * the current generation's envp.
+ */
+void term_switch (long n, char **argv, char **env, config_gen_t *gen, int window_i)
 {
+	PROBE_ARGS (n, window_i);
+
 	if (n >= terms.n_active) {
 		errorf ("ERROR!  Attempting to switch to term %ld, while terms.n_active is %d.", n, terms.n_active);
 		return;
 	}
 
+	TRACE ("switch", n, window_i);
 	if (!terms.active[n].term) {
-		GtkWidget *term;
-
-		term = vte_terminal_new ();
-		g_object_ref (G_OBJECT (term));
-		gtk_widget_set_visible (term, true);
-		gtk_widget_set_hexpand (term, true);
-		gtk_widget_set_vexpand (term, true);
-
-		g_signal_connect_after (G_OBJECT (term), "child-exited", G_CALLBACK (term_died), (void *) n);
-		g_signal_connect_after (G_OBJECT (term), "unrealize", G_CALLBACK (term_unrealized), (void *) n);
-		g_signal_connect (G_OBJECT (term), "window_title_changed", G_CALLBACK (temu_window_title_changed), (void *) n);
-		g_signal_connect_after (G_OBJECT (term), "realize", G_CALLBACK (term_realized), (void *) n);
-		g_signal_connect_after (G_OBJECT (term), "show", G_CALLBACK (term_show), (void *) n);
-		g_signal_connect_after (G_OBJECT (term), "map", G_CALLBACK (term_map), (void *) n);
-		g_signal_connect_after (G_OBJECT (term), "hyperlink_hover_uri_changed", G_CALLBACK (term_hover_uri_changed), (void *) n);
-		g_signal_connect_after (G_OBJECT (term), "resize_window", G_CALLBACK (term_resize_window), (void *) n);
-		g_signal_connect_after (G_OBJECT (term), "increase_font_size", G_CALLBACK (term_increase_font_size), (void *) n);
-		g_signal_connect_after (G_OBJECT (term), "decrease_font_size", G_CALLBACK (term_decrease_font_size), (void *) n);
-		g_signal_connect (G_OBJECT (term), "setup_context_menu", G_CALLBACK (term_setup_context_menu), (void *) n);
-#if VTE_CHECK_VERSION(0, 77, 0)
-		g_signal_connect (G_OBJECT (term), "termprops_changed", G_CALLBACK (term_termprops_changed), (void *) n);
-#endif
-
-		if (argv != NULL) {
-			terms.active[n].argv = g_strdupv ((gchar **) argv);
+		term_spawn_state_t spawn_state	   = TERM_SPAWN_WAITING;
+		unsigned		   pending_changes = 0;
+		GPid			   pid			   = 0;
+		GtkWidget		  *term			   = term_pool_take (argv == NULL && env == NULL, &spawn_state, &pending_changes, &pid);
+		bool			   pooled		   = term != NULL;
+
+		if (pooled) {
+			debugf ("Adopting pooled terminal %p for term %ld, spawn_state: %d.", term, n, spawn_state);
 		} else {
-			terms.active[n].argv = NULL;
+			term = term_new ();
+			g_object_ref (G_OBJECT (term));
 		}
-		if (env != NULL) {
-			terms.active[n].env = g_strdupv (env);
+
+		term_connect_signals (term, n);
+
+		if (gen != NULL) {
+			terms.active[n].gen	 = config_gen_ref (gen);
+			terms.active[n].argv = argv;
+			terms.active[n].env	 = env;
 		} else {
-			terms.active[n].env = NULL;
+			char **layer = env != NULL ? config_envp_layer (config_gen->envp, env) : NULL;
+
+			terms.active[n].gen	 = NULL;
+			terms.active[n].argv = g_strdupv (argv);
+			terms.active[n].env	 = g_strdupv (layer);
+			g_free (layer);
 		}
-		terms.active[n].term = term;
+		terms.active[n].term			 = term;
+		terms.active[n].spawn_state		 = spawn_state;
+		terms.active[n].spawn_requested	 = g_get_monotonic_time ();
+		terms.active[n].pending_changes	 = pending_changes;
+		terms.active[n].last_active		 = terms.active[n].spawn_requested;
+		terms.active[n].scrollback_limit = terms.scrollback_lines;
 		terms.alive++;
+		scrollback_rebalance_queue ();
+
+		if (spawn_state == TERM_SPAWN_RUNNING) {
+			term_spawned (n, pid, "adopted prespawned");
+		}
 
 		term_set_window (n, window_i);
 
-		term_config (term, window_i);
+		/*
+		 * Pooled terminals are already configured, and term_set_window has
+		 * set the colors for this window.  Anything that changed since is in
+		 * pending_changes, for term_map.
+		 */
+		if (!pooled) {
+			term_config (term, window_i);
+		}
 
 		gtk_window_present (GTK_WINDOW (windows[window_i].window));
 
-		rebuild_term_list (window_i);
+		if (!startup_defer) {
+			rebuild_term_list (window_i);
+		}
+		startup_mark ("terminal");
 	}
 
 	if (window_i != terms.active[n].window) {
@@ -1139,6 +1949,8 @@ void term_switch (long n, char **argv, char **env, int window_i)
 */
 static void term_switch_page (GtkNotebook *notebook, GtkWidget *page, gint page_num, gpointer user_data)
 {
+	PROBE ();
+
 	VteTerminal *term;
 	int			 i;
 
@@ -1147,6 +1959,12 @@ static void term_switch_page (GtkNotebook *notebook, GtkWidget *page, gint page_
 	debugf ("page_num: %d, current_page: %d, page: %p, term: %p, notebook: %p, user_data: %p", page_num,
 			gtk_notebook_get_current_page (notebook), page, term, notebook, user_data);
 
+	// The page we are leaving is still current, this is when it was last on screen.
+	if (term_find (gtk_notebook_get_nth_page (notebook, gtk_notebook_get_current_page (notebook)), &i)) {
+		terms.active[i].last_active = g_get_monotonic_time ();
+	}
+	scrollback_rebalance_queue ();
+
 	if (term_find (GTK_WIDGET (term), &i)) {
 		long n = i;
 		temu_window_title_changed (term, (void *) n);
@@ -1171,7 +1989,9 @@ static bool get_pointer_position (window_t *window, double *out_x, double *out_y
 	int				n;
 	double			x, y, tx, ty;
 
-	term_find (widget, &n);
+	if (!term_find (widget, &n)) {
+		return false;
+	}
 	if (term_n != NULL) {
 		*term_n = n;
 	}
@@ -1207,7 +2027,7 @@ static void show_menu (window_t *window)
 	// form wanted by VTE, is...  Convoluted.
 
 	double x, y;
-	int	   n;
+	int	   n = -1;
 
 	bool valid = get_pointer_position (window, &x, &y, &n);
 	if (valid) {
@@ -1222,7 +2042,7 @@ static void show_menu (window_t *window)
 		free (window->menu_hyperlink_uri);
 		window->menu_hyperlink_uri = NULL;
 	}
-	if (terms.active[n].hyperlink_uri) {
+	if (n >= 0 && terms.active[n].hyperlink_uri) {
 		window->menu_hyperlink_uri = strdup (terms.active[n].hyperlink_uri);
 		debugf ("Setting menu hyperlink uri: %s", window->menu_hyperlink_uri);
 	}
@@ -1234,10 +2054,13 @@ static void show_menu (window_t *window)
 static gboolean term_key_event (GtkEventControllerKey *key_controller, guint keyval, guint keycode, GdkModifierType state,
 								gpointer user_data)
 {
-	window_t  *window = (window_t *) user_data;
-	bind_t	  *cur;
-	GtkWidget *widget;
-	guint	   keyval_lower = keyval;
+	PROBE ();
+
+	window_t	*window = (window_t *) user_data;
+	key_entry_t *entry;
+	bind_t		*cur;
+	GtkWidget	*widget;
+	guint		 keyval_lower = keyval;
 
 	/*
 	 * Key bindings that involve shift are a problem, because we may get the
@@ -1268,78 +2091,70 @@ static gboolean term_key_event (GtkEventControllerKey *key_controller, guint key
 	g_free(name);
 #endif
 
-	for (cur = terms.keys; cur; cur = cur->next) {
-#if 0
-		gchar *name = gtk_accelerator_name(cur->key_min, cur->state);
-		debugf("key_min: %d (%s), key_max: %d (%s), state: 0x%x (%s)", cur->key_min, gdk_keyval_name(cur->key_min), cur->key_max, gdk_keyval_name(cur->key_max), cur->state, name);
-		g_free(name);
-#endif
-		if (((keyval >= cur->key_min) && (keyval <= cur->key_max)) ||
-			((keyval_lower >= cur->key_min) && (keyval_lower <= cur->key_max))) {
-			gchar *name	 = gtk_accelerator_name (0, state);
-			gchar *label = gtk_accelerator_get_label (0, state);
-			// debugf ("state: 0x%x, %d, name: '%s', label:
-			// '%s'", state, state, name, label);
-			g_free (label);
-			g_free (name);
-			// debugf("key: %d, state: %x, key_bind_mask:
-			// %x, cur->state: %x", key, state,
-			// key_bind_mask, cur->state);
-			if ((state & key_bind_mask) == cur->state) {
-				switch (cur->action) {
-					case BIND_ACT_SWITCH:
-						term_switch (cur->base + (keyval - cur->key_min), cur->argv, cur->env, window - &windows[0]);
-						break;
-					case BIND_ACT_CUT:
-						debugf ("Cut text");
-						widget = gtk_notebook_get_nth_page (window->notebook, gtk_notebook_get_current_page (window->notebook));
-						vte_terminal_copy_clipboard_format (VTE_TERMINAL (widget), VTE_FORMAT_TEXT);
-						break;
-					case BIND_ACT_CUT_HTML:
-						debugf ("Cut HTML");
-						widget = gtk_notebook_get_nth_page (window->notebook, gtk_notebook_get_current_page (window->notebook));
-						vte_terminal_copy_clipboard_format (VTE_TERMINAL (widget), VTE_FORMAT_HTML);
-						break;
-					case BIND_ACT_PASTE:
-						debugf ("Paste");
-						widget = gtk_notebook_get_nth_page (window->notebook, gtk_notebook_get_current_page (window->notebook));
-						vte_terminal_paste_clipboard (VTE_TERMINAL (widget));
-						break;
-					case BIND_ACT_MENU:
-						show_menu (window);
-						break;
-					case BIND_ACT_NEXT_TERM:
-						gtk_notebook_next_page (GTK_NOTEBOOK (window->notebook));
-						break;
-					case BIND_ACT_PREV_TERM:
-						gtk_notebook_prev_page (GTK_NOTEBOOK (window->notebook));
-						break;
-					case BIND_ACT_OPEN_URI:
-					case BIND_ACT_CUT_URI:
-						int n;
-
-						widget = gtk_notebook_get_nth_page (window->notebook, gtk_notebook_get_current_page (window->notebook));
-
-						if (term_find (widget, &n)) {
-							process_uri (n, window, cur->action, -1, -1, false);
-							return true;
-						}
-						break;
-					default:
-						debugf ("Fell into impossible key binding case.");
-						return false;
-				}
-				// debugf("action: %d", cur->action);
+	TRACE ("key", keyval, state);
+	entry = key_table_lookup (config_gen, state, keyval);
+	if (entry == NULL && keyval_lower != keyval) {
+		entry = key_table_lookup (config_gen, state, keyval_lower);
+	}
+
+	if (entry == NULL) {
+		latency_key ();
+		return false;
+	}
+
+	cur = entry->bind;
+	TRACE ("bind", cur->action, entry->n);
+	switch (cur->action) {
+		case BIND_ACT_SWITCH:
+			term_switch (entry->n, cur->argv, cur->envp, config_gen, window - &windows[0]);
+			break;
+		case BIND_ACT_CUT:
+			debugf ("Cut text");
+			widget = gtk_notebook_get_nth_page (window->notebook, gtk_notebook_get_current_page (window->notebook));
+			vte_terminal_copy_clipboard_format (VTE_TERMINAL (widget), VTE_FORMAT_TEXT);
+			break;
+		case BIND_ACT_CUT_HTML:
+			debugf ("Cut HTML");
+			widget = gtk_notebook_get_nth_page (window->notebook, gtk_notebook_get_current_page (window->notebook));
+			vte_terminal_copy_clipboard_format (VTE_TERMINAL (widget), VTE_FORMAT_HTML);
+			break;
+		case BIND_ACT_PASTE:
+			debugf ("Paste");
+			widget = gtk_notebook_get_nth_page (window->notebook, gtk_notebook_get_current_page (window->notebook));
+			vte_terminal_paste_clipboard (VTE_TERMINAL (widget));
+			break;
+		case BIND_ACT_MENU:
+			show_menu (window);
+			break;
+		case BIND_ACT_NEXT_TERM:
+			gtk_notebook_next_page (GTK_NOTEBOOK (window->notebook));
+			break;
+		case BIND_ACT_PREV_TERM:
+			gtk_notebook_prev_page (GTK_NOTEBOOK (window->notebook));
+			break;
+		case BIND_ACT_OPEN_URI:
+		case BIND_ACT_CUT_URI:
+			int n;
+
+			widget = gtk_notebook_get_nth_page (window->notebook, gtk_notebook_get_current_page (window->notebook));
+
+			if (term_find (widget, &n)) {
+				process_uri (n, window, cur->action, -1, -1, false);
 				return true;
 			}
-		}
+			break;
+		default:
+			debugf ("Fell into impossible key binding case.");
+			return false;
 	}
-
-	return false;
+	// debugf("action: %d", cur->action);
+	return true;
 }
 
 static void window_pressed_event (GtkGestureClick *gesture, gint n_press, gdouble x, double y, gpointer user_data)
 {
+	PROBE ();
+
 	window_t *window = (window_t *) user_data;
 
 	int		 n;
@@ -1509,7 +2324,7 @@ static gboolean button_event (GtkGesture *gesture, double x, double y, int64_t t
 		GdkModifierType state  = gdk_event_get_modifier_state (event);
 		int				button = gdk_button_event_get_button (event);
 
-		for (bind_button_t *cur = terms.buttons; cur; cur = cur->next) {
+		for (bind_button_t *cur = config_gen->buttons; cur; cur = cur->next) {
 			if (cur->button == button) {
 				gchar *name	 = gtk_accelerator_name (0, state);
 				gchar *label = gtk_accelerator_get_label (0, state);
@@ -1520,7 +2335,7 @@ static gboolean button_event (GtkGesture *gesture, double x, double y, int64_t t
 				// debugf("button: %d, state: %x, button_bind_mask:
 				// %x, cur->state: %x", button, state,
 				// button_bind_mask, cur->state);
-				if ((state & button_bind_mask) == cur->state) {
+				if ((state & config_gen->button_bind_mask) == cur->state) {
 					switch (cur->action) {
 						case BIND_ACT_OPEN_URI:
 						case BIND_ACT_CUT_URI:
@@ -1589,24 +2404,14 @@ void window_compute_size (GdkToplevel *self, GdkToplevelSize *size, gpointer use
 	surface_width		= gdk_surface_get_width (surface);
 	surface_height		= gdk_surface_get_height (surface);
 
-	for (int i = 0; i < MAX_WINDOWS; i++) {
-		if (user_data == windows[i].window) {
-			window_i = i;
-			break;
-		}
-	}
-
+	window_i = window_find (GTK_WIDGET (user_data));
 	if (window_i == -1) {
 		debugf ("We can't find the window?  Aborting.");
 		return;
 	}
 
-	for (int i = 0; i < terms.n_active; i++) {
-		if (terms.active[i].term != NULL && terms.active[i].window == window_i) {
-			term = terms.active[i].term;
-			break;
-		}
-	}
+	// All of the terminals in a window are the same size, so the current page will do.
+	term = gtk_notebook_get_nth_page (windows[window_i].notebook, gtk_notebook_get_current_page (windows[window_i].notebook));
 
 	if (term == NULL) {
 		debugf ("We can't find a terminal in the window.  Aborting.");
@@ -1711,6 +2516,90 @@ void window_compute_size (GdkToplevel *self, GdkToplevelSize *size, gpointer use
 #undef FUNC_DEBUG
 #define FUNC_DEBUG true
 
+static void window_before_paint (GdkFrameClock *clock, gpointer user_data)
+{
+	int i = window_find (GTK_WIDGET (user_data));
+
+	if (i >= 0) {
+		windows[i].paint_start = g_get_monotonic_time ();
+	}
+}
+
+static void window_after_paint (GdkFrameClock *clock, gpointer user_data)
+{
+	int	   i   = window_find (GTK_WIDGET (user_data));
+	gint64 now = g_get_monotonic_time ();
+
+	if (i < 0 || !windows[i].paint_start) {
+		return;
+	}
+
+	gint64 paint		   = now - windows[i].paint_start;
+	windows[i].paint_start = 0;
+
+	frame_stats.frames++;
+	frame_stats.paint_total += paint;
+	frame_stats.paint_max = MAX (frame_stats.paint_max, paint);
+	if (frame_stats.last_frame) {
+		frame_stats.gap_max = MAX (frame_stats.gap_max, now - paint - frame_stats.last_frame);
+	}
+	frame_stats.last_frame = now;
+
+	if (G_UNLIKELY (startup_spawned && startup_defer)) {
+		startup_finish_queue ();
+	}
+	if (G_UNLIKELY (!first_paint)) {
+		first_paint = true;
+		startup_mark ("first frame");
+		if (trace_file_enabled) {
+			trace_file_span ("startup", main_started, -1, i);
+		}
+	}
+	if (G_UNLIKELY (startup_output)) {
+		startup_output = false;
+		startup_mark ("first output on screen");
+		startup_report ();
+	}
+
+	TRACE ("paint", i, paint);
+	latency_painted (i);
+}
+
+// The frame clock only exists once the window is realized.
+static void window_realized (GtkWidget *window, gpointer user_data)
+{
+	GdkFrameClock *clock = gtk_widget_get_frame_clock (window);
+
+	g_signal_connect_object (clock, "before-paint", G_CALLBACK (window_before_paint), window, 0);
+	g_signal_connect_object (clock, "after-paint", G_CALLBACK (window_after_paint), window, 0);
+}
+
+// So that realizing the window again doesn't leave it counted twice.
+static void window_unrealized (GtkWidget *window, gpointer user_data)
+{
+	GdkFrameClock *clock = gtk_widget_get_frame_clock (window);
+
+	if (clock != NULL) {
+		g_signal_handlers_disconnect_by_func (clock, G_CALLBACK (window_before_paint), window);
+		g_signal_handlers_disconnect_by_func (clock, G_CALLBACK (window_after_paint), window);
+	}
+}
+
+// Builds the menus, and the header bar button's popover from them.
+static void window_popover_new (int i)
+{
+	rebuild_menus ();
+
+	GtkWidget *popover = gtk_popover_menu_new_from_model (windows[i].menu_model);
+	gtk_popover_set_autohide (GTK_POPOVER (popover), TRUE);
+	gtk_popover_set_has_arrow (GTK_POPOVER (popover), FALSE);
+	gtk_popover_set_position (GTK_POPOVER (popover), GTK_POS_BOTTOM);
+	gtk_widget_set_halign (popover, GTK_ALIGN_START);
+	gtk_widget_set_valign (popover, GTK_ALIGN_END);
+	gtk_menu_button_set_popover (GTK_MENU_BUTTON (windows[i].header_button), popover);
+	startup_mark ("menus");
+}
+
 int new_window (void)
 {
 	GtkWidget *window, *notebook;
@@ -1756,6 +2645,7 @@ int new_window (void)
 
 	windows[i].window	= GTK_WIDGET (window);
 	windows[i].notebook = GTK_NOTEBOOK (notebook);
+	g_object_set_qdata (G_OBJECT (window), window_index_quark (), GINT_TO_POINTER (i + 1));
 	debugf ("windows[%ld].notebook: %p", i, windows[i].notebook);
 
 	gtk_widget_set_can_focus (notebook, true);
@@ -1768,8 +2658,8 @@ int new_window (void)
 	add_button (GTK_WIDGET (windows[i].window), i);
 
 	g_signal_connect (notebook, "switch_page", G_CALLBACK (term_switch_page), GTK_NOTEBOOK (notebook));
-
-	rebuild_menus ();
+	g_signal_connect (window, "realize", G_CALLBACK (window_realized), NULL);
+	g_signal_connect (window, "unrealize", G_CALLBACK (window_unrealized), NULL);
 
 	GtkWidget *header = gtk_header_bar_new ();
 	gtk_header_bar_set_show_title_buttons (GTK_HEADER_BAR (header), true);
@@ -1782,16 +2672,13 @@ int new_window (void)
 	gtk_menu_button_set_direction (GTK_MENU_BUTTON (button), GTK_ARROW_DOWN);
 	gtk_menu_button_set_icon_name (GTK_MENU_BUTTON (button), "utilities-terminal");
 	gtk_header_bar_pack_end (GTK_HEADER_BAR (header), button);
-
-	GtkWidget *popover = gtk_popover_menu_new_from_model (windows[i].menu_model);
-	gtk_popover_set_autohide (GTK_POPOVER (popover), TRUE);
-	gtk_popover_set_has_arrow (GTK_POPOVER (popover), FALSE);
-	gtk_popover_set_position (GTK_POPOVER (popover), GTK_POS_BOTTOM);
-	gtk_widget_set_halign (popover, GTK_ALIGN_START);
-	gtk_widget_set_valign (popover, GTK_ALIGN_END);
 	windows[i].header		 = header;
 	windows[i].header_button = button;
-	gtk_menu_button_set_popover (GTK_MENU_BUTTON (button), popover);
+
+	// With fast_start, the first window gets its menus from startup_finish.
+	if (!startup_defer) {
+		window_popover_new (i);
+	}
 
 	gtk_widget_set_focusable (button, false);
 
@@ -1817,6 +2704,7 @@ int new_window (void)
 	GdkToplevel *toplevel = GDK_TOPLEVEL (surface);
 	g_signal_connect (toplevel, "compute-size", G_CALLBACK (window_compute_size), window);
 	debugf ("compute-size attached to toplevel");
+	startup_mark ("window");
 
 	return i;
 }
@@ -1832,7 +2720,9 @@ void destroy_window (int i)
 		debugf ("Unmapping window[%d].", i);
 		gtk_widget_unmap (windows[i].window);
 		debugf ("unparent windows[%d].menu: %p", i, windows[i].menu);
-		gtk_widget_unparent (GTK_WIDGET (windows[i].menu));
+		if (windows[i].menu) {
+			gtk_widget_unparent (GTK_WIDGET (windows[i].menu));
+		}
 		debugf ("Removing window[%d] from application.", i);
 		gtk_application_remove_window (app, GTK_WINDOW (windows[i].window));
 		debugf ("Destroying window[%d].", i);
@@ -1841,38 +2731,69 @@ void destroy_window (int i)
 		windows[i].window		  = NULL;
 		windows[i].menu			  = NULL;
 		windows[i].key_controller = NULL;
+		windows[i].term_list_tick = 0; // Went with the window.
+		g_clear_object (&windows[i].term_actions);
+	}
+}
+
+/*
+ * The rest of starting up with fast_start, once the first terminal has
+ * been spawned and painted.
+ */
+static gboolean startup_finish (gpointer data)
+{
+	PROBE ();
+
+	startup_defer  = false;
+	startup_source = 0;
+	for (int i = 0; i < MAX_WINDOWS; i++) {
+		if (windows[i].window && !gtk_menu_button_get_popover (GTK_MENU_BUTTON (windows[i].header_button))) {
+			window_popover_new (i);
+		}
 	}
+
+	return G_SOURCE_REMOVE;
 }
 
 static void activate (GtkApplication *app, gpointer user_data)
 {
+	PROBE ();
+
 	if (terms.active) {
 		debugf ("activate called when already activated");
 		return;
 	}
 
-	if (!zterm_parse_config ()) {
-		errorf ("Unable to read new config, falling back to legacy config.");
-		temu_parse_config ();
-	}
-	if (!terms.n_active) {
-		errorf ("Unable to read config file, or no terminals defined.");
+	// Started in main, and most likely done by now.
+	startup_mark ("activate");
+	if (!config_load_apply ()) {
 		exit (0);
 	}
-	terms.active = calloc (terms.n_active, sizeof (*terms.active));
+	config_watch_start ();
+	startup_mark ("config");
+
+	control_start ();
+	watchdog_start ();
+	trace_start ();
+	spawn_helper_apply ();
+	term_slots_grow (0);
 
 	if (!initial_cmd) {
 		initial_cmd = g_new0 (cmd_t, 1);
 	}
 
+	// With fast_start, the rest waits for the first terminal to be spawned and painted, see window_after_paint.
+	startup_defer = terms.fast_start;
 	switch_cmd (initial_cmd);
+
+	term_pool_refill ();
 }
 
 int main (int argc, char *argv[], char *envp[])
 {
-	int	  i;
-	char *shell;
+	int i;
 
+	main_started = g_get_monotonic_time ();
 	tzset ();
 
 #ifdef DEBUG
@@ -1884,14 +2805,13 @@ int main (int argc, char *argv[], char *envp[])
 	app = gtk_application_new ("com.aehallh." ZTERM_NAME, 0);
 	g_application_set_application_id (G_APPLICATION (app), "com.aehallh." ZTERM_NAME);
 	g_application_add_main_option_entries (G_APPLICATION (app), cli_options);
+	g_signal_connect (app, "handle-local-options", G_CALLBACK (handle_local_options), NULL);
 	g_signal_connect (app, "command-line", G_CALLBACK (command_line), NULL);
 	g_application_set_flags (G_APPLICATION (app), G_APPLICATION_HANDLES_COMMAND_LINE);
 
 	memset (&terms, 0, sizeof (terms));
 	terms.envp = envp;
-	shell	   = vte_get_user_shell ();
-	debugf ("Using VTE: %s (%s)", vte_get_features (), shell);
-	free (shell);
+	debugf ("Using VTE: %s", vte_get_features ());
 	terms.audible_bell		  = true;
 	terms.font_scale		  = 1;
 	terms.scroll_on_output	  = false;
@@ -1904,8 +2824,14 @@ int main (int argc, char *argv[], char *envp[])
 		errorf ("Unable to chdir to %s: %s", getenv ("HOME"), strerror (errno));
 	}
 
+	// While we're still small, and before there are any threads.
+	spawn_helper_start ();
+
 	g_signal_connect (app, "activate", G_CALLBACK (activate), NULL);
 
+	// Read the config while GTK starts up.
+	config_load_start (false, false);
+
 	int status = g_application_run (G_APPLICATION (app), argc, argv);
 
 	debugf ("Exiting, status %d, can free here. (%d)", status, terms.n_active);
@@ -1917,28 +2843,43 @@ int main (int argc, char *argv[], char *envp[])
 		}
 	}
 
+	term_pool_free ();
+	spawn_helper_stop ();
+	control_stop ();
+	trace_stop ();
+	watchdog_stop ();
+	trace_file_close ();
+	config_watch_stop ();
+	config_load_stop ();
+	config_save_finish ();
+	latency_free ();
+	if (scrollback_source) {
+		g_source_remove (scrollback_source);
+		scrollback_source = 0;
+	}
+
 	for (i = 0; i < MAX_WINDOWS; i++) {
 		destroy_window (i);
 	}
 
 	free (terms.active);
 	terms.active = NULL;
+	if (terms.pts_index != NULL) {
+		g_hash_table_destroy (terms.pts_index);
+		terms.pts_index = NULL;
+	}
 
 	if (terms.font) {
 		free (terms.font);
 		terms.font = NULL;
 	}
-	{
-		bind_t *keys, *next;
-		for (keys = terms.keys; keys; keys = next) {
-			next = keys->next;
-			if (keys->argv != NULL) {
-				g_strfreev ((char **) keys->argv);
-			}
-			free (keys);
-		}
-		terms.keys = NULL;
-	}
+	free (terms.control_socket);
+	terms.control_socket = NULL;
+	match_regexes_free ();
+	g_strfreev (terms.match_patterns);
+	terms.match_patterns = NULL;
+	term_settings_free (&term_settings);
+	config_gen_unref (g_atomic_pointer_exchange (&config_gen, NULL));
 
 	return status;
 }
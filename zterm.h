@@ -11,6 +11,7 @@
 
 #define MAX_WINDOWS 8
 #define MAX_COLOR_SCHEMES 8
+#define MAX_BIND_RANGE 256 // Keys in one switch binding, F1-F12 is 12.
 
 typedef enum bind_actions {
 	BIND_ACT_SWITCH = 0,
@@ -31,9 +32,16 @@ typedef struct bind_s {
 	struct bind_s *next;
 	char		 **argv;
 	char		 **env;
+	char		 **envp; // The generation's envp with env set in it, if there is an env.
 	bind_actions_t action;
 } bind_t;
 
+typedef struct key_entry_s {
+	gint64	key; // (state << 32) | keyval, must be first, it's also the hash key.
+	bind_t *bind;
+	long	n; // Terminal number, for BIND_ACT_SWITCH.
+} key_entry_t;
+
 typedef struct {
 	char **argv;
 	char **env;
@@ -67,6 +75,9 @@ typedef struct window_s {
 	GtkWidget		   *menu;
 	GMenuModel		   *menu_model;
 	GMenuModel		   *menu_model_term_list;
+	GSimpleActionGroup *term_actions;	// The "terms" group, see term_list_actions.
+	guint				term_list_tick; // Pending term_list_tick callback.
+	gint64				paint_start;	// When the frame clock started on the frame in progress.
 	GtkEventController *key_controller;
 	int					color_scheme;
 	double				menu_x,
@@ -74,17 +85,81 @@ typedef struct window_s {
 	char *menu_hyperlink_uri;
 } window_t;
 
+/*
+ * Each terminal moves through these in order, from being created by
+ * term_switch to having a running child.  The only steps back are a queued
+ * terminal that was unrealized before its idle ran, which goes back to
+ * TERM_SPAWN_WAITING to be queued again when it is realized, and unrealizing
+ * a terminal that isn't being moved, which sends it back to TERM_SPAWN_NONE.
+ */
+typedef enum term_spawn_state {
+	TERM_SPAWN_NONE = 0, // No terminal widget.
+	TERM_SPAWN_WAITING,	 // Widget created, waiting for it to be realized.
+	TERM_SPAWN_QUEUED,	 // Realized, spawn queued for the next idle.
+	TERM_SPAWN_STARTED,	 // spawn_async called, waiting on spawn_callback.
+	TERM_SPAWN_RUNNING,	 // Child is running.
+} term_spawn_state_t;
+
+/*
+ * What term_config_apply needs to push to a terminal, as worked out by
+ * term_config_changed from the settings before and after a reload.
+ */
+typedef enum term_change {
+	TERM_CHANGE_FONT		= 1 << 0,
+	TERM_CHANGE_FONT_SCALE	= 1 << 1,
+	TERM_CHANGE_WORD_CHARS	= 1 << 2,
+	TERM_CHANGE_BEHAVIOR	= 1 << 3, // Bell, scrolling, bold and mouse autohide.
+	TERM_CHANGE_SCROLLBACK	= 1 << 4,
+	TERM_CHANGE_MATCHES		= 1 << 5,
+	TERM_CHANGE_COLORS		= 1 << 6,
+	TERM_CHANGE_ALL			= (1 << 7) - 1,
+} term_change_t;
+
 typedef struct term_instance_s {
-	int		   spawned;
-	int		   moving;
-	int		   window;
-	char	 **argv; // NULL terminated.
-	char	 **env;	 // If this term has a unique environment.
-	char	  *hyperlink_uri;
-	char	   title[256];
-	GtkWidget *term;
+	term_spawn_state_t	 spawn_state;
+	guint				 spawn_source;	   // Idle source for a queued spawn.
+	gint64				 spawn_requested;  // Monotonic time the slot was requested.
+	unsigned			 pending_changes;  // term_change_t bits to apply when next mapped.
+	bool				 title_dirty;	   // Title changed since the terminal list menu was updated.
+	GPid				 pid;			   // Child pid, once spawned.
+	gint64				 last_active;	   // Monotonic time the terminal was last on screen.
+	glong				 scrollback_limit; // Scrollback lines set on the terminal, see scrollback_rebalance.
+	int					 pty_fd;		   // PTY master, only valid while pts is set.
+	char				 pts[32];		   // PTY name without the /dev/ prefix, empty until spawned.
+	int					 moving;
+	int					 window;
+	struct config_gen_s *gen;			   // Holds argv and env when they're a binding's, otherwise they're our own.
+	char			   **argv;			   // NULL terminated.
+	char			   **env;			   // If this term has a unique environment.
+	char				*hyperlink_uri;
+	char				 title[256];
+	GtkWidget			*term;
 } term_instance_t;
 
+// Frame clock timings for all windows, reported and reset through the control socket.
+typedef struct frame_stats_s {
+	guint64 frames;
+	gint64	paint_total; // Microseconds from before-paint to after-paint, over all frames.
+	gint64	paint_max;
+	gint64	last_frame;
+	gint64	gap_max; // Longest wait between the end of one frame and the next.
+} frame_stats_t;
+
+// Time from asking for a child to be spawned to hearing back, reported and reset through the control socket.
+typedef struct spawn_stats_s {
+	guint64 spawns;
+	gint64	total; // Microseconds, over all spawns.
+	gint64	max;
+} spawn_stats_t;
+
+// Keystroke latency for one terminal slot, in microseconds, see latency.c.
+typedef struct latency_stats_s {
+	guint64 count; // Inputs echoed.
+	gint64	echo_p50, echo_p99, echo_max;
+	guint64 painted; // Echoed inputs which made it to the screen.
+	gint64	paint_p50, paint_p99, paint_max;
+} latency_stats_t;
+
 typedef struct color_override_s {
 	int						 index;
 	GdkRGBA					 color;
@@ -109,12 +184,11 @@ typedef struct terms_s {
 	gint   alive;	 // Total number of 'alive' terms.
 	char **envp;
 
-	/* Configuration options. */
-	bind_t			 *keys;
-	bind_button_t	 *buttons;
-	color_override_t *color_overrides;
-	env_var_t		 *env_vars;
-	bind_ignore_t	 *ignores;
+	/* Configuration options, those other code holds pointers into are in config_gen. */
+	char			**match_patterns; // Extra URL patterns to match, beyond the builtin ones.
+	GPtrArray		 *match_regexes;  // Compiled from match_patterns, see match_regexes_get.
+	GHashTable		 *pts_index;	  // PTY name to slot plus one, see term_pty_record.
+	char			 *control_socket; // Path for the control socket, see control.c.
 	char			 *font;
 	bool			  audible_bell;
 	char			 *word_char_exceptions;
@@ -122,25 +196,59 @@ typedef struct terms_s {
 	bool			  scroll_on_output;
 	bool			  scroll_on_keystroke;
 	glong			  scrollback_lines;
+	glong			  scrollback_budget; // Scrollback lines for all terminals together, 0 for no limit.
 	bool			  bold_is_bright;
 	bool			  mouse_autohide;
-
-	color_scheme_t color_schemes[MAX_COLOR_SCHEMES];
+	int				  pool_size;	 // Terminals to build ahead of time, see term_pool_fill.
+	bool			  pool_prespawn; // Start a login shell in each pooled terminal.
+	bool			  fast_start;	 // Spawn the first terminal before building the menus.
+	bool			  auto_reload;	 // Reload the config when the file changes.
+	bool			  latency_stats; // Measure keystroke latency, see latency.c.
+	int				  watchdog_ms;	 // Report main loop stalls longer than this, see watchdog.c.
+	bool			  trace_buffer;	 // Record TRACE () points, see trace.c.
+	bool			  spawn_helper;	 // Spawn children through the helper forked at startup, see spawn.c.
 } terms_t;
 
-extern GdkRGBA colors[256];
+// The modifiers that matter to a binding, until an ignore_mod takes some away.
+#define BIND_MASK_DEFAULT                                                                                                        \
+	((GDK_MODIFIER_MASK & ~GDK_LOCK_MASK) ^                                                                                      \
+	 (GDK_BUTTON1_MASK | GDK_BUTTON2_MASK | GDK_BUTTON3_MASK | GDK_BUTTON4_MASK | GDK_BUTTON5_MASK))
+
+/*
+ * One generation of the config, the parts of it that are pointed into,
+ * never changed once published, see config.c.
+ */
+typedef struct config_gen_s {
+	gint			  refs;
+	guint			  serial; // Counting from 1, for tracing.
+	bind_t			 *keys;
+	bind_button_t	 *buttons;
+	bind_ignore_t	 *ignores;
+	color_override_t *color_overrides;
+	env_var_t		 *env_vars;
+	char			**envp;		 // For spawning, zterm's own environment with env_vars set in it.
+	char			 *shell;	 // The user's login shell and home directory, from the config thread.
+	char			 *home;
+	GHashTable		 *key_table; // Compiled from keys, see keys.c.
+	unsigned int	  key_bind_mask;
+	unsigned int	  button_bind_mask;
+	GdkRGBA			  colors[256];
+	color_scheme_t	  color_schemes[MAX_COLOR_SCHEMES];
+} config_gen_t;
+
+extern const GdkRGBA default_colors[256];
+extern config_gen_t *config_gen;
 
-extern terms_t	terms;
-extern window_t windows[MAX_WINDOWS];
+extern terms_t		 terms;
+extern window_t		 windows[MAX_WINDOWS];
+extern frame_stats_t frame_stats;
+extern spawn_stats_t spawn_stats;
 
 extern GtkApplication *app;
 
 extern int start_width;
 extern int start_height;
 
-extern unsigned int key_bind_mask;
-extern unsigned int button_bind_mask;
-
 int _fprintf (bool print, FILE *io, const char *fmt, ...) __attribute__ ((format (printf, 3, 4)));
 
 #define errorf(format, ...)                                                                                                      \
@@ -152,21 +260,137 @@ int _fprintf (bool print, FILE *io, const char *fmt, ...) __attribute__ ((format
 #	define debugf(format, ...)                                                                                                  \
 		_fprintf (FUNC_DEBUG, stderr, "Debug: %s %d (%s): " format "\n", __FILE__, __LINE__, __func__ __VA_OPT__ (, ) __VA_ARGS__)
 #else
+// Still type checked, but neither formatted nor evaluated.
 #	define debugf(format, ...)                                                                                                  \
-		_fnullf (stderr, "Debug: %s %d (%s): " format "\n", __FILE__, __LINE__, __func__ __VA_OPT__ (, ) __VA_ARGS__)
+		do {                                                                                                                     \
+			if (0) {                                                                                                             \
+				_fprintf (false, stderr, "Debug: %s %d (%s): " format "\n", __FILE__, __LINE__, __func__ __VA_OPT__ (, )         \
+						  __VA_ARGS__);                                                                                          \
+			}                                                                                                                    \
+		} while (0)
 #endif
-int		 _fnullf (const FILE *io, const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
+
+/*
+ * Marks the rest of the enclosing block as running in the current function,
+ * for the stall watchdog and --trace, with PROBE_ARGS giving the terminal
+ * slot and window for the trace, -1 if none.  While both are off, this is
+ * one test of probes_enabled on the way in and one of probe.active on the
+ * way out.
+ */
+typedef struct probe_s {
+	bool active;
+} probe_t;
+
+extern bool probes_enabled;
+void		probe_enter (const char *name, long slot, int window);
+void		probe_pop (void);
+void		probes_update (void);
+
+static inline void probe_exit (probe_t *probe)
+{
+	if (G_UNLIKELY (probe->active)) {
+		probe_pop ();
+	}
+}
+
+#define PROBE_ARGS(slot, window)                                                                                                 \
+	__attribute__ ((cleanup (probe_exit), unused)) probe_t _probe = {                                                            \
+	  .active = G_UNLIKELY (probes_enabled) && (probe_enter (__func__, slot, window), true)}
+#define PROBE() PROBE_ARGS (-1, -1)
+
+/*
+ * A point in the trace ring buffer, what being a string literal.  Costs a test
+ * of trace_enabled while tracing is off.
+ */
+typedef struct trace_record_s {
+	guint64		seq; // Which record this is, plus one, once it's complete.
+	gint64		time;
+	const char *what;
+	gint64		a, b;
+} trace_record_t;
+
+extern bool trace_enabled;
+extern bool trace_file_enabled;
+void		trace_record (const char *what, gint64 a, gint64 b);
+void		trace_file_span (const char *name, gint64 start, long slot, int window);
+
+#define TRACE(what, a, b)                                                                                                        \
+	do {                                                                                                                         \
+		if (G_UNLIKELY (trace_enabled)) {                                                                                        \
+			trace_record (what, a, b);                                                                                           \
+		}                                                                                                                        \
+	} while (0)
+
 void	 do_copy (GSimpleAction *self, GVariant *parameter, gpointer user_data);
 bool	 term_find (GtkWidget *term, int *i);
+glong	 term_scrollback_used (int n);
 void	 term_set_window (int n, int window_i);
-void	 term_switch (long n, char **argv, char **env, int window_i);
-bool	 temu_parse_config (void);
+void	 term_switch (long n, char **argv, char **env, config_gen_t *gen, int window_i);
+bool	 switch_cmd (cmd_t *cmd);
+bool	 switch_target_resolve (const char *target, long *n);
 void	 term_config (GtkWidget *term, int window_i);
-bool	 zterm_parse_config ();
+void	 term_config_apply (GtkWidget *term, int window_i, unsigned changes);
+void	 term_config_changed (bool refresh_font);
+void	 term_slots_grow (int old_n_active);
+
+config_gen_t  *config_gen_new (void);
+config_gen_t  *config_gen_ref (config_gen_t *gen);
+void		   config_gen_unref (config_gen_t *gen);
+void		   config_gen_publish (config_gen_t *gen);
+config_gen_t  *config_gen_edit (void);
+bind_t		  *config_gen_edit_key (config_gen_t *copy, const bind_t *bind);
+bind_button_t *config_gen_edit_button (config_gen_t *copy, const bind_button_t *bind);
+char		 **config_envp_layer (char *const *envp, char *const *overrides);
+
+void	 config_load_start (bool reload, bool watched);
+bool	 config_load_apply (void);
+void	 config_load_stop (void);
+void	 config_reloaded (int old_n_active, bool by_user);
+void	 config_save_finish (void);
+void	 config_watch_start (void);
+void	 config_watch_stop (void);
 void	 zterm_save_config ();
 gboolean process_uri (int64_t term_n, window_t *window, bind_actions_t action, double x, double y, bool menu);
 void	 rebuild_menus (void);
 void	 rebuild_term_list (long int window_n);
+void	 term_list_title_changed (long int window_n, long int n);
 void	 do_preferences (GSimpleAction *self, GVariant *parameter, gpointer data);
+void	 do_set_window_color_scheme (GSimpleAction *self, GVariant *parameter, gpointer data);
+void	 term_pool_refill (void);
+void	 term_pool_drain (void);
+void	 term_pool_config (unsigned changes);
+void	 term_pool_free (void);
+void	 match_regexes_free (void);
+
+void		 key_table_build (config_gen_t *gen);
+void		 key_table_free (config_gen_t *gen);
+key_entry_t *key_table_lookup (const config_gen_t *gen, guint state, guint keyval);
+
+void control_start (void);
+void control_stop (void);
+
+void latency_key (void);
+void latency_connect (GtkWidget *term, long n);
+void latency_painted (int window_i);
+bool latency_get (int n, latency_stats_t *stats);
+void latency_reset (void);
+void latency_free (void);
+
+void watchdog_start (void);
+void watchdog_stop (void);
+
+void spawn_helper_start (void);
+void spawn_helper_apply (void);
+void spawn_helper_stop (void);
+bool spawn_helper_running (void);
+void spawn_async (VteTerminal *term, const char *working_directory, char **argv, char **envp, int timeout,
+				  VteTerminalSpawnAsyncCallback callback, gpointer user_data);
+
+int	 trace_snapshot (trace_record_t *out, int max);
+void trace_clear (void);
+void trace_start (void);
+void trace_stop (void);
+bool trace_file_open (const char *filename);
+void trace_file_close (void);
 
 // vim: set ts=4 sw=4 noexpandtab :